@@ -4,6 +4,17 @@
 #include <string>
 #include <algorithm>
 #include <sstream>
+#include <unordered_map>
+#include <thread>
+#include <filesystem>
+#include <iterator>
+#include <tuple>
+#include <type_traits>
+#include <string_view>
+#include <cctype>
+#include <cstdint>
+#include <numeric>
+#include <array>
 
 // =========================
 // Class Definition
@@ -16,34 +27,461 @@ public:
 };
 
 // =========================
-// Function to Load Courses
+// Key Projections
+// =========================
+// Each key is a compile-time projection from a Course to the value it is
+// ordered and looked up by. Sorts, pages and lookups are templates over the
+// key, so every one gets its own inlined comparator with no function
+// pointers or branching on the key at run time.
+// To add a key: declare a struct like these and list it in CourseKeys below;
+// its sort, page and lookup menu entries follow from the list.
+struct ByCourseNumber {
+    static constexpr bool unique = true; // No tie-break needed
+    static constexpr const char* label = "Course Number";
+    static const std::string& get(const Course& course) { return course.courseNumber; }
+};
+
+struct ByCourseName {
+    static constexpr bool unique = false;
+    static constexpr const char* label = "Course Name";
+    static const std::string& get(const Course& course) { return course.name; }
+};
+
+struct ByPrerequisiteCount {
+    static constexpr bool unique = false;
+    static constexpr const char* label = "Number of Prerequisites";
+    static std::size_t get(const Course& course) { return course.prerequisites.size(); }
+};
+
+struct ByDepartment {
+    static constexpr bool unique = false;
+    static constexpr const char* label = "Department";
+    // Leading letters of the course number (e.g., MATH for MATH201)
+    static std::string_view get(const Course& course) {
+        std::string_view number = course.courseNumber;
+        std::size_t length = 0;
+        while (length < number.size() && std::isalpha(static_cast<unsigned char>(number[length]))) {
+            length++;
+        }
+        return number.substr(0, length);
+    }
+};
+
+using CourseKeys = std::tuple<ByCourseNumber, ByCourseName, ByPrerequisiteCount, ByDepartment>;
+constexpr std::size_t courseKeyCount = std::tuple_size_v<CourseKeys>;
+
+// =========================
+// Ordering Keys for Sorted Views
+// =========================
+// Tracks which order the course vector is currently in, so paged listings
+// can seek straight into an existing sorted view instead of re-sorting.
+// 0 is file order; sortCourses<Key> produces order keyOrder<Key>, which is
+// the key's position in CourseKeys plus one.
+using CourseOrder = std::size_t;
+constexpr CourseOrder unsortedOrder = 0;
+
+template <typename Key, std::size_t Index = 0>
+constexpr CourseOrder findKeyOrder() {
+    static_assert(Index < courseKeyCount, "Key is not listed in CourseKeys");
+    if constexpr (std::is_same_v<Key, std::tuple_element_t<Index, CourseKeys>>) {
+        return Index + 1;
+    }
+    else {
+        return findKeyOrder<Key, Index + 1>();
+    }
+}
+
+template <typename Key>
+constexpr CourseOrder keyOrder = findKeyOrder<Key>();
+
+// Value type produced by a key (std::string, std::size_t, ...)
+template <typename Key>
+using KeyValue = std::decay_t<decltype(Key::get(std::declval<const Course&>()))>;
+
+// Strict weak ordering by Key; ties on non-unique keys fall back to the
+// course number so sorted views and pages are deterministic.
+template <typename Key>
+struct KeyLess {
+    bool operator()(const Course& a, const Course& b) const {
+        const auto& keyA = Key::get(a);
+        const auto& keyB = Key::get(b);
+        if constexpr (Key::unique) {
+            return keyA < keyB;
+        }
+        else {
+            if (keyA < keyB) {
+                return true;
+            }
+            if (keyB < keyA) {
+                return false;
+            }
+            return a.courseNumber < b.courseNumber;
+        }
+    }
+    bool operator()(const Course* a, const Course* b) const {
+        return (*this)(*a, *b);
+    }
+};
+
+// Calls fn(Key{}) for the key at position `index` of CourseKeys, so the key
+// of a sorted view `order` is visitKey(order - 1, ...).
+// Only the menus use this; everything below the menus is resolved statically.
+template <typename Fn>
+bool visitKey(std::size_t index, Fn&& fn) {
+    return std::apply([&](auto... keys) {
+        std::size_t position = 0;
+        return ((position++ == index ? (fn(keys), true) : false) || ...);
+        }, CourseKeys{});
+}
+
+// Prints "1. By <label>" for every key, for use in menus
+void printKeyOptions() {
+    std::size_t position = 1;
+    std::apply([&](auto... keys) {
+        ((std::cout << position++ << ". By " << decltype(keys)::label << "\n"), ...);
+        }, CourseKeys{});
+}
+
+// =========================
+// Class Definition - Editable Catalog
+// =========================
+// Course storage plus the in-memory index that edits keep up to date.
+// Lookups by the other keys use sorted position lists, one per key, that are
+// built on first use and dropped whenever a course changes or moves.
+class CourseCatalog {
+public:
+    std::vector<Course> courses;                            // All courses, in `order`
+    std::unordered_map<std::string, std::size_t> positions; // courseNumber -> index into courses
+    CourseOrder order = unsortedOrder;                      // Order `courses` is currently in
+    bool loaded = false;                                    // Set once courses.txt has been read
+
+    mutable std::array<std::vector<std::size_t>, courseKeyCount> keyIndexes; // Positions in key order
+    mutable std::array<bool, courseKeyCount> keyIndexBuilt{};                // keyIndexes[i] is current
+};
+
+// Drops the per-key lookup lists; called whenever courses change or move
+void clearKeyIndexes(CourseCatalog& catalog) {
+    catalog.keyIndexBuilt.fill(false);
+}
+
+// =========================
+// Function to Parse One Course Line
+// =========================
+// Line format: courseNumber,name[,prerequisite...]
+bool parseCourseLine(const std::string& line, Course& course) {
+    std::istringstream ss(line);
+    std::getline(ss, course.courseNumber, ','); // Read course number
+    std::getline(ss, course.name, ',');         // Read course name
+
+    // Read and store all prerequisites (if any)
+    std::string prereq;
+    while (std::getline(ss, prereq, ',')) {
+        course.prerequisites.push_back(prereq);
+    }
+
+    return !course.courseNumber.empty();
+}
+
+// =========================
+// Function to Format One Course Line
+// =========================
+std::string formatCourseLine(const Course& course) {
+    std::string line = course.courseNumber + "," + course.name;
+    for (const std::string& prereq : course.prerequisites) {
+        line += "," + prereq;
+    }
+    return line;
+}
+
+// =========================
+// Function to Rebuild the Course Number Index
+// =========================
+// Only needed after operations that move every course (load, sort).
+void rebuildPositions(CourseCatalog& catalog) {
+    clearKeyIndexes(catalog);
+    catalog.positions.clear();
+    catalog.positions.reserve(catalog.courses.size());
+    for (std::size_t i = 0; i < catalog.courses.size(); ++i) {
+        catalog.positions[catalog.courses[i].courseNumber] = i;
+    }
+}
+
+// =========================
+// NEW: Edit Operations - Add / Update / Delete
+// =========================
+// Each edit touches one vector slot and one index entry, so it is O(1).
+// Adding appends and deleting swaps with the last course, which breaks any
+// sorted view, so the catalog falls back to Unsorted.
+bool addCourse(CourseCatalog& catalog, const Course& course) {
+    if (catalog.positions.count(course.courseNumber) != 0) {
+        return false;
+    }
+    catalog.positions[course.courseNumber] = catalog.courses.size();
+    catalog.courses.push_back(course);
+    catalog.order = unsortedOrder;
+    clearKeyIndexes(catalog);
+    return true;
+}
+
+bool updateCourse(CourseCatalog& catalog, const Course& course) {
+    auto found = catalog.positions.find(course.courseNumber);
+    if (found == catalog.positions.end()) {
+        return false;
+    }
+    Course& existing = catalog.courses[found->second];
+
+    // The sorted view survives unless the edit changes its key
+    if (catalog.order != unsortedOrder) {
+        visitKey(catalog.order - 1, [&](auto key) {
+            using Key = decltype(key);
+            if (!(Key::get(existing) == Key::get(course))) {
+                catalog.order = unsortedOrder;
+            }
+            });
+    }
+    existing = course;
+    clearKeyIndexes(catalog);
+    return true;
+}
+
+bool deleteCourse(CourseCatalog& catalog, const std::string& courseNumber) {
+    auto found = catalog.positions.find(courseNumber);
+    if (found == catalog.positions.end()) {
+        return false;
+    }
+    std::size_t index = found->second;
+    catalog.positions.erase(found);
+
+    // Move the last course into the freed slot
+    if (index != catalog.courses.size() - 1) {
+        catalog.courses[index] = std::move(catalog.courses.back());
+        catalog.positions[catalog.courses[index].courseNumber] = index;
+        catalog.order = unsortedOrder;
+    }
+    catalog.courses.pop_back();
+    clearKeyIndexes(catalog);
+    return true;
+}
+
+// =========================
+// Class Definition - Append-Only Edit Log
+// =========================
+// Every edit is appended to courses.log as one record:
+//   A,<course line>   add
+//   U,<course line>   update
+//   D,<course number> delete
+// Once enough edits pile up, the log is rotated to courses.log.old and a
+// background thread folds it into courses.txt: it reads the file on disk,
+// replays the old log on top, writes the result back and removes the old
+// log. The in-memory catalog is never written, so edits made before the
+// data was loaded cannot replace the file. Loading replays courses.log.old
+// and courses.log on top of courses.txt, so a crash mid-compaction loses
+// nothing. The compaction threshold grows with the catalog, keeping edits
+// O(1) amortized.
+class CourseEditLog {
+public:
+    CourseEditLog() {
+        log.open(logFileName, std::ios::app);
+    }
+
+    ~CourseEditLog() {
+        waitForCompaction();
+    }
+
+    void append(char operation, const std::string& payload) {
+        log << operation << ',' << payload << '\n';
+        log.flush(); // Edits must survive a crash
+        pendingEdits++;
+    }
+
+    void setPendingEdits(std::size_t count) {
+        pendingEdits = count;
+    }
+
+    // Starts a background compaction if the log has grown past the threshold
+    void maybeCompact(const CourseCatalog& catalog) {
+        std::size_t threshold = std::max<std::size_t>(minCompactEdits, catalog.courses.size() / 2);
+        if (pendingEdits < threshold) {
+            return;
+        }
+        waitForCompaction();
+
+        // A leftover old log (from a crash or a failed fold) still holds
+        // edits that are not in courses.txt, so fold it before reusing the name
+        if (std::filesystem::exists(oldLogFileName)) {
+            foldOldLog();
+            if (std::filesystem::exists(oldLogFileName)) {
+                std::cerr << "Could not fold " << oldLogFileName << "; keeping edits in " << logFileName << std::endl;
+                return;
+            }
+        }
+
+        // Rotate the log so new edits go to a fresh file during compaction
+        log.close();
+        std::error_code error;
+        std::filesystem::rename(logFileName, oldLogFileName, error);
+        log.open(logFileName, std::ios::app);
+        if (error) {
+            std::cerr << "Failed to rotate the edit log: " << error.message() << std::endl;
+            return;
+        }
+        pendingEdits = 0;
+        compactor = std::thread(foldOldLog);
+    }
+
+    void waitForCompaction() {
+        if (compactor.joinable()) {
+            compactor.join();
+        }
+    }
+
+    static constexpr const char* dataFileName = "courses.txt";
+    static constexpr const char* logFileName = "courses.log";
+    static constexpr const char* oldLogFileName = "courses.log.old";
+
+private:
+    // Defined below, once the file readers exist
+    static void foldOldLog();
+
+    static constexpr std::size_t minCompactEdits = 64;
+
+    std::ofstream log;
+    std::thread compactor;
+    std::size_t pendingEdits = 0;
+};
+
+// =========================
+// Function to Replay an Edit Log
+// =========================
+// Records are applied as upserts and deletes, so replaying a log that was
+// already folded into courses.txt is harmless. Returns the records applied.
+std::size_t replayEditLog(CourseCatalog& catalog, const std::string& fileName) {
+    std::ifstream file(fileName);
+    if (!file.is_open()) {
+        return 0; // No log yet
+    }
+
+    std::size_t applied = 0;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.size() < 2 || line[1] != ',') {
+            continue; // Skip a torn trailing record
+        }
+        std::string payload = line.substr(2);
+        if (line[0] == 'D') {
+            deleteCourse(catalog, payload);
+        }
+        else {
+            Course course;
+            if (!parseCourseLine(payload, course)) {
+                continue;
+            }
+            if (!updateCourse(catalog, course)) {
+                addCourse(catalog, course);
+            }
+        }
+        applied++;
+    }
+    return applied;
+}
+
 // =========================
-void loadDataStructure(std::vector<Course>& courses) {
-    std::string fileName = "courses.txt";
+// Function to Read a Course File
+// =========================
+// Lines that do not parse are skipped with a warning, or handed back in
+// unparsedLines when the caller wants to keep them.
+bool loadCourseFile(const std::string& fileName, std::vector<Course>& courses,
+                    std::vector<std::string>* unparsedLines = nullptr) {
     std::ifstream file(fileName);
 
     if (!file.is_open()) {
         std::cerr << "Failed to open the file: " << fileName << std::endl;
-        return;
+        return false;
     }
 
     std::string line;
+    std::size_t lineNumber = 0;
     while (std::getline(file, line)) {
+        ++lineNumber;
         Course course;
-        std::istringstream ss(line);
-        std::getline(ss, course.courseNumber, ','); // Read course number
-        std::getline(ss, course.name, ',');         // Read course name
-
-        // Read and store all prerequisites (if any)
-        std::string prereq;
-        while (std::getline(ss, prereq, ',')) {
-            course.prerequisites.push_back(prereq);
+        if (!parseCourseLine(line, course)) {
+            // Blank lines are expected at the end of hand-edited files
+            if (line.empty()) {
+                continue;
+            }
+            if (unparsedLines != nullptr) {
+                unparsedLines->push_back(line);
+            }
+            else {
+                std::cerr << "Skipping malformed line " << lineNumber << " in " << fileName << std::endl;
+            }
+            continue;
         }
-
         courses.push_back(course); // Add course to the vector
     }
 
     file.close(); // Always close file after reading
+    return true;
+}
+
+// =========================
+// Function to Fold the Old Edit Log into courses.txt
+// =========================
+// Runs on the compaction thread. Starts from courses.txt as it is on disk
+// (an empty catalog if there is no file yet), so only edits that were
+// logged ever reach the file. Lines of courses.txt that do not parse are
+// written back unchanged after the courses, so a fold never drops them.
+void CourseEditLog::foldOldLog() {
+    CourseCatalog merged;
+    std::vector<std::string> unparsedLines;
+    if (std::filesystem::exists(dataFileName) && !loadCourseFile(dataFileName, merged.courses, &unparsedLines)) {
+        return; // Keep the old log; the next load still replays it
+    }
+    rebuildPositions(merged);
+    replayEditLog(merged, oldLogFileName);
+
+    std::string tempFileName = std::string(dataFileName) + ".tmp";
+    {
+        std::ofstream file(tempFileName, std::ios::trunc);
+        if (!file.is_open()) {
+            std::cerr << "Failed to open the file: " << tempFileName << std::endl;
+            return;
+        }
+        for (const Course& course : merged.courses) {
+            file << formatCourseLine(course) << '\n';
+        }
+        for (const std::string& line : unparsedLines) {
+            file << line << '\n';
+        }
+    }
+
+    // Replace courses.txt in one step, then drop the log it now contains
+    std::error_code error;
+    std::filesystem::rename(tempFileName, dataFileName, error);
+    if (error) {
+        std::cerr << "Failed to replace " << dataFileName << ": " << error.message() << std::endl;
+        return;
+    }
+    std::filesystem::remove(oldLogFileName, error);
+}
+
+// =========================
+// Function to Load Courses
+// =========================
+// Replaces the catalog with courses.txt plus any edits still in the log.
+void loadDataStructure(CourseCatalog& catalog, CourseEditLog& editLog) {
+    editLog.waitForCompaction(); // courses.txt may be mid-rewrite
+
+    catalog.courses.clear();
+    catalog.order = unsortedOrder;
+    loadCourseFile(CourseEditLog::dataFileName, catalog.courses);
+    rebuildPositions(catalog);
+
+    // Bring the catalog up to date with edits made since the last compaction
+    std::size_t replayed = replayEditLog(catalog, CourseEditLog::oldLogFileName);
+    replayed += replayEditLog(catalog, CourseEditLog::logFileName);
+    editLog.setPendingEdits(replayed);
+    catalog.loaded = true;
 }
 
 // =========================
@@ -59,95 +497,1022 @@ void printCourseList(const std::vector<Course>& courses) {
 // =========================
 // Function to Print Info for One Course
 // =========================
-void printCourseInfo(const std::vector<Course>& courses, const std::string& courseNumber) {
+void printCourseDetails(const Course& course) {
+    std::cout << "\nCourse Number: " << course.courseNumber << std::endl;
+    std::cout << "Course Name: " << course.name << std::endl;
+
+    // Print prerequisites if they exist
+    if (!course.prerequisites.empty()) {
+        std::cout << "Prerequisites: ";
+        for (const std::string& prereq : course.prerequisites) {
+            std::cout << prereq << " ";
+        }
+        std::cout << std::endl;
+    }
+    else {
+        std::cout << "No prerequisites for this course." << std::endl;
+    }
+}
+
+// =========================
+// NEW: Lookup Function - By Key
+// =========================
+// Positions of all courses in Key order, built on the first lookup after
+// the catalog last changed (O(n log n)) and reused until the next change.
+template <typename Key>
+const std::vector<std::size_t>& sortedPositions(const CourseCatalog& catalog) {
+    constexpr std::size_t slot = keyOrder<Key> - 1;
+    std::vector<std::size_t>& index = catalog.keyIndexes[slot];
+    if (!catalog.keyIndexBuilt[slot]) {
+        const std::vector<Course>& courses = catalog.courses;
+        index.resize(courses.size());
+        std::iota(index.begin(), index.end(), std::size_t{ 0 });
+        std::sort(index.begin(), index.end(), [&](std::size_t a, std::size_t b) {
+            return KeyLess<Key>()(courses[a], courses[b]);
+            });
+        catalog.keyIndexBuilt[slot] = true;
+    }
+    return index;
+}
+
+// Returns the positions of all courses whose Key equals `value`.
+// Course numbers use the hash index, a matching sorted view is binary
+// searched in place, and any other key binary searches its sorted
+// position list, so every lookup is O(log n + matches).
+template <typename Key>
+std::vector<std::size_t> findCourses(const CourseCatalog& catalog, const KeyValue<Key>& value) {
+    std::vector<std::size_t> matches;
+    const std::vector<Course>& courses = catalog.courses;
+
+    if constexpr (std::is_same_v<Key, ByCourseNumber>) {
+        auto found = catalog.positions.find(value);
+        if (found != catalog.positions.end()) {
+            matches.push_back(found->second);
+        }
+    }
+    else if (catalog.order == keyOrder<Key>) {
+        auto first = std::partition_point(courses.begin(), courses.end(),
+            [&](const Course& course) { return Key::get(course) < value; });
+        for (auto it = first; it != courses.end() && Key::get(*it) == value; ++it) {
+            matches.push_back(static_cast<std::size_t>(it - courses.begin()));
+        }
+    }
+    else {
+        const std::vector<std::size_t>& index = sortedPositions<Key>(catalog);
+        auto first = std::partition_point(index.begin(), index.end(),
+            [&](std::size_t position) { return Key::get(courses[position]) < value; });
+        for (auto it = first; it != index.end() && Key::get(courses[*it]) == value; ++it) {
+            matches.push_back(*it);
+        }
+    }
+    return matches;
+}
+
+template <typename Key>
+void printCourseInfo(const CourseCatalog& catalog, const KeyValue<Key>& value) {
+    std::vector<std::size_t> matches = findCourses<Key>(catalog, value);
+    for (std::size_t position : matches) {
+        printCourseDetails(catalog.courses[position]);
+    }
+
+    // If course not found
+    if (matches.empty()) {
+        std::cout << "Course not found: " << value << std::endl;
+    }
+}
+
+// =========================
+// NEW: Sorting Function - By Key
+// =========================
+template <typename Key>
+void sortCourses(CourseCatalog& catalog) {
+    std::sort(catalog.courses.begin(), catalog.courses.end(), KeyLess<Key>());
+    catalog.order = keyOrder<Key>;
+    rebuildPositions(catalog); // Every course moved
+}
+
+// =========================
+// NEW: Paginated Listing
+// =========================
+// Prints courses [offset, offset + limit) of the vector as it is stored.
+void printCourseRange(const std::vector<Course>& courses, std::size_t offset, std::size_t limit) {
+    if (offset >= courses.size() || limit == 0) {
+        std::cout << "No courses on this page." << std::endl;
+        return;
+    }
+    limit = std::min(limit, courses.size() - offset); // offset + limit cannot wrap
+    std::size_t end = offset + limit;
+    std::cout << "\nCourse List (courses " << offset + 1 << " to " << end << "):\n";
+    for (std::size_t i = offset; i < end; ++i) {
+        std::cout << courses[i].courseNumber << " - " << courses[i].name << std::endl;
+    }
+}
+
+// Prints courses [offset, offset + limit) in Key order.
+// If the vector is already sorted by that key we seek directly into it (O(k)).
+// Otherwise only the first offset + limit entries are selected with
+// nth_element and then sorted, so a page costs O(n + k log k) rather than
+// the O(n log n) of a full sort. The course vector itself is never reordered.
+template <typename Key>
+void printCoursePage(const CourseCatalog& catalog, std::size_t offset, std::size_t limit) {
+    const std::vector<Course>& courses = catalog.courses;
+
+    // Sorted view already exists: seek into it
+    if (catalog.order == keyOrder<Key>) {
+        printCourseRange(courses, offset, limit);
+        return;
+    }
+    if (offset >= courses.size() || limit == 0) {
+        std::cout << "No courses on this page." << std::endl;
+        return;
+    }
+    limit = std::min(limit, courses.size() - offset); // offset + limit cannot wrap
+    std::size_t end = offset + limit;
+    std::cout << "\nCourse List (courses " << offset + 1 << " to " << end << "):\n";
+
+    std::vector<const Course*> view;
+    view.reserve(courses.size());
     for (const Course& course : courses) {
-        if (course.courseNumber == courseNumber) {
-            std::cout << "\nCourse Number: " << course.courseNumber << std::endl;
-            std::cout << "Course Name: " << course.name << std::endl;
-
-            // Print prerequisites if they exist
-            if (!course.prerequisites.empty()) {
-                std::cout << "Prerequisites: ";
-                for (const std::string& prereq : course.prerequisites) {
-                    std::cout << prereq << " ";
+        view.push_back(&course);
+    }
+
+    // Partition so the first `end` entries are the smallest, then order just those
+    if (end < view.size()) {
+        std::nth_element(view.begin(), view.begin() + end, view.end(), KeyLess<Key>());
+    }
+    std::sort(view.begin(), view.begin() + end, KeyLess<Key>());
+
+    for (std::size_t i = offset; i < end; ++i) {
+        std::cout << view[i]->courseNumber << " - " << view[i]->name << std::endl;
+    }
+}
+
+// =========================
+// NEW: User Interface to Choose a Page
+// =========================
+void pageMenu(const CourseCatalog& catalog) {
+    std::size_t orderChoice = 0;
+    long long offset = 0; // Signed, so that negative input can be rejected
+    long long limit = 0;
+    std::size_t fileOrderChoice = courseKeyCount + 1;
+
+    std::cout << "\nPage Order Options:\n";
+    printKeyOptions();
+    std::cout << fileOrderChoice << ". File Order\n";
+    std::cout << "Choose page order: ";
+    std::cin >> orderChoice;
+    std::cout << "Start at course (0 = first): ";
+    std::cin >> offset;
+    std::cout << "Number of courses to show: ";
+    std::cin >> limit;
+
+    if (!std::cin || offset < 0 || limit < 0) {
+        std::cin.clear();
+        std::cin.ignore(10000, '\n');
+        std::cout << "Start and number of courses must be 0 or more. No page printed.\n";
+        return;
+    }
+    if (orderChoice == fileOrderChoice) {
+        printCourseRange(catalog.courses, static_cast<std::size_t>(offset), static_cast<std::size_t>(limit));
+        return;
+    }
+    bool valid = orderChoice > 0 && visitKey(orderChoice - 1, [&](auto key) {
+        printCoursePage<decltype(key)>(catalog, static_cast<std::size_t>(offset), static_cast<std::size_t>(limit));
+        });
+    if (!valid) {
+        std::cout << "Invalid choice. No page printed.\n";
+    }
+}
+
+// =========================
+// NEW: Catalog Diff Between Two Course Files
+// =========================
+// Streams one line per difference as it is found:
+//   + CS101 - Name                      added
+//   - CS101 - Name                      removed
+//   ~ CS101 name: Old -> New            renamed
+//   ~ CS101 prerequisites: +A -B        prerequisites changed
+//   ! CS101 appears 2 times in the old file and 1 in the new
+// Both files are parsed in parallel, then the old catalog is hashed on
+// courseNumber and probed with each new course, so the diff is O(n + m).
+// A course number listed more than once is matched by occurrence: the
+// second CS101 in the new file is compared with the second one in the old
+// file, and the duplicate itself is reported with a "!" line.
+// Prerequisites are compared as sets, so reordering them is not a change.
+bool diffCourseFiles(const std::string& oldFileName, const std::string& newFileName, std::ostream& out) {
+    std::vector<Course> oldCourses;
+    std::vector<Course> newCourses;
+    bool oldLoaded = false;
+
+    std::thread oldLoader([&]() {
+        oldLoaded = loadCourseFile(oldFileName, oldCourses);
+        });
+    bool newLoaded = loadCourseFile(newFileName, newCourses);
+    oldLoader.join();
+    if (!oldLoaded || !newLoaded) {
+        return false;
+    }
+
+    // Build side: old courses keyed by course number, in file order
+    std::unordered_map<std::string, std::vector<std::size_t>> oldPositions;
+    oldPositions.reserve(oldCourses.size());
+    for (std::size_t i = 0; i < oldCourses.size(); ++i) {
+        oldPositions[oldCourses[i].courseNumber].push_back(i);
+    }
+    std::vector<bool> matched(oldCourses.size(), false);
+    std::unordered_map<std::string, std::size_t> newCounts; // Occurrences seen so far in the new file
+    newCounts.reserve(newCourses.size());
+
+    auto sortedSet = [](std::vector<std::string> values) {
+        std::sort(values.begin(), values.end());
+        values.erase(std::unique(values.begin(), values.end()), values.end());
+        return values;
+        };
+
+    std::size_t added = 0, removed = 0, renamed = 0, prereqsChanged = 0, duplicated = 0;
+
+    // Probe side: walk the new file in order, pairing the k-th occurrence
+    // of a number with its k-th occurrence in the old file
+    for (const Course& course : newCourses) {
+        std::size_t occurrence = newCounts[course.courseNumber]++;
+        auto found = oldPositions.find(course.courseNumber);
+        if (found == oldPositions.end() || occurrence >= found->second.size()) {
+            out << "+ " << course.courseNumber << " - " << course.name << '\n';
+            added++;
+            continue;
+        }
+        std::size_t oldIndex = found->second[occurrence];
+        const Course& oldCourse = oldCourses[oldIndex];
+        matched[oldIndex] = true;
+
+        if (oldCourse.name != course.name) {
+            out << "~ " << course.courseNumber << " name: " << oldCourse.name << " -> " << course.name << '\n';
+            renamed++;
+        }
+
+        std::vector<std::string> before = sortedSet(oldCourse.prerequisites);
+        std::vector<std::string> after = sortedSet(course.prerequisites);
+        if (before != after) {
+            std::vector<std::string> gained;
+            std::vector<std::string> lost;
+            std::set_difference(after.begin(), after.end(), before.begin(), before.end(), std::back_inserter(gained));
+            std::set_difference(before.begin(), before.end(), after.begin(), after.end(), std::back_inserter(lost));
+
+            out << "~ " << course.courseNumber << " prerequisites:";
+            for (const std::string& prereq : gained) {
+                out << " +" << prereq;
+            }
+            for (const std::string& prereq : lost) {
+                out << " -" << prereq;
+            }
+            out << '\n';
+            prereqsChanged++;
+        }
+    }
+
+    // Anything in the old file that was never probed has been removed
+    for (std::size_t i = 0; i < oldCourses.size(); ++i) {
+        if (!matched[i]) {
+            out << "- " << oldCourses[i].courseNumber << " - " << oldCourses[i].name << '\n';
+            removed++;
+        }
+    }
+
+    // Report each duplicated number once, in the order it first appears;
+    // entries are erased as they are reported
+    auto reportDuplicate = [&](const std::string& courseNumber, std::size_t oldCount, std::size_t newCount) {
+        if (oldCount > 1 || newCount > 1) {
+            out << "! " << courseNumber << " appears " << oldCount << " times in the old file and "
+                << newCount << " in the new\n";
+            duplicated++;
+        }
+        };
+    for (const Course& course : newCourses) {
+        auto counted = newCounts.find(course.courseNumber);
+        if (counted == newCounts.end()) {
+            continue;
+        }
+        auto found = oldPositions.find(course.courseNumber);
+        reportDuplicate(course.courseNumber, found == oldPositions.end() ? 0 : found->second.size(), counted->second);
+        newCounts.erase(counted);
+        if (found != oldPositions.end()) {
+            oldPositions.erase(found);
+        }
+    }
+    for (const Course& course : oldCourses) {
+        auto found = oldPositions.find(course.courseNumber);
+        if (found == oldPositions.end()) {
+            continue;
+        }
+        reportDuplicate(course.courseNumber, found->second.size(), 0);
+        oldPositions.erase(found);
+    }
+
+    out << "Summary: " << added << " added, " << removed << " removed, "
+        << renamed << " renamed, " << prereqsChanged << " with changed prerequisites, "
+        << duplicated << " duplicated numbers" << std::endl;
+    return true;
+}
+
+// =========================
+// NEW: User Interface to Compare Course Files
+// =========================
+void diffMenu() {
+    std::string oldFileName;
+    std::string newFileName;
+
+    std::cout << "Enter old course file: ";
+    std::cin >> oldFileName;
+    std::cout << "Enter new course file: ";
+    std::cin >> newFileName;
+    std::cout << "\nCatalog Differences:\n";
+    diffCourseFiles(oldFileName, newFileName, std::cout);
+}
+
+// =========================
+// NEW: Front-Coded String Column
+// =========================
+// Stores a sorted list of strings in blocks of `blockSize` entries. Each entry
+// is (shared prefix length, suffix length, suffix bytes) relative to the entry
+// before it, and the first entry of every block is stored in full (a restart
+// point). Course numbers sharing prefixes like "MATH" then cost only a few
+// bytes each. lowerBound binary searches the restart points directly in the
+// encoded bytes and then scans at most one block, so lookups stay O(log n).
+class FrontCodedColumn {
+public:
+    static constexpr std::size_t blockSize = 16;
+
+    // `values` must already be sorted
+    void build(const std::vector<std::string_view>& values) {
+        data.clear();
+        restarts.clear();
+        count = values.size();
+
+        std::string_view previous;
+        for (std::size_t i = 0; i < values.size(); ++i) {
+            std::string_view value = values[i];
+            std::size_t shared = 0;
+            if (i % blockSize == 0) {
+                restarts.push_back(static_cast<std::uint32_t>(data.size()));
+            }
+            else {
+                std::size_t limit = std::min(previous.size(), value.size());
+                while (shared < limit && previous[shared] == value[shared]) {
+                    shared++;
                 }
-                std::cout << std::endl;
+            }
+            writeVarint(shared);
+            writeVarint(value.size() - shared);
+            data.append(value.data() + shared, value.size() - shared);
+            previous = value;
+        }
+    }
+
+    std::size_t size() const {
+        return count;
+    }
+
+    // Encoded size, including the restart table
+    std::size_t bytes() const {
+        return data.size() + restarts.size() * sizeof(std::uint32_t);
+    }
+
+    std::string get(std::size_t index) const {
+        std::string value;
+        std::size_t offset = restarts[index / blockSize];
+        for (std::size_t i = 0; i <= index % blockSize; ++i) {
+            decodeNext(offset, value);
+        }
+        return value;
+    }
+
+    // Index of the first entry not less than `value` (size() if none)
+    std::size_t lowerBound(std::string_view value) const {
+        // Find the first block whose restart entry is not less than `value`;
+        // the answer is in that block or at the end of the block before it.
+        std::size_t low = 0;
+        std::size_t high = restarts.size();
+        while (low < high) {
+            std::size_t mid = low + (high - low) / 2;
+            if (restartValue(mid) < value) {
+                low = mid + 1;
             }
             else {
-                std::cout << "No prerequisites for this course." << std::endl;
+                high = mid;
             }
-            return;
         }
+        if (low == 0) {
+            return 0;
+        }
+
+        std::size_t block = low - 1;
+        std::size_t index = block * blockSize;
+        std::size_t end = std::min(count, index + blockSize);
+        std::size_t offset = restarts[block];
+        std::string current;
+        for (; index < end; ++index) {
+            decodeNext(offset, current);
+            if (!(current < value)) {
+                break;
+            }
+        }
+        return index;
     }
 
-    // If course not found
-    std::cout << "Course not found: " << courseNumber << std::endl;
+    void write(std::ostream& out) const {
+        writeValue(out, static_cast<std::uint32_t>(count));
+        writeValue(out, static_cast<std::uint32_t>(restarts.size()));
+        writeValue(out, static_cast<std::uint32_t>(data.size()));
+        out.write(reinterpret_cast<const char*>(restarts.data()), restarts.size() * sizeof(std::uint32_t));
+        out.write(data.data(), data.size());
+    }
+
+    // Rejects any column whose restart table or entries do not decode
+    // cleanly, so get and lowerBound never read outside `data` afterwards
+    bool read(std::istream& in) {
+        std::uint32_t entries = 0, restartCount = 0, dataSize = 0;
+        if (!readValue(in, entries) || !readValue(in, restartCount) || !readValue(in, dataSize)) {
+            return false;
+        }
+        if (restartCount != (entries + blockSize - 1) / blockSize
+            || !fits(in, std::uint64_t{ restartCount } * sizeof(std::uint32_t) + dataSize)) {
+            return false;
+        }
+        count = entries;
+        restarts.resize(restartCount);
+        data.resize(dataSize);
+        in.read(reinterpret_cast<char*>(restarts.data()), restartCount * sizeof(std::uint32_t));
+        in.read(data.data(), dataSize);
+        return static_cast<bool>(in) && validate();
+    }
+
+    template <typename T>
+    static void writeValue(std::ostream& out, T value) {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    template <typename T>
+    static bool readValue(std::istream& in, T& value) {
+        return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+    }
+
+    // True if at least `bytes` remain in the stream, so a corrupt size field
+    // cannot make us allocate more than the file holds
+    static bool fits(std::istream& in, std::uint64_t bytes) {
+        std::istream::pos_type here = in.tellg();
+        if (here == std::istream::pos_type(-1) || !in.seekg(0, std::ios::end)) {
+            return false;
+        }
+        std::uint64_t left = static_cast<std::uint64_t>(in.tellg() - here);
+        in.seekg(here);
+        return bytes <= left;
+    }
+
+private:
+    void writeVarint(std::size_t value) {
+        while (value >= 0x80) {
+            data.push_back(static_cast<char>((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        data.push_back(static_cast<char>(value));
+    }
+
+    std::size_t readVarint(std::size_t& offset) const {
+        std::size_t value = 0;
+        int shift = 0;
+        unsigned char byte = 0;
+        do {
+            byte = static_cast<unsigned char>(data[offset++]);
+            value |= static_cast<std::size_t>(byte & 0x7F) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+        return value;
+    }
+
+    // readVarint for untrusted data: fails instead of running off the end
+    bool readCheckedVarint(std::size_t& offset, std::size_t& value) const {
+        value = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            if (offset >= data.size()) {
+                return false;
+            }
+            unsigned char byte = static_cast<unsigned char>(data[offset++]);
+            value |= static_cast<std::size_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Decodes every entry once: restarts must point at full entries, each
+    // shared prefix must exist, each suffix must fit, entries must be sorted
+    // and the last one must end exactly at the end of `data`
+    bool validate() const {
+        std::size_t offset = 0;
+        std::string previous;
+        std::string current;
+        for (std::size_t i = 0; i < count; ++i) {
+            std::size_t shared = 0, suffix = 0;
+            if (i % blockSize == 0 && restarts[i / blockSize] != offset) {
+                return false;
+            }
+            if (!readCheckedVarint(offset, shared) || !readCheckedVarint(offset, suffix)) {
+                return false;
+            }
+            if ((i % blockSize == 0 && shared != 0) || shared > previous.size() || suffix > data.size() - offset) {
+                return false;
+            }
+            current.assign(previous, 0, shared);
+            current.append(data, offset, suffix);
+            offset += suffix;
+            if (current < previous) {
+                return false;
+            }
+            previous.swap(current);
+        }
+        return offset == data.size();
+    }
+
+    // Rebuilds the next entry in `value` from the previous one
+    void decodeNext(std::size_t& offset, std::string& value) const {
+        std::size_t shared = readVarint(offset);
+        std::size_t suffix = readVarint(offset);
+        value.resize(shared);
+        value.append(data, offset, suffix);
+        offset += suffix;
+    }
+
+    // Restart entries are stored in full, so they can be compared in place
+    std::string_view restartValue(std::size_t block) const {
+        std::size_t offset = restarts[block];
+        readVarint(offset); // Shared length is always 0
+        std::size_t length = readVarint(offset);
+        return std::string_view(data).substr(offset, length);
+    }
+
+    std::string data;                   // Encoded entries
+    std::vector<std::uint32_t> restarts; // Byte offset of each block's first entry
+    std::size_t count = 0;
+};
+
+// =========================
+// NEW: Compressed Catalog Snapshot
+// =========================
+// Read-only copy of the catalog with both string columns front-coded:
+// course numbers in course number order (row order) and names in name
+// order, with permutations between the two. Prerequisites are stored as row
+// numbers; prerequisites naming a course that is not in the catalog are kept
+// as strings and marked with the top bit.
+class CompressedCatalog {
+public:
+    void build(const CourseCatalog& catalog) {
+        const std::vector<Course>& courses = catalog.courses;
+
+        // Row order is course number order; reuse the sorted view if present
+        std::vector<const Course*> rows;
+        rows.reserve(courses.size());
+        for (const Course& course : courses) {
+            rows.push_back(&course);
+        }
+        if (catalog.order != keyOrder<ByCourseNumber>) {
+            std::sort(rows.begin(), rows.end(), KeyLess<ByCourseNumber>());
+        }
+
+        std::vector<std::string_view> values;
+        values.reserve(rows.size());
+        for (const Course* course : rows) {
+            values.push_back(course->courseNumber);
+        }
+        numbers.build(values);
+
+        // Name column in name order, mapped back to rows
+        nameRows.resize(rows.size());
+        std::iota(nameRows.begin(), nameRows.end(), 0u);
+        std::sort(nameRows.begin(), nameRows.end(), [&](std::uint32_t a, std::uint32_t b) {
+            return KeyLess<ByCourseName>()(rows[a], rows[b]);
+            });
+        rowNames.resize(rows.size());
+        values.clear();
+        for (std::uint32_t i = 0; i < nameRows.size(); ++i) {
+            rowNames[nameRows[i]] = i;
+            values.push_back(rows[nameRows[i]]->name);
+        }
+        names.build(values);
+
+        // Prerequisites as row numbers
+        prereqOffsets.assign(1, 0);
+        prereqRows.clear();
+        externalPrereqs.clear();
+        for (const Course* course : rows) {
+            for (const std::string& prereq : course->prerequisites) {
+                std::size_t row = numbers.lowerBound(prereq);
+                if (row < numbers.size() && rows[row]->courseNumber == prereq) {
+                    prereqRows.push_back(static_cast<std::uint32_t>(row));
+                }
+                else {
+                    prereqRows.push_back(externalFlag | static_cast<std::uint32_t>(externalPrereqs.size()));
+                    externalPrereqs.push_back(prereq);
+                }
+            }
+            prereqOffsets.push_back(static_cast<std::uint32_t>(prereqRows.size()));
+        }
+        ready = true;
+    }
+
+    std::size_t size() const {
+        return numbers.size();
+    }
+
+    // True once build or load has succeeded, even if the snapshot is empty
+    bool available() const {
+        return ready;
+    }
+
+    // Decodes the course with the given number; false if it is not present
+    bool find(const std::string& courseNumber, Course& course) const {
+        std::size_t row = numbers.lowerBound(courseNumber);
+        if (row >= numbers.size() || numbers.get(row) != courseNumber) {
+            return false;
+        }
+        course.courseNumber = courseNumber;
+        course.name = names.get(rowNames[row]);
+        course.prerequisites.clear();
+        for (std::uint32_t i = prereqOffsets[row]; i < prereqOffsets[row + 1]; ++i) {
+            std::uint32_t prereq = prereqRows[i];
+            if (prereq & externalFlag) {
+                course.prerequisites.push_back(externalPrereqs[prereq & ~externalFlag]);
+            }
+            else {
+                course.prerequisites.push_back(numbers.get(prereq));
+            }
+        }
+        return true;
+    }
+
+    std::size_t bytes() const {
+        std::size_t total = numbers.bytes() + names.bytes();
+        total += (nameRows.size() + rowNames.size() + prereqOffsets.size() + prereqRows.size()) * sizeof(std::uint32_t);
+        for (const std::string& prereq : externalPrereqs) {
+            total += prereq.size() + 1;
+        }
+        return total;
+    }
+
+    bool save(const std::string& fileName) const {
+        std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            std::cerr << "Failed to open the file: " << fileName << std::endl;
+            return false;
+        }
+        file.write(magic, sizeof(magic));
+        numbers.write(file);
+        names.write(file);
+        writeArray(file, nameRows);
+        writeArray(file, prereqOffsets);
+        writeArray(file, prereqRows);
+        FrontCodedColumn::writeValue(file, static_cast<std::uint32_t>(externalPrereqs.size()));
+        for (const std::string& prereq : externalPrereqs) {
+            file << prereq << '\n';
+        }
+        return static_cast<bool>(file);
+    }
+
+    // Reads into a scratch snapshot and only replaces this one if every
+    // offset and row number in the file is in range
+    bool load(const std::string& fileName) {
+        std::ifstream file(fileName, std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Failed to open the file: " << fileName << std::endl;
+            return false;
+        }
+        CompressedCatalog loaded;
+        if (!loaded.read(file)) {
+            std::cerr << "Invalid compressed snapshot: " << fileName << std::endl;
+            return false;
+        }
+        *this = std::move(loaded);
+        return true;
+    }
+
+    static constexpr const char* snapshotFileName = "courses.fcs";
+
+private:
+    static void writeArray(std::ostream& out, const std::vector<std::uint32_t>& values) {
+        FrontCodedColumn::writeValue(out, static_cast<std::uint32_t>(values.size()));
+        out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(std::uint32_t));
+    }
+
+    bool read(std::istream& in) {
+        char header[sizeof(magic)] = {};
+        in.read(header, sizeof(header));
+        std::uint32_t externalCount = 0;
+        if (std::string(header, sizeof(header)) != std::string(magic, sizeof(magic))
+            || !numbers.read(in) || !names.read(in)
+            || !readArray(in, nameRows) || !readArray(in, prereqOffsets) || !readArray(in, prereqRows)
+            || !FrontCodedColumn::readValue(in, externalCount)
+            || !FrontCodedColumn::fits(in, externalCount)) { // At least a newline each
+            return false;
+        }
+        externalPrereqs.resize(externalCount);
+        for (std::string& prereq : externalPrereqs) {
+            if (!std::getline(in, prereq)) {
+                return false;
+            }
+        }
+
+        // Columns and tables must all describe the same rows
+        std::size_t count = numbers.size();
+        if (names.size() != count || nameRows.size() != count || prereqOffsets.size() != count + 1
+            || prereqOffsets.front() != 0 || prereqOffsets.back() != prereqRows.size()) {
+            return false;
+        }
+        for (std::size_t row = 0; row < count; ++row) {
+            if (prereqOffsets[row] > prereqOffsets[row + 1]) {
+                return false;
+            }
+        }
+        for (std::uint32_t prereq : prereqRows) {
+            std::uint32_t index = prereq & ~externalFlag;
+            if (index >= ((prereq & externalFlag) ? externalPrereqs.size() : count)) {
+                return false;
+            }
+        }
+
+        // nameRows must be a permutation of the rows
+        rowNames.assign(count, 0);
+        std::vector<bool> seen(count, false);
+        for (std::uint32_t i = 0; i < count; ++i) {
+            std::uint32_t row = nameRows[i];
+            if (row >= count || seen[row]) {
+                return false;
+            }
+            seen[row] = true;
+            rowNames[row] = i;
+        }
+        ready = true;
+        return true;
+    }
+
+    static bool readArray(std::istream& in, std::vector<std::uint32_t>& values) {
+        std::uint32_t size = 0;
+        if (!FrontCodedColumn::readValue(in, size)
+            || !FrontCodedColumn::fits(in, std::uint64_t{ size } * sizeof(std::uint32_t))) {
+            return false;
+        }
+        values.resize(size);
+        return static_cast<bool>(in.read(reinterpret_cast<char*>(values.data()), size * sizeof(std::uint32_t)));
+    }
+
+    static constexpr char magic[4] = { 'F', 'C', 'S', '1' };
+    static constexpr std::uint32_t externalFlag = 0x80000000u;
+
+    FrontCodedColumn numbers;                // Course numbers, row order
+    FrontCodedColumn names;                  // Course names, name order
+    std::vector<std::uint32_t> nameRows;     // Name position -> row
+    std::vector<std::uint32_t> rowNames;     // Row -> name position (rebuilt on load)
+    std::vector<std::uint32_t> prereqOffsets; // Row -> first entry in prereqRows
+    std::vector<std::uint32_t> prereqRows;   // Prerequisite rows, or externalFlag | index
+    std::vector<std::string> externalPrereqs; // Prerequisites not in the catalog
+    bool ready = false;                      // Set by build and by a successful load
+};
+
+// =========================
+// NEW: User Interface for Compressed Snapshots
+// =========================
+void saveSnapshotMenu(const CourseCatalog& catalog, CompressedCatalog& compressed) {
+    compressed.build(catalog);
+
+    // Uncompressed footprint: the strings plus their std::string headers
+    std::size_t rawBytes = 0;
+    for (const Course& course : catalog.courses) {
+        rawBytes += sizeof(Course) + course.courseNumber.size() + course.name.size();
+        for (const std::string& prereq : course.prerequisites) {
+            rawBytes += sizeof(std::string) + prereq.size();
+        }
+    }
+
+    if (compressed.save(CompressedCatalog::snapshotFileName)) {
+        std::cout << "Saved " << compressed.size() << " courses to " << CompressedCatalog::snapshotFileName
+            << " (" << compressed.bytes() << " bytes compressed, " << rawBytes << " bytes uncompressed).\n";
+    }
+}
+
+void snapshotLookupMenu(CompressedCatalog& compressed) {
+    // Read the file once; after that, use what was saved or loaded
+    if (!compressed.available() && !compressed.load(CompressedCatalog::snapshotFileName)) {
+        return;
+    }
+    if (compressed.size() == 0) {
+        std::cout << "The snapshot has no courses.\n";
+        return;
+    }
+
+    std::string courseNumber;
+    std::cout << "Enter course number: ";
+    std::cin >> courseNumber;
+
+    Course course;
+    if (compressed.find(courseNumber, course)) {
+        printCourseDetails(course);
+    }
+    else {
+        std::cout << "Course not found: " << courseNumber << std::endl;
+    }
 }
 
 // =========================
-// NEW: Sorting Function - By Course Number
+// NEW: User Interface to Read a Course
 // =========================
-void sortCoursesByNumber(std::vector<Course>& courses) {
-    std::sort(courses.begin(), courses.end(), [](const Course& a, const Course& b) {
-        return a.courseNumber < b.courseNumber; // Alphabetical comparison
-        });
+// Strips leading and trailing spaces and tabs
+std::string trimSpaces(const std::string& text) {
+    std::size_t first = text.find_first_not_of(" \t");
+    if (first == std::string::npos) {
+        return "";
+    }
+    std::size_t last = text.find_last_not_of(" \t");
+    return text.substr(first, last - first + 1);
+}
+
+// Prompts for the name and comma separated prerequisites of a course.
+// Returns false if the name cannot be stored: the file and the edit log are
+// comma separated, so a comma in the name would split it on the next load.
+bool readCourseDetails(Course& course) {
+    std::string prereqLine;
+
+    std::cout << "Enter course name: ";
+    std::cin.ignore(10000, '\n');
+    std::getline(std::cin, course.name);
+    course.name = trimSpaces(course.name);
+    std::cout << "Enter prerequisites separated by commas (blank for none): ";
+    std::getline(std::cin, prereqLine);
+
+    if (course.name.find(',') != std::string::npos) {
+        std::cout << "Course names cannot contain commas.\n";
+        return false;
+    }
+
+    std::istringstream ss(prereqLine);
+    std::string prereq;
+    while (std::getline(ss, prereq, ',')) {
+        prereq = trimSpaces(prereq);
+        if (!prereq.empty()) {
+            course.prerequisites.push_back(prereq);
+        }
+    }
+    return true;
 }
 
 // =========================
-// NEW: Sorting Function - By Course Name
+// NEW: User Interface to Edit Courses
 // =========================
-void sortCoursesByName(std::vector<Course>& courses) {
-    std::sort(courses.begin(), courses.end(), [](const Course& a, const Course& b) {
-        return a.name < b.name; // Alphabetical comparison
-        });
+void addCourseMenu(CourseCatalog& catalog, CourseEditLog& editLog) {
+    Course course;
+    std::cout << "Enter course number: ";
+    std::cin >> course.courseNumber;
+    if (!readCourseDetails(course)) {
+        std::cout << "Course not added.\n";
+        return;
+    }
+
+    if (addCourse(catalog, course)) {
+        editLog.append('A', formatCourseLine(course));
+        editLog.maybeCompact(catalog);
+        std::cout << "Course added: " << course.courseNumber << std::endl;
+    }
+    else {
+        std::cout << "Course already exists: " << course.courseNumber << std::endl;
+    }
+}
+
+void updateCourseMenu(CourseCatalog& catalog, CourseEditLog& editLog) {
+    Course course;
+    std::cout << "Enter course number: ";
+    std::cin >> course.courseNumber;
+    if (catalog.positions.count(course.courseNumber) == 0) {
+        std::cout << "Course not found: " << course.courseNumber << std::endl;
+        return;
+    }
+    if (!readCourseDetails(course)) {
+        std::cout << "Course not updated.\n";
+        return;
+    }
+
+    updateCourse(catalog, course);
+    editLog.append('U', formatCourseLine(course));
+    editLog.maybeCompact(catalog);
+    std::cout << "Course updated: " << course.courseNumber << std::endl;
+}
+
+void deleteCourseMenu(CourseCatalog& catalog, CourseEditLog& editLog) {
+    std::string courseNumber;
+    std::cout << "Enter course number: ";
+    std::cin >> courseNumber;
+
+    if (deleteCourse(catalog, courseNumber)) {
+        editLog.append('D', courseNumber);
+        editLog.maybeCompact(catalog);
+        std::cout << "Course deleted: " << courseNumber << std::endl;
+    }
+    else {
+        std::cout << "Course not found: " << courseNumber << std::endl;
+    }
 }
 
 // =========================
 // NEW: User Interface to Choose Sort Type
 // =========================
-void sortMenu(std::vector<Course>& courses) {
-    int sortChoice = 0;
+void sortMenu(CourseCatalog& catalog) {
+    std::size_t sortChoice = 0;
 
     std::cout << "\nSort Options:\n";
-    std::cout << "1. Sort by Course Number (e.g., CS101 < CS201)\n";
-    std::cout << "2. Sort by Course Name (e.g., Algorithms < Programming)\n";
+    printKeyOptions();
     std::cout << "Choose sorting option: ";
     std::cin >> sortChoice;
 
     // Apply user's choice
-    if (sortChoice == 1) {
-        sortCoursesByNumber(courses);
-        std::cout << "Courses sorted by course number.\n";
-    }
-    else if (sortChoice == 2) {
-        sortCoursesByName(courses);
-        std::cout << "Courses sorted by course name.\n";
-    }
-    else {
+    bool valid = sortChoice > 0 && visitKey(sortChoice - 1, [&](auto key) {
+        using Key = decltype(key);
+        sortCourses<Key>(catalog);
+        std::cout << "Courses sorted by " << Key::label << ".\n";
+        });
+    if (!valid) {
         std::cout << "Invalid choice. No sorting applied.\n";
     }
 }
 
+// =========================
+// NEW: User Interface to Find Courses by Any Key
+// =========================
+void findMenu(const CourseCatalog& catalog) {
+    std::size_t keyChoice = 0;
+
+    std::cout << "\nFind Options:\n";
+    printKeyOptions();
+    std::cout << "Choose key to search by: ";
+    std::cin >> keyChoice;
+
+    bool valid = keyChoice > 0 && visitKey(keyChoice - 1, [&](auto key) {
+        using Key = decltype(key);
+        std::cout << "Enter " << Key::label << ": ";
+        if constexpr (std::is_arithmetic_v<KeyValue<Key>>) {
+            KeyValue<Key> value{};
+            if (!(std::cin >> value)) {
+                std::cin.clear();
+                std::cin.ignore(10000, '\n');
+                std::cout << "Invalid value. No search done.\n";
+                return;
+            }
+            printCourseInfo<Key>(catalog, value);
+        }
+        else {
+            // Whole line, since names contain spaces
+            std::string value;
+            std::getline(std::cin >> std::ws, value);
+            printCourseInfo<Key>(catalog, value);
+        }
+        });
+    if (!valid) {
+        std::cout << "Invalid choice. No search done.\n";
+    }
+}
+
 // =========================
 // Main Program Loop
 // =========================
-int main() {
-    std::vector<Course> courses; // Main data structure to store courses
+int main(int argc, char* argv[]) {
+    // Diff mode: planner --diff <old file> <new file>
+    if (argc == 4 && std::string(argv[1]) == "--diff") {
+        return diffCourseFiles(argv[2], argv[3], std::cout) ? 0 : 1;
+    }
+
+    CourseCatalog catalog;                 // Main data structure to store courses
+    std::vector<Course>& courses = catalog.courses;
+    CourseEditLog editLog;                 // Persists edits between loads
+    CompressedCatalog compressed;          // Last saved compressed snapshot
 
     int choice = 0;
-    while (choice != 9) {
+    while (choice != 13) {
         std::cout << "\n=== Course Planner Menu ===\n";
         std::cout << "1. Load Data Structure\n";
         std::cout << "2. Print Course List\n";
         std::cout << "3. Print Course\n";
         std::cout << "4. Sort Courses (NEW)\n"; // NEW menu option
-        std::cout << "9. Exit\n";
+        std::cout << "5. Print Course Page (NEW)\n"; // NEW menu option
+        std::cout << "6. Add Course (NEW)\n";        // NEW menu option
+        std::cout << "7. Update Course (NEW)\n";     // NEW menu option
+        std::cout << "8. Delete Course (NEW)\n";     // NEW menu option
+        std::cout << "9. Compare Course Files (NEW)\n";         // NEW menu option
+        std::cout << "10. Save Compressed Snapshot (NEW)\n";    // NEW menu option
+        std::cout << "11. Print Course from Snapshot (NEW)\n";  // NEW menu option
+        std::cout << "12. Find Courses by Key (NEW)\n";         // NEW menu option
+        std::cout << "13. Exit\n";
         std::cout << "What would you like to do? ";
         std::cin >> choice;
 
         switch (choice) {
         case 1:
-            loadDataStructure(courses); // Load from file
+            loadDataStructure(catalog, editLog); // Load from file
             std::cout << "Data loaded.\n";
             break;
         case 2:
@@ -166,7 +1531,7 @@ int main() {
                 std::string courseNumber;
                 std::cout << "Enter course number: ";
                 std::cin >> courseNumber;
-                printCourseInfo(courses, courseNumber); // Search and display course
+                printCourseInfo<ByCourseNumber>(catalog, courseNumber); // Search and display course
             }
             break;
         case 4:
@@ -174,10 +1539,64 @@ int main() {
                 std::cout << "Please load data first.\n";
             }
             else {
-                sortMenu(courses); // Call new sort UI
+                sortMenu(catalog); // Call new sort UI
+            }
+            break;
+        case 5:
+            if (courses.empty()) {
+                std::cout << "Please load data first.\n";
+            }
+            else {
+                pageMenu(catalog); // Print one page of the list
+            }
+            break;
+        case 6:
+            if (!catalog.loaded) {
+                std::cout << "Please load data first.\n";
+            }
+            else {
+                addCourseMenu(catalog, editLog);
+            }
+            break;
+        case 7:
+            if (!catalog.loaded) {
+                std::cout << "Please load data first.\n";
+            }
+            else {
+                updateCourseMenu(catalog, editLog);
+            }
+            break;
+        case 8:
+            if (!catalog.loaded) {
+                std::cout << "Please load data first.\n";
+            }
+            else {
+                deleteCourseMenu(catalog, editLog);
             }
             break;
         case 9:
+            diffMenu();
+            break;
+        case 10:
+            if (courses.empty()) {
+                std::cout << "Please load data first.\n";
+            }
+            else {
+                saveSnapshotMenu(catalog, compressed);
+            }
+            break;
+        case 11:
+            snapshotLookupMenu(compressed);
+            break;
+        case 12:
+            if (courses.empty()) {
+                std::cout << "Please load data first.\n";
+            }
+            else {
+                findMenu(catalog);
+            }
+            break;
+        case 13:
             std::cout << "Exiting. Goodbye!\n";
             break;
         default:
@@ -15,2396 +15,7714 @@
 #endif
 
 #include <glm/gtx/transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/stat.h>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <direct.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// the frustum test uses SSE wherever the compiler targets it
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 1))
+#define SCENE_CULL_SSE
+#include <xmmintrin.h>
+#endif
 
 // declaration of global variables
 namespace
 {
 	const char* g_ModelName = "model";
+	const char* g_ViewName = "view";
+	const char* g_ProjectionName = "projection";
 	const char* g_ColorValueName = "objectColor";
 	const char* g_TextureValueName = "objectTexture";
 	const char* g_UseTextureName = "bUseTexture";
+	const char* g_TextureArrayName = "objectTextures";
 	const char* g_UseLightingName = "bUseLighting";
-}
-
-/***********************************************************
- *  SceneManager()
- *
- *  The constructor for the class
- ***********************************************************/
-SceneManager::SceneManager(ShaderManager *pShaderManager)
-{
-	m_pShaderManager = pShaderManager;
-	m_basicMeshes = new ShapeMeshes();
-}
-
-/***********************************************************
- *  ~SceneManager()
- *
- *  The destructor for the class
- ***********************************************************/
-SceneManager::~SceneManager()
-{
-	m_pShaderManager = NULL;
-	delete m_basicMeshes;
-	m_basicMeshes = NULL;
-}
+	const char* g_ViewPositionName = "viewPosition";
+	const char* g_SceneFileName = "scene.txt";
+	const char* g_UVScaleName = "UVscale";
+	const char* g_MaterialDiffuseName = "material.diffuseColor";
+	const char* g_MaterialSpecularName = "material.specularColor";
+	const char* g_MaterialShininessName = "material.shininess";
+
+	/***********************************************************
+	 *  UniformCache
+	 *
+	 *  Resolves the uniform locations of the current shader
+	 *  program once into integer handles, and keeps a shadow
+	 *  copy of the last value sent for each handle so that sets
+	 *  which would not change anything never reach the driver.
+	 *  The shadow copies also let another program be handed the
+	 *  same values without reading them back from GL.
+	 ***********************************************************/
+	class UniformCache
+	{
+	public:
+		UniformCache() : m_program(0), m_sent(0), m_skipped(0), m_frames(0) {}
 
-/***********************************************************
- *  CreateGLTexture()
- *
- *  This method is used for loading textures from image files,
- *  configuring the texture mapping parameters in OpenGL,
- *  generating the mipmaps, and loading the read texture into
- *  the next available texture slot in memory.
- ***********************************************************/
-bool SceneManager::CreateGLTexture(const char* filename, std::string tag)
-{
-	int width = 0;
-	int height = 0;
-	int colorChannels = 0;
-	GLuint textureID = 0;
+		// returns the handle for a uniform name, resolving it once
+		int Resolve(const char* name)
+		{
+			for (size_t i = 0; i < m_slots.size(); i++)
+			{
+				if (m_slots[i].name.compare(name) == 0)
+				{
+					return(static_cast<int>(i));
+				}
+			}
+			UNIFORM_SLOT slot;
+			slot.name = name;
+			slot.location = (m_program != 0) ? glGetUniformLocation(m_program, name) : -1;
+			slot.size = 0;
+			m_slots.push_back(slot);
+			return(static_cast<int>(m_slots.size()) - 1);
+		}
 
-	// indicate to always flip images vertically when loaded
-	stbi_set_flip_vertically_on_load(true);
+		// re-resolves every handle if a different program is in use;
+		// this is the only GL query made per frame
+		void BeginFrame()
+		{
+			AttachCurrent();
+			m_frames++;
+		}
 
-	// try to parse the image data from the specified image file
-	unsigned char* image = stbi_load(
-		filename,
-		&width,
-		&height,
-		&colorChannels,
-		0);
+		// points the handles at the uniforms of the program in use
+		void AttachCurrent()
+		{
+			GLint program = 0;
+			glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+			Attach(static_cast<GLuint>(program));
+		}
 
-	// if the image was successfully read from the image file
-	if (image)
-	{
-		std::cout << "Successfully loaded image:" << filename << ", width:" << width << ", height:" << height << ", channels:" << colorChannels << std::endl;
+		// points the handles at the uniforms of the passed in program
+		void Attach(GLuint program)
+		{
+			if (program != m_program)
+			{
+				m_program = program;
+				for (UNIFORM_SLOT& slot : m_slots)
+				{
+					slot.location = glGetUniformLocation(m_program, slot.name.c_str());
+					slot.size = 0;
+				}
+			}
+		}
 
-		glGenTextures(1, &textureID);
-		glBindTexture(GL_TEXTURE_2D, textureID);
+		GLuint Program() const
+		{
+			return(m_program);
+		}
 
-		// set the texture wrapping parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		// set texture filtering parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		GLint Location(int handle) const
+		{
+			return(m_slots[handle].location);
+		}
 
-		// if the loaded image is in RGB format
-		if (colorChannels == 3)
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-		// if the loaded image is in RGBA format - it supports transparency
-		else if (colorChannels == 4)
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
-		else
+		// forgets the shadow values, e.g. after another path set uniforms
+		void Invalidate()
 		{
-			std::cout << "Not implemented to handle image with " << colorChannels << " channels" << std::endl;
-			return false;
+			for (UNIFORM_SLOT& slot : m_slots)
+			{
+				slot.size = 0;
+			}
 		}
 
-		// generate the texture mipmaps for mapping textures to lower resolutions
-		glGenerateMipmap(GL_TEXTURE_2D);
+		void SetInt(int handle, int value)
+		{
+			if (Changed(handle, &value, sizeof(value)))
+				glUniform1i(m_slots[handle].location, value);
+		}
+		void SetFloat(int handle, float value)
+		{
+			if (Changed(handle, &value, sizeof(value)))
+				glUniform1f(m_slots[handle].location, value);
+		}
+		void SetVec2(int handle, const glm::vec2& value)
+		{
+			if (Changed(handle, glm::value_ptr(value), sizeof(value)))
+				glUniform2fv(m_slots[handle].location, 1, glm::value_ptr(value));
+		}
+		void SetVec3(int handle, const glm::vec3& value)
+		{
+			if (Changed(handle, glm::value_ptr(value), sizeof(value)))
+				glUniform3fv(m_slots[handle].location, 1, glm::value_ptr(value));
+		}
+		void SetVec4(int handle, const glm::vec4& value)
+		{
+			if (Changed(handle, glm::value_ptr(value), sizeof(value)))
+				glUniform4fv(m_slots[handle].location, 1, glm::value_ptr(value));
+		}
+		void SetMat4(int handle, const glm::mat4& value)
+		{
+			if (Changed(handle, glm::value_ptr(value), sizeof(value)))
+				glUniformMatrix4fv(m_slots[handle].location, 1, GL_FALSE, glm::value_ptr(value));
+		}
 
-		// free the image data from local memory
-		stbi_image_free(image);
-		glBindTexture(GL_TEXTURE_2D, 0); // Unbind the texture
+		// sets a uniform of the target cache to the last value this
+		// cache sent for a handle, if it has sent one of that type
+		void Forward(int handle, GLenum type, UniformCache& target, int targetHandle) const
+		{
+			const UNIFORM_SLOT& slot = m_slots[handle];
+			switch (type)
+			{
+			case GL_BOOL:
+			case GL_INT:
+				if (slot.size == sizeof(int))
+				{
+					int value;
+					memcpy(&value, slot.value, sizeof(value));
+					target.SetInt(targetHandle, value);
+				}
+				break;
+			case GL_FLOAT:
+				if (slot.size == sizeof(float))
+				{
+					float value;
+					memcpy(&value, slot.value, sizeof(value));
+					target.SetFloat(targetHandle, value);
+				}
+				break;
+			case GL_FLOAT_VEC2:
+				if (slot.size == sizeof(glm::vec2))
+				{
+					glm::vec2 value;
+					memcpy(&value, slot.value, sizeof(value));
+					target.SetVec2(targetHandle, value);
+				}
+				break;
+			case GL_FLOAT_VEC3:
+				if (slot.size == sizeof(glm::vec3))
+				{
+					glm::vec3 value;
+					memcpy(&value, slot.value, sizeof(value));
+					target.SetVec3(targetHandle, value);
+				}
+				break;
+			case GL_FLOAT_VEC4:
+				if (slot.size == sizeof(glm::vec4))
+				{
+					glm::vec4 value;
+					memcpy(&value, slot.value, sizeof(value));
+					target.SetVec4(targetHandle, value);
+				}
+				break;
+			case GL_FLOAT_MAT4:
+				if (slot.size == sizeof(glm::mat4))
+				{
+					glm::mat4 value;
+					memcpy(&value, slot.value, sizeof(value));
+					target.SetMat4(targetHandle, value);
+				}
+				break;
+			default:
+				break;
+			}
+		}
 
-		// register the loaded texture and associate it with the special tag string
-		m_textureIDs[m_loadedTextures].ID = textureID;
-		m_textureIDs[m_loadedTextures].tag = tag;
-		m_loadedTextures++;
-		m_textureIDs.push_back(textureID);
-		return true;
-	}
+		void Report(const char* label) const
+		{
+			unsigned long long total = m_sent + m_skipped;
+			std::cout << "[SceneManager] " << label << " uniform cache: " << m_sent << " set(s) sent, "
+				<< m_skipped << " redundant set(s) skipped";
+			if (total > 0)
+			{
+				std::cout << " (" << (100ull * m_skipped / total) << "%)";
+			}
+			if (m_frames > 0)
+			{
+				std::cout << ", " << (m_skipped / m_frames) << " skipped per frame";
+			}
+			std::cout << std::endl;
+		}
 
-	std::cout << "Could not load image:" << filename << std::endl;
+	private:
+		struct UNIFORM_SLOT
+		{
+			std::string name;
+			GLint location;
+			size_t size;                 // bytes in value, 0 when unknown
+			unsigned char value[sizeof(glm::mat4)];
+		};
 
-	// Error loading the image
-	return false;
-}
+		// compares against and updates the shadow copy
+		bool Changed(int handle, const void* value, size_t size)
+		{
+			UNIFORM_SLOT& slot = m_slots[handle];
+			if ((slot.size == size) && (memcmp(slot.value, value, size) == 0))
+			{
+				m_skipped++;
+				return(false);
+			}
+			slot.size = size;
+			memcpy(slot.value, value, size);
+			m_sent++;
+			return(true);
+		}
 
-/***********************************************************
- *  BindGLTextures()
- *
- *  This method is used for binding the loaded textures to
- *  OpenGL texture memory slots.  There are up to 16 slots.
- ***********************************************************/
-void SceneManager::BindGLTextures()
-{
-	for (int i = 0; i < m_loadedTextures; i++)
+		GLuint m_program;
+		std::vector<UNIFORM_SLOT> m_slots;
+		unsigned long long m_sent;
+		unsigned long long m_skipped;
+		unsigned long long m_frames;
+	};
+
+	// uniform handles used on every draw
+	UniformCache g_uniformCache;
+	int g_ModelUniform = g_uniformCache.Resolve(g_ModelName);
+	int g_ViewUniform = g_uniformCache.Resolve(g_ViewName);
+	int g_ProjectionUniform = g_uniformCache.Resolve(g_ProjectionName);
+	int g_ColorValueUniform = g_uniformCache.Resolve(g_ColorValueName);
+	int g_TextureValueUniform = g_uniformCache.Resolve(g_TextureValueName);
+	int g_UseTextureUniform = g_uniformCache.Resolve(g_UseTextureName);
+	int g_TextureArrayUniform = g_uniformCache.Resolve(g_TextureArrayName);
+	int g_UVScaleUniform = g_uniformCache.Resolve(g_UVScaleName);
+	int g_MaterialDiffuseUniform = g_uniformCache.Resolve(g_MaterialDiffuseName);
+	int g_MaterialSpecularUniform = g_uniformCache.Resolve(g_MaterialSpecularName);
+	int g_MaterialShininessUniform = g_uniformCache.Resolve(g_MaterialShininessName);
+	int g_UseLightingUniform = g_uniformCache.Resolve(g_UseLightingName);
+	int g_ViewPositionUniform = g_uniformCache.Resolve(g_ViewPositionName);
+
+	/***********************************************************
+	 *  RenderStateCache
+	 *
+	 *  Keeps a shadow copy of the fixed function state the scene
+	 *  changes while drawing - blending, the blend function and
+	 *  the depth and color write masks - so that calls which
+	 *  would not change anything never reach the driver. The
+	 *  state is unknown until first set, and stays known from
+	 *  frame to frame unless Invalidate() is called.
+	 ***********************************************************/
+	class RenderStateCache
 	{
-		// bind textures on corresponding texture units
-		glActiveTexture(GL_TEXTURE0 + i);
-		glBindTexture(GL_TEXTURE_2D, m_textureIDs[i].ID);
-	}
-}
+	public:
+		RenderStateCache() : m_sent(0), m_skipped(0), m_frames(0)
+		{
+			Invalidate();
+		}
 
-// old
+		void BeginFrame()
+		{
+			m_frames++;
+		}
 
-/***********************************************************
- *  DestroyGLTextures()
- *
- *  This method is used for freeing the memory in all the
- *  used texture memory slots.
- ***********************************************************/
-/* void SceneManager::DestroyGLTextures()
-{
-	for (int i = 0; i < m_loadedTextures; i++)
-	{
-		glGenTextures(1, &m_textureIDs[i].ID);
-	}
-}
+		// forgets the shadow state, e.g. after other code changed it
+		void Invalidate()
+		{
+			m_blend = -1;
+			m_depthMask = -1;
+			m_colorMask = -1;
+			m_bBlendFuncKnown = false;
+		}
 
-*/
+		void SetBlend(bool bEnable)
+		{
+			if (Changed(m_blend, bEnable))
+			{
+				if (bEnable)
+				{
+					glEnable(GL_BLEND);
+				}
+				else
+				{
+					glDisable(GL_BLEND);
+				}
+			}
+		}
 
-// new
+		void SetBlendFunc(GLenum source, GLenum destination)
+		{
+			if (m_bBlendFuncKnown && (source == m_blendSource) && (destination == m_blendDestination))
+			{
+				m_skipped++;
+				return;
+			}
+			m_bBlendFuncKnown = true;
+			m_blendSource = source;
+			m_blendDestination = destination;
+			m_sent++;
+			glBlendFunc(source, destination);
+		}
 
-void SceneManager::DeleteSceneTextures()
-{
-	if (!m_textureIDs.empty()) {
-		glDeleteTextures(static_cast<GLsizei>(m_textureIDs.size()), m_textureIDs.data());
-		std::cout << "[SceneManager] Deleted " << m_textureIDs.size() << " texture(s)." << std::endl;
-		m_textureIDs.clear();  // Clear the list after deletion
-	} else {
-		std::cout << "[SceneManager] No textures to delete." << std::endl;
-	}
-}
+		void SetDepthMask(bool bWrite)
+		{
+			if (Changed(m_depthMask, bWrite))
+			{
+				glDepthMask(bWrite ? GL_TRUE : GL_FALSE);
+			}
+		}
 
+		void SetColorMask(bool bWrite)
+		{
+			if (Changed(m_colorMask, bWrite))
+			{
+				GLboolean bMask = bWrite ? GL_TRUE : GL_FALSE;
+				glColorMask(bMask, bMask, bMask, bMask);
+			}
+		}
 
+		void Report() const
+		{
+			unsigned long long total = m_sent + m_skipped;
+			std::cout << "[SceneManager] Render state cache: " << m_sent << " call(s) sent, "
+				<< m_skipped << " redundant call(s) skipped";
+			if (total > 0)
+			{
+				std::cout << " (" << (100ull * m_skipped / total) << "%)";
+			}
+			if (m_frames > 0)
+			{
+				std::cout << ", " << (m_skipped / m_frames) << " skipped per frame";
+			}
+			std::cout << std::endl;
+		}
 
-/***********************************************************
- *  FindTextureID()
- *
- *  This method is used for getting an ID for the previously
- *  loaded texture bitmap associated with the passed in tag.
- ***********************************************************/
-int SceneManager::FindTextureID(std::string tag)
-{
-	int textureID = -1;
-	int index = 0;
-	bool bFound = false;
+	private:
+		// compares against and updates a shadow flag, -1 when unknown
+		bool Changed(int& shadow, bool value)
+		{
+			if (shadow == (value ? 1 : 0))
+			{
+				m_skipped++;
+				return(false);
+			}
+			shadow = value ? 1 : 0;
+			m_sent++;
+			return(true);
+		}
 
-	while ((index < m_loadedTextures) && (bFound == false))
+		int m_blend;
+		int m_depthMask;
+		int m_colorMask;
+		bool m_bBlendFuncKnown;
+		GLenum m_blendSource;
+		GLenum m_blendDestination;
+		unsigned long long m_sent;
+		unsigned long long m_skipped;
+		unsigned long long m_frames;
+	};
+
+	// the blend and write mask state of every pass
+	RenderStateCache g_renderStates;
+
+	// basic meshes that can be listed in the scene file
+	enum SCENE_MESH
 	{
-		if (m_textureIDs[index].tag.compare(tag) == 0)
+		MESH_PLANE,
+		MESH_BOX,
+		MESH_CYLINDER,
+		MESH_TORUS,
+		MESH_PRISM,
+		MESH_PYRAMID4
+	};
+	const int SCENE_MESH_COUNT = MESH_PYRAMID4 + 1;
+
+	// the parts of a mesh that can be drawn on their own
+	enum SCENE_PART
+	{
+		PART_FULL,
+		PART_BOX_TOP,
+		PART_BOX_BOTTOM,
+		PART_BOX_LEFT,
+		PART_BOX_RIGHT,
+		PART_BOX_FRONT,
+		PART_BOX_BACK,
+		PART_CYLINDER_TOP,
+		PART_CYLINDER_BOTTOM,
+		PART_CYLINDER_SIDES
+	};
+	const int SCENE_PART_COUNT = PART_CYLINDER_SIDES + 1;
+
+	// the most faces a mesh has parts for - the sides of a box
+	const int MESH_FACE_COUNT = 6;
+
+	/***********************************************************
+	 *  MeshFaceCount()
+	 *
+	 *  This function is used for getting how many faces a mesh
+	 *  has parts for; a mesh without parts is a single face.
+	 ***********************************************************/
+	int MeshFaceCount(SCENE_MESH mesh)
+	{
+		switch (mesh)
 		{
-			textureID = m_textureIDs[index].ID;
-			bFound = true;
+		case MESH_BOX: return(6);
+		case MESH_CYLINDER: return(3);
+		default: return(1);
 		}
-		else
-			index++;
 	}
 
-	return(textureID);
-}
-
-/***********************************************************
- *  FindTextureSlot()
- *
- *  This method is used for getting a slot index for the previously
- *  loaded texture bitmap associated with the passed in tag.
- ***********************************************************/
-int SceneManager::FindTextureSlot(std::string tag)
-{
-	int textureSlot = -1;
-	int index = 0;
-	bool bFound = false;
-
-	while ((index < m_loadedTextures) && (bFound == false))
+	/***********************************************************
+	 *  PartFace()
+	 *
+	 *  This function is used for getting which face of its mesh
+	 *  a part is, counting from 0.
+	 ***********************************************************/
+	int PartFace(SCENE_PART part)
 	{
-		if (m_textureIDs[index].tag.compare(tag) == 0)
+		if ((part >= PART_BOX_TOP) && (part <= PART_BOX_BACK))
 		{
-			textureSlot = index;
-			bFound = true;
+			return(part - PART_BOX_TOP);
 		}
-		else
-			index++;
+		if (part >= PART_CYLINDER_TOP)
+		{
+			return(part - PART_CYLINDER_TOP);
+		}
+		return(0);
 	}
 
-	return(textureSlot);
-}
-
-/***********************************************************
- *  FindMaterial()
- *
- *  This method is used for getting a material from the previously
- *  defined materials list that is associated with the passed in tag.
- ***********************************************************/
-bool SceneManager::FindMaterial(std::string tag, OBJECT_MATERIAL& material)
-{
-	if (m_objectMaterials.size() == 0)
+	// one line of the scene file - the shared transform, color
+	// and material for a contiguous range of draws
+	struct SCENE_OBJECT
 	{
-		return(false);
-	}
-
-	int index = 0;
-	bool bFound = false;
-	while ((index < m_objectMaterials.size()) && (bFound == false))
+		SCENE_MESH mesh;
+		glm::vec3 scaleXYZ;
+		glm::vec3 rotationDegrees;
+		glm::vec3 positionXYZ;
+		glm::vec4 color;
+		int materialHandle;         // -1 until a material is listed
+		int firstDraw;
+		int drawCount;
+		int layer;                  // how many earlier objects it coincides with
+		int instanceGroup;          // -1 when the geometry pool does not draw it
+		// dynamic objects spin about a local mesh axis every frame
+		bool bDynamic;
+		bool bDirty;
+		glm::vec3 spinAxis;
+		float spinDegreesPerSecond;
+		float spinDegrees;
+		std::string label;          // the comment heading it in the scene file
+		bool bCovered;              // drawn exactly over by an earlier object
+	};
+
+	// one draw call - a mesh part with the texture to draw it with
+	struct SCENE_DRAW
 	{
-		if (m_objectMaterials[index].tag.compare(tag) == 0)
+		int object;
+		SCENE_PART part;
+		int textureHandle;          // -1 draws with the object color
+	};
+
+	// material values by handle - the handle is the index
+	// the material was registered at in DefineObjectMaterials()
+	struct MATERIAL_VALUES
+	{
+		glm::vec3 diffuseColor;
+		glm::vec3 specularColor;
+		float shininess;
+	};
+	std::vector<MATERIAL_VALUES> g_materialTable;
+	std::vector<std::string> g_materialTags;
+
+	// texture tags by handle - the handle is the texture slot
+	// the texture was registered at in LoadSceneTextures()
+	std::vector<std::string> g_textureTags;
+
+	// one point light as the SceneLights uniform block lays it out
+	// (std140) - every member a vec4, so a light is 64 bytes
+	struct SCENE_LIGHT
+	{
+		glm::vec4 position;         // w is 1 when the light is on
+		glm::vec4 ambient;
+		glm::vec4 diffuse;          // w is the distance it reaches, 0 for everywhere
+		glm::vec4 specular;
+	};
+
+	// the lights the block holds - TOTAL_POINT_LIGHTS in the pool shader -
+	// and the first few the scene program's own shader declares
+	const int SCENE_LIGHT_CAPACITY = 128;
+	const int SCENE_PROGRAM_LIGHTS = 4;
+	const GLuint SCENE_LIGHT_BINDING = 1;
+
+	struct SCENE_LIGHT_BLOCK
+	{
+		SCENE_LIGHT lights[SCENE_LIGHT_CAPACITY];
+		GLint lightCount;
+		GLint padding[3];
+	};
+
+	/***********************************************************
+	 *  SceneLightBuffer
+	 *
+	 *  Keeps the scene lights in a CPU side copy of the std140
+	 *  SceneLights block, mirrored into a uniform buffer. Each
+	 *  change marks its light dirty, and the next Upload() sends
+	 *  each run of neighbouring dirty lights as one update, so
+	 *  two lights far apart do not resend those between. The
+	 *  light count is sent on its own when it grows. The scene
+	 *  program, which still reads its first lights as separate
+	 *  uniforms, is sent only those changed since it was last
+	 *  applied.
+	 ***********************************************************/
+	class SceneLightBuffer
+	{
+	public:
+		SceneLightBuffer() : m_buffer(0), m_bCountDirty(false), m_bDirty(false), m_uniformDirty(0),
+			m_uniformProgram(0), m_version(0), m_uploads(0), m_uploadedBytes(0)
 		{
-			bFound = true;
-			material.diffuseColor = m_objectMaterials[index].diffuseColor;
-			material.specularColor = m_objectMaterials[index].specularColor;
-			material.shininess = m_objectMaterials[index].shininess;
+			for (SCENE_LIGHT& light : m_block.lights)
+			{
+				light.position = light.ambient = light.diffuse = light.specular = glm::vec4(0.0f);
+			}
+			for (bool& bDirty : m_lightDirty)
+			{
+				bDirty = false;
+			}
+			m_block.lightCount = 0;
+			m_block.padding[0] = m_block.padding[1] = m_block.padding[2] = 0;
 		}
-		else
+
+		void SetLight(int index, const glm::vec3& position, const glm::vec3& ambient,
+			const glm::vec3& diffuse, const glm::vec3& specular, float range = 0.0f)
 		{
-			index++;
+			if (!Valid(index))
+			{
+				return;
+			}
+			SCENE_LIGHT& light = m_block.lights[index];
+			light.position = glm::vec4(position, 1.0f);
+			light.ambient = glm::vec4(ambient, 0.0f);
+			light.diffuse = glm::vec4(diffuse, range);
+			light.specular = glm::vec4(specular, 0.0f);
+			MarkDirty(index);
+
+			if (index >= m_block.lightCount)
+			{
+				m_block.lightCount = index + 1;
+				MarkDirty(-1);
+			}
 		}
-	}
 
-	return(true);
-}
+		const SCENE_LIGHT& Light(int index) const
+		{
+			return(m_block.lights[index]);
+		}
 
-/***********************************************************
- *  SetTransformations()
- *
- *  This method is used for setting the transform buffer
- *  using the passed in transformation values.
- ***********************************************************/
-void SceneManager::SetTransformations(
-	glm::vec3 scaleXYZ,
-	float XrotationDegrees,
-	float YrotationDegrees,
-	float ZrotationDegrees,
-	glm::vec3 positionXYZ,
-	glm::vec3 offset)
-{
-	// variables for this method
-	glm::mat4 modelView;
-	glm::mat4 scale;
-	glm::mat4 rotationX;
-	glm::mat4 rotationY;
-	glm::mat4 rotationZ;
-	glm::mat4 translation;
-
-	// set the scale value in the transform buffer
-	scale = glm::scale(scaleXYZ);
-	// set the rotation values in the transform buffer
-	rotationX = glm::rotate(glm::radians(XrotationDegrees), glm::vec3(1.0f, 0.0f, 0.0f));
-	rotationY = glm::rotate(glm::radians(YrotationDegrees), glm::vec3(0.0f, 1.0f, 0.0f));
-	rotationZ = glm::rotate(glm::radians(ZrotationDegrees), glm::vec3(0.0f, 0.0f, 1.0f));
-	// set the translation value in the transform buffer
-	translation = glm::translate(positionXYZ + offset);
-
-	modelView = translation * rotationZ * rotationY * rotationX * scale;
-
-	if (NULL != m_pShaderManager)
-	{
-		m_pShaderManager->setMat4Value(g_ModelName, modelView);
-	}
-}
-
-/***********************************************************
- *  SetShaderColor()
- *
- *  This method is used for setting the passed in color
- *  into the shader for the next draw command
- ***********************************************************/
-void SceneManager::SetShaderColor(
-	float redColorValue,
-	float greenColorValue,
-	float blueColorValue,
-	float alphaValue)
-{
-	// variables for this method
-	glm::vec4 currentColor;
-
-	currentColor.r = redColorValue;
-	currentColor.g = greenColorValue;
-	currentColor.b = blueColorValue;
-	currentColor.a = alphaValue;
-
-	if (NULL != m_pShaderManager)
-	{
-		m_pShaderManager->setIntValue(g_UseTextureName, false);
-		m_pShaderManager->setVec4Value(g_ColorValueName, currentColor);
-	}
-}
-
-/***********************************************************
- *  SetShaderTexture()
- *
- *  This method is used for setting the texture data
- *  associated with the passed in ID into the shader.
- ***********************************************************/
-void SceneManager::SetShaderTexture(
-	std::string textureTag)
-{
-	if (NULL != m_pShaderManager)
-	{
-		m_pShaderManager->setIntValue(g_UseTextureName, true);
-
-		int textureID = -1;
-		textureID = FindTextureSlot(textureTag);
-		m_pShaderManager->setSampler2DValue(g_TextureValueName, textureID);
-	}
-}
-
-/***********************************************************
- *  SetTextureUVScale()
- *
- *  This method is used for setting the texture UV scale
- *  values into the shader.
- ***********************************************************/
-void SceneManager::SetTextureUVScale(float u, float v)
-{
-	if (NULL != m_pShaderManager)
-	{
-		m_pShaderManager->setVec2Value("UVscale", glm::vec2(u, v));
-	}
-}
-
-/***********************************************************
- *  SetShaderMaterial()
- *
- *  This method is used for passing the material values
- *  into the shader.
- ***********************************************************/
-void SceneManager::SetShaderMaterial(
-	std::string materialTag)
-{
-	if (m_objectMaterials.size() > 0)
-	{
-		OBJECT_MATERIAL material;
-		bool bReturn = false;
-
-		bReturn = FindMaterial(materialTag, material);
-		if (bReturn == true)
-		{
-			m_pShaderManager->setVec3Value("material.diffuseColor", material.diffuseColor);
-			m_pShaderManager->setVec3Value("material.specularColor", material.specularColor);
-			m_pShaderManager->setFloatValue("material.shininess", material.shininess);
-		}
-	}
-}
-
-/**************************************************************/
-/*** STUDENTS CAN MODIFY the code in the methods BELOW for  ***/
-/*** preparing and rendering their own 3D replicated scenes.***/
-/*** Please refer to the code in the OpenGL sample project  ***/
-/*** for assistance.                                        ***/
-/**************************************************************/
-
-
-/***********************************************************
- *  PrepareScene()
- *
- *  This method is used for preparing the 3D scene by loading
- *  the shapes, textures in memory to support the 3D scene 
- *  rendering
- ***********************************************************/
-//-------------------------------------------------------------------------------------------------------textures
-
-void SceneManager::DefineObjectMaterials()
-{
-	OBJECT_MATERIAL goldMaterial;
-	goldMaterial.diffuseColor = glm::vec3(0.4f, 0.4f, 0.4f);
-	goldMaterial.specularColor = glm::vec3(0.7f, 0.7f, 0.6f);
-	goldMaterial.shininess = 52.0;
-	goldMaterial.tag = "metal";
-
-	m_objectMaterials.push_back(goldMaterial);
-
-	OBJECT_MATERIAL woodMaterial;
-	woodMaterial.diffuseColor = glm::vec3(0.2f, 0.2f, 0.3f);
-	woodMaterial.specularColor = glm::vec3(0.0f, 0.0f, 0.0f);
-	woodMaterial.shininess = 0.1;
-	woodMaterial.tag = "wood";
-
-	m_objectMaterials.push_back(woodMaterial);
-
-	OBJECT_MATERIAL glassMaterial;
-	glassMaterial.diffuseColor = glm::vec3(0.2f, 0.2f, 0.2f);
-	glassMaterial.specularColor = glm::vec3(1.0f, 1.0f, 1.0f);
-	glassMaterial.shininess = 95.0;
-	glassMaterial.tag = "glass";
-
-}
-
-
-void SceneManager::SetupSceneLights()
-{
-	// this line of code is NEEDED for telling the shaders to render 
-	// the 3D scene with custom lighting - to use the default rendered 
-	// lighting then comment out the following line
-	m_pShaderManager->setBoolValue(g_UseLightingName, true);
-
-
-	//----------------------------------------------------------------------------------side fan
-	m_pShaderManager->setVec3Value("pointLights[0].position", -3.0f, 8.5f, 2.0f);
-	m_pShaderManager->setVec3Value("pointLights[0].ambient", 0.05f, 0.05f, 0.05f);
-	m_pShaderManager->setVec3Value("pointLights[0].diffuse", 0.0f, 2.6f, 3.0f);
-	m_pShaderManager->setVec3Value("pointLights[0].specular", 0.0f, 2.6f, 3.0f);
-	m_pShaderManager->setBoolValue("pointLights[0].bActive", true);
-	//---------------------------------------------------------------------------------back right middle fan
-	m_pShaderManager->setVec3Value("pointLights[1].position", 0.5f, 0.2f, 1.5f);
-	m_pShaderManager->setVec3Value("pointLights[1].ambient", 0.05f, 0.05f, 0.05f);
-	m_pShaderManager->setVec3Value("pointLights[1].diffuse", 0.0f, 2.6f, 3.0f);
-	m_pShaderManager->setVec3Value("pointLights[1].specular", 0.0f, 0.9f, 1.0f);
-	m_pShaderManager->setBoolValue("pointLights[1].bActive", true);
-	//----------------------------------------------------------------------------------bottom middle fan
-	m_pShaderManager->setVec3Value("pointLights[2].position", 0.5f, 1.2f, 0.5f);
-	m_pShaderManager->setVec3Value("pointLights[2].ambient", 0.05f, 0.05f, 0.05f);
-	m_pShaderManager->setVec3Value("pointLights[2].diffuse", 0.0f, 2.6f, 3.0f);
-	m_pShaderManager->setVec3Value("pointLights[2].specular", 0.0f, 0.9f, 1.0f);
-	m_pShaderManager->setBoolValue("pointLights[2].bActive", true);
-    //-----------------------------------------------------------------------------------room
-	m_pShaderManager->setVec3Value("pointLights[3].position", 10.1f, 30.0f, 30.0f);
-	m_pShaderManager->setVec3Value("pointLights[3].ambient", 0.3f, 0.3f, 0.3f);
-	m_pShaderManager->setVec3Value("pointLights[3].diffuse", 0.2f, 0.2f, 0.2f);
-	m_pShaderManager->setVec3Value("pointLights[3].specular", 3.9f, 3.9f, 3.9f);
-	m_pShaderManager->setBoolValue("pointLights[3].bActive", true);
-
-	//m_pShaderManager->setVec3Value("pointLights[1].position", -7.0f, 8.5f, 2.0f);
-	//m_pShaderManager->setVec3Value("pointLights[1].ambient", 0.0f, 0.9f, 0.6f);
-	//m_pShaderManager->setVec3Value("pointLights[1].diffuse", 0.2f, 0.2f, 1.0f);
-	//m_pShaderManager->setVec3Value("pointLights[1].specular", 0.9f, 0.9f, 0.9f);
-	//m_pShaderManager->setBoolValue("pointLights[1].bActive", true);
-	//10.1f, 30.0f, 30.0f
-
-}
-
-void SceneManager::LoadSceneTextures()
-{
-	bool bReturn = false;
-
-	// [ERROR HANDLING ADDED] Log any texture that fails to load
-	auto tryLoadTexture = [&](const std::string& path, const std::string& tag) {
-		bReturn = CreateGLTexture(path.c_str(), tag.c_str());
-		if (!bReturn) {
-			std::cerr << "[SceneManager] ERROR: Failed to load texture: " << path << std::endl;
-		}
-		};
-
-	tryLoadTexture("textures/desk.jpg", "desk");
-	tryLoadTexture("textures/wall.jpg", "wall");
-	tryLoadTexture("textures/keyboard.jpg", "keyboard");
-	tryLoadTexture("textures/black.jpg", "black");
-	tryLoadTexture("textures/screen.jpg", "screen");
-	tryLoadTexture("textures/rightscreen.jpg", "rightscreen");
-	tryLoadTexture("textures/leftscreen.jpg", "leftscreen");
-	tryLoadTexture("textures/cpucooler.jpg", "cpucooler");
-	tryLoadTexture("textures/gpufront.jpg", "gpufront");
-	tryLoadTexture("textures/gpuside.jpg", "gpuside");
-	tryLoadTexture("textures/gputop.jpg", "gputop");
-	tryLoadTexture("textures/motherboard.jpg", "motherboard");
-	tryLoadTexture("textures/ram.jpg", "ram");
-
-	BindGLTextures();
-}
-
-
-
-
-
-
-
-void SceneManager::PrepareScene()
-{
-	// only one instance of a particular mesh needs to be
-	// loaded in memory no matter how many times it is drawn
-	// in the rendered 3D scene
-	LoadSceneTextures();
-	m_basicMeshes->LoadPlaneMesh();
-	m_basicMeshes->LoadBoxMesh();
-	m_basicMeshes->LoadTorusMesh();
-	m_basicMeshes->LoadPyramid4Mesh();
-	m_basicMeshes->LoadPrismMesh();
-	m_basicMeshes->LoadCylinderMesh();
-
-	SetupSceneLights();
-	DefineObjectMaterials();
-
-}
-
-/***********************************************************
- *  RenderScene()
- *
- *  This method is used for rendering the 3D scene by 
- *  transforming and drawing the basic 3D shapes
- ***********************************************************/
-void SceneManager::RenderScene()
-{
-	// declare the variables for the transformations
-	glm::vec3 scaleXYZ;
-	float XrotationDegrees = 0.0f;
-	float YrotationDegrees = 0.0f;
-	float ZrotationDegrees = 0.0f;
-	glm::vec3 positionXYZ;
-
-	/*** Set needed transformations before drawing the basic mesh.  ***/
-	/*** This same ordering of code should be used for transforming ***/
-	/*** and drawing all the basic 3D shapes.						***/
-	/******************************************************************/
-	// set the XYZ scale for the mesh
-	glm::mat4 scale;
-	glm::mat4 rotation;
-	glm::mat4 rotation2;
-	glm::mat4 translation;
-	glm::mat4 model;
-
-	//------------------------------------------------------------------------------------------------Desk
-
-	scaleXYZ = glm::vec3(30.0f, 1.0f, 10.0f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(0.0f, 0.0f, 0.0f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	SetShaderColor(0.8, 0.8, 0.8, 1);
-	SetShaderTexture("desk");
-	SetShaderMaterial("wood");
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawPlaneMesh();
-	/****************************************************************/
-
-	scaleXYZ = glm::vec3(20.0f, 1.0f, 10.0f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 90.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-20.0f, 0.0f, 30.0f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	SetShaderColor(0.8, 0.8, 0.8, 1);
-	SetShaderTexture("desk");
-	SetShaderMaterial("wood");
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawPlaneMesh();
-	/****************************************************************/
-
-	//------------------------------------------------------------------------------------------------Wall
-
-	scaleXYZ = glm::vec3(30.0f, 1.0f, 10.0f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 90.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(0.0f, 10.0f, -10.0f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	SetShaderColor(0.5, 0.5, 0.5, 1);
-	SetShaderTexture("wall");
-	SetShaderMaterial("wood");
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawPlaneMesh();
-
-	scaleXYZ = glm::vec3(30.0f, 1.0f, 10.0f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 90.0f;
-	YrotationDegrees = 90.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-30.0f, 10.0f, 20.0f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	SetShaderColor(0.5, 0.5, 0.5, 1);
-	SetShaderTexture("wall");
-	SetShaderMaterial("wood");
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawPlaneMesh();
-	//------------------------------------------------------------------------------------------------Keyboard
-
-	scaleXYZ = glm::vec3(8.0f, 2.0f, 20.0f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 180.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-18.0f, -0.1f, 30.0f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	SetShaderColor(0.3, 0.3, 0.3, 1);
-	SetShaderTexture("keyboard");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::top);
-	SetShaderTexture("black");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::bottom);
-	SetShaderTexture("black");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::left);
-	SetShaderTexture("black");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::right);
-	SetShaderTexture("black");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::front);
-	SetShaderTexture("black");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::back);
-	// draw the mesh with transformation values
-	SetShaderMaterial("metal");
-	m_basicMeshes->DrawBoxMesh();
-
-
-	//------------------------------------------------------------------------------------------------Mouse Pad
-
-	scaleXYZ = glm::vec3(5.0f, 1.0f, 5.0f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-17.0f, -0.1f, 16.0f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	SetShaderColor(0.1, 0.1, 0.12, 1);
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-
-	//------------------------------------------------------------------------------------------------Mouse 
-	scaleXYZ = glm::vec3(1.0f, 1.0f, 1.0f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 90.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-17.0f, 0.1f, 16.0f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	SetShaderColor(0.1, 0.1, 0.12, 1);
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh();
-
-
-	scaleXYZ = glm::vec3(2.0f, 2.5f, 1.5f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 180.0f;
-	YrotationDegrees = 90.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-18.0f, -0.2f, 16.0f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	SetShaderColor(0.1, 0.1, 0.12, 1);
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawPrismMesh();
-
-	//------------------------------------------------------------------------------------------------Monitor 1
-
-	scaleXYZ = glm::vec3(5.0f, 1.0f, 10.0f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-27.0f, -0.1f, 30.0f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	SetShaderColor(0.1, 0.1, 0.12, 1);
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-
-	scaleXYZ = glm::vec3(1.0f, 7.0f, 1.0f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-27.0f, -0.1f, 30.0f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	SetShaderColor(0.1, 0.1, 0.12, 1);
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh();
-
-
-	scaleXYZ = glm::vec3(20.0f, 1.0f, 10.0f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 90.0f;
-	YrotationDegrees = 90.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-26.0f, 10.f, 30.0f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	SetShaderColor(0.2, 0.2, 0.2, 1);
-	SetShaderTexture("screen");	
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::top);
-	SetShaderTexture("black");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::bottom);
-	SetShaderTexture("black");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::left);
-	SetShaderTexture("black");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::right);
-	SetShaderTexture("black");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::front);
-	SetShaderTexture("black");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::back);
-	SetShaderMaterial("glass");
-	
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-
-
-	//------------------------------------------------------------------------------------------------Monitor 2
-
-	scaleXYZ = glm::vec3(4.0f, 1.0f, 4.0f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = -45.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-22.5f, -0.1f, 16.0f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	SetShaderColor(0.1, 0.1, 0.12, 1);
-	SetShaderMaterial("metal");
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-
-
-
-
-	scaleXYZ = glm::vec3(.5f, 7.0f, .5f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-22.5f, -0.1f, 16.0f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	SetShaderColor(0.1, 0.1, 0.12, 1);
-	SetShaderMaterial("metal");
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh();
-
-
-	scaleXYZ = glm::vec3(10.0f, 1.0f, 18.0f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 90.0f;
-	YrotationDegrees = 45.0f;
-	ZrotationDegrees = 0.0f;
-	
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-22.5f, 10.0f, 16.0f);
-
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	
-	SetShaderTexture("rightscreen");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::top);
-	SetShaderTexture("black");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::bottom);
-	SetShaderTexture("black");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::left);
-	SetShaderTexture("black");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::right);
-	SetShaderTexture("black");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::front);
-	SetShaderTexture("black");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::back);
-	SetShaderMaterial("glass");
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-
-
-
-	//------------------------------------------------------------------------------------------------Monitor 3
-
-	scaleXYZ = glm::vec3(4.0f, 1.0f, 4.0f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = -45.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-22.5f, -0.1f, 43.9f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	SetShaderColor(0.1, 0.1, 0.12, 1);
-	SetShaderMaterial("metal");
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-
-
-
-	scaleXYZ = glm::vec3(.5f, 7.0f, .5f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-22.5f, -0.1f, 43.9f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	SetShaderColor(0.1, 0.1, 0.12, 1);
-	SetShaderMaterial("metal");
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh();
-
-
-	scaleXYZ = glm::vec3(10.0f, 1.0f, 18.0f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 90.0f;
-	YrotationDegrees = 135.0f;
-	ZrotationDegrees = 0.0f;
-
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-22.5f, 10.0f, 43.9f);
-
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-
-	SetShaderTexture("leftscreen");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::top);
-	SetShaderTexture("black");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::bottom);
-	SetShaderTexture("black");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::left);
-	SetShaderTexture("black");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::right);
-	SetShaderTexture("black");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::front);
-	SetShaderTexture("black");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::back);
-	SetShaderMaterial("glass");
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-	//------------------------------------------------------------------------------------------------Left Side Panel 
-
-
-
-
-
-	scaleXYZ = glm::vec3(10.0f, 1.0f, 12.0f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 90.0f;
-	YrotationDegrees = 90.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-8.0f, 6.5f, 0.0f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	SetShaderColor(0.2, 0.2, 0.2, 1);
-	SetShaderMaterial("metal");
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-
-	//SetShaderColor(1, 1, 1, 1);
-
-	//m_basicMeshes->DrawBoxMeshLines();
-
-
-
-
-	//------------------------------------------------------------------------------------------------Back Panel
-
-
-
-	scaleXYZ = glm::vec3(19.0f, 1.0f, 11.99f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 90.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(1.0f, 6.5f, -5.0f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	SetShaderColor(0.2, 0.2, 0.2, 1);
-	SetShaderMaterial("metal");
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-
-	//SetShaderColor(1, 1, 1, 1);
-
-	//m_basicMeshes->DrawBoxMeshLines();
-
-
-
-	//------------------------------------------------------------------------------------------------Bottom Panel
-
-	scaleXYZ = glm::vec3(18.0f, 1.0f, 10.0f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(1.5f, 1.0f, 0.0f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	SetShaderColor(0.1, 0.1, 0.12, 1);
-	SetShaderMaterial("metal");
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-
-
-	//SetShaderColor(1, 1, 1, 1);
-
-	//m_basicMeshes->DrawBoxMeshLines();
-
-
-	//------------------------------------------------------------------------------------------------Top Panel
-
-
-
-
-	scaleXYZ = glm::vec3(18.0f, 1.0f, 10.0f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(1.5f, 12.0f, 0.0f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	SetShaderColor(0.1, 0.1, 0.12, 1);
-	SetShaderMaterial("metal");
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-
-
-	//SetShaderColor(1, 1, 1, 1);
-
-	//m_basicMeshes->DrawBoxMeshLines();
-
-
-	//------------------------------------------------------------------------------------------------Front Left foot
-
-
-
-	scaleXYZ = glm::vec3(1.0f, 0.5f, 1.0f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-8.0f, 0.25f, 4.5f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	SetShaderColor(0.2, 0.2, 0.2, 1);
-	SetShaderMaterial("metal");
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-
-
-	//SetShaderColor(1, 1, 1, 1);
-
-	//m_basicMeshes->DrawBoxMeshLines();
-
-
-
-	//------------------------------------------------------------------------------------------------Front Right foot
-
-
-
-	scaleXYZ = glm::vec3(1.0f, 0.5f, 1.0f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(10.0f, 0.25f, 4.5f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	SetShaderColor(0.2, 0.2, 0.2, 1);
-	SetShaderMaterial("metal");
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-
-
-	//SetShaderColor(1, 1, 1, 1);
-
-	//m_basicMeshes->DrawBoxMeshLines();
-
-
-
-	//------------------------------------------------------------------------------------------------Back Right foot
-
-
-
-
-	scaleXYZ = glm::vec3(1.0f, 0.5f, 1.0f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(10.0f, 0.25f, -5.0f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	SetShaderColor(0.2, 0.2, 0.2, 1);
-	SetShaderMaterial("metal");
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-
-
-	//SetShaderColor(1, 1, 1, 1);
-
-	//m_basicMeshes->DrawBoxMeshLines();
-
-
-	//------------------------------------------------------------------------------------------------Back Left foot
-
-
-	scaleXYZ = glm::vec3(1.0f, 0.5f, 1.0f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-8.0f, 0.25f, -5.0f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	SetShaderColor(0.2, 0.2, 0.2, 1);
-	SetShaderMaterial("metal");
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-
-
-	//SetShaderColor(1, 1, 1, 1);
-
-	//m_basicMeshes->DrawBoxMeshLines();
-
-
-
-	//------------------------------------------------------------------------------------------------Motherboard Panel
-
-	scaleXYZ = glm::vec3(13.0f, 3.5f, 11.0f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 90.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-1.0f, 6.5f, -3.7f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	SetShaderColor(0.4f, 0.4f, 0.4f, 1.0f);
-	SetShaderMaterial("metal");
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-
-	//SetShaderColor(1, 1, 1, 1);
-
-	//m_basicMeshes->DrawBoxMeshLines();
-
-
-	//------------------------------------------------------------------------------------------------Motherboard
-
-	scaleXYZ = glm::vec3(10.0f, 1.0f, 11.0f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 90.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-2.5f, 6.5f, -2.0f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+		int Count() const
+		{
+			return(m_block.lightCount);
+		}
 
-	SetShaderColor(0.6f, 0.6f, 0.6f, 1.0f);
-	SetShaderTexture("motherboard");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::top);
-	SetShaderTexture("black");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::bottom);
-	SetShaderTexture("black");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::left);
-	SetShaderTexture("black");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::right);
-	SetShaderTexture("black");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::front);
-	SetShaderTexture("black");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::back);
-	// draw the mesh with transformation values
-	SetShaderMaterial("metal");
-	m_basicMeshes->DrawBoxMesh();
-	
-	//SetShaderColor(1, 1, 1, 1);
+		// changes every time a light does
+		unsigned int Version() const
+		{
+			return(m_version);
+		}
 
-	//m_basicMeshes->DrawBoxMeshLines();
+		// sends the dirty lights, creating the buffer and binding it
+		// to the block's binding point the first time
+		void Upload()
+		{
+			if (m_buffer == 0)
+			{
+				glGenBuffers(1, &m_buffer);
+				glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+				glBufferData(GL_UNIFORM_BUFFER, sizeof(m_block), &m_block, GL_DYNAMIC_DRAW);
+				glBindBuffer(GL_UNIFORM_BUFFER, 0);
+				glBindBufferBase(GL_UNIFORM_BUFFER, SCENE_LIGHT_BINDING, m_buffer);
+				ClearDirty();
+				m_uploads++;
+				m_uploadedBytes += sizeof(m_block);
+				return;
+			}
+			if (!m_bDirty)
+			{
+				return;
+			}
+			glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+			int light = 0;
+			while (light < SCENE_LIGHT_CAPACITY)
+			{
+				if (!m_lightDirty[light])
+				{
+					light++;
+					continue;
+				}
+				int first = light;
+				while ((light < SCENE_LIGHT_CAPACITY) && m_lightDirty[light])
+				{
+					light++;
+				}
+				Send(&m_block.lights[first], (light - first) * sizeof(SCENE_LIGHT));
+			}
+			if (m_bCountDirty)
+			{
+				Send(&m_block.lightCount, sizeof(m_block.lightCount));
+			}
+			glBindBuffer(GL_UNIFORM_BUFFER, 0);
+			ClearDirty();
+		}
 
+		// sets the changed lights' uniforms in the program the cache
+		// is attached to - all of them after a program change
+		void Apply(UniformCache& cache)
+		{
+			if (cache.Program() != m_uniformProgram)
+			{
+				m_uniformProgram = cache.Program();
+				m_uniformDirty = ~0u;
+			}
+			int lights = std::min(m_block.lightCount, SCENE_PROGRAM_LIGHTS);
+			for (int i = 0; (i < lights) && (m_uniformDirty != 0); i++)
+			{
+				if ((m_uniformDirty & (1u << i)) == 0)
+				{
+					continue;
+				}
+				if (static_cast<int>(m_handles.size()) <= i)
+				{
+					ResolveHandles(cache, i);
+				}
+				const SCENE_LIGHT& light = m_block.lights[i];
+				const LIGHT_HANDLES& handles = m_handles[i];
+				cache.SetVec3(handles.position, glm::vec3(light.position));
+				cache.SetVec3(handles.ambient, glm::vec3(light.ambient));
+				cache.SetVec3(handles.diffuse, glm::vec3(light.diffuse));
+				cache.SetVec3(handles.specular, glm::vec3(light.specular));
+				cache.SetInt(handles.active, light.position.w != 0.0f);
+				m_uniformDirty &= ~(1u << i);
+			}
+		}
 
+		void Destroy()
+		{
+			glDeleteBuffers(1, &m_buffer);
+			m_buffer = 0;
+			m_uniformProgram = 0;
+		}
 
-	//------------------------------------------------------------------------------------------------Motherboard Side
+		void Report() const
+		{
+			std::cout << "[SceneManager] Scene lights: " << m_block.lightCount << " light(s), "
+				<< m_uploads << " upload(s) of " << m_uploadedBytes << " byte(s)" << std::endl;
+		}
 
-	scaleXYZ = glm::vec3(3.0f, 1.5f, 5.0f);
+	private:
+		struct LIGHT_HANDLES
+		{
+			int position;
+			int ambient;
+			int diffuse;
+			int specular;
+			int active;
+		};
 
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 90.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+		bool Valid(int index) const
+		{
+			if ((index < 0) || (index >= SCENE_LIGHT_CAPACITY))
+			{
+				std::cerr << "[SceneManager] ERROR: Light " << index << " is outside the "
+					<< SCENE_LIGHT_CAPACITY << " the scene holds" << std::endl;
+				return(false);
+			}
+			return(true);
+		}
 
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(4.0f, 9.0f, -1.2f);
+		// marks a light to be sent with the next Upload(); an index
+		// of -1 marks the light count, and one past the scene
+		// program's lights changes no uniforms
+		void MarkDirty(int index)
+		{
+			if (index < 0)
+			{
+				m_bCountDirty = true;
+			}
+			else
+			{
+				m_lightDirty[index] = true;
+			}
+			if ((index >= 0) && (index < SCENE_PROGRAM_LIGHTS))
+			{
+				m_uniformDirty |= (1u << index);
+			}
+			m_bDirty = true;
+			m_version++;
+		}
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+		void ClearDirty()
+		{
+			for (bool& bDirty : m_lightDirty)
+			{
+				bDirty = false;
+			}
+			m_bCountDirty = false;
+			m_bDirty = false;
+		}
 
-	SetShaderColor(0.2f, 0.2f, 0.2f, 1.0f);
-	SetShaderMaterial("metal");
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
+		// one update of a member of the bound buffer
+		void Send(const void* member, size_t size)
+		{
+			size_t offset = reinterpret_cast<const unsigned char*>(member) - reinterpret_cast<const unsigned char*>(&m_block);
+			glBufferSubData(GL_UNIFORM_BUFFER, offset, size, member);
+			m_uploads++;
+			m_uploadedBytes += size;
+		}
 
-	//SetShaderColor(1, 1, 1, 1);
+		void ResolveHandles(UniformCache& cache, int last)
+		{
+			for (int i = static_cast<int>(m_handles.size()); i <= last; i++)
+			{
+				std::string prefix = "pointLights[" + std::to_string(i) + "].";
+				LIGHT_HANDLES handles;
+				handles.position = cache.Resolve((prefix + "position").c_str());
+				handles.ambient = cache.Resolve((prefix + "ambient").c_str());
+				handles.diffuse = cache.Resolve((prefix + "diffuse").c_str());
+				handles.specular = cache.Resolve((prefix + "specular").c_str());
+				handles.active = cache.Resolve((prefix + "bActive").c_str());
+				m_handles.push_back(handles);
+			}
+		}
 
-	//m_basicMeshes->DrawBoxMeshLines();
+		SCENE_LIGHT_BLOCK m_block;
+		GLuint m_buffer;
+		bool m_lightDirty[SCENE_LIGHT_CAPACITY];   // lights changed since the last Upload()
+		bool m_bCountDirty;
+		bool m_bDirty;                  // whether any of the above is set
+		uint32_t m_uniformDirty;        // a bit per scene program light not yet applied
+		GLuint m_uniformProgram;
+		unsigned int m_version;
+		std::vector<LIGHT_HANDLES> m_handles;
+		unsigned long long m_uploads;
+		unsigned long long m_uploadedBytes;
+	};
+	SceneLightBuffer g_sceneLights;
+
+	/***********************************************************
+	 *  FindHandle()
+	 *
+	 *  This function is used for resolving a tag into the handle
+	 *  it was registered with. Only called while loading, never
+	 *  per draw. Returns -1 for an unknown tag.
+	 ***********************************************************/
+	int FindHandle(const std::vector<std::string>& tags, const std::string& tag)
+	{
+		for (size_t i = 0; i < tags.size(); i++)
+		{
+			if (tags[i].compare(tag) == 0)
+			{
+				return(static_cast<int>(i));
+			}
+		}
+		return(-1);
+	}
 
-	//------------------------------------------------------------------
+	/***********************************************************
+	 *  SetShaderColorValue()
+	 *
+	 *  This function is used for the fast path of drawing with
+	 *  a flat color instead of a texture.
+	 ***********************************************************/
+	void SetShaderColorValue(const glm::vec4& color)
+	{
+		g_uniformCache.SetInt(g_UseTextureUniform, false);
+		g_uniformCache.SetVec4(g_ColorValueUniform, color);
+	}
 
+	/***********************************************************
+	 *  SetShaderTextureHandle()
+	 *
+	 *  This function is used for the fast path of selecting a
+	 *  registered texture - no string is built or searched.
+	 ***********************************************************/
+	void SetShaderTextureHandle(int textureHandle)
+	{
+		g_uniformCache.SetInt(g_UseTextureUniform, true);
+		g_uniformCache.SetInt(g_TextureValueUniform, textureHandle);
+	}
 
+	/***********************************************************
+	 *  SetShaderMaterialHandle()
+	 *
+	 *  This function is used for the fast path of passing a
+	 *  registered material into the shader by its handle.
+	 ***********************************************************/
+	void SetShaderMaterialHandle(int materialHandle)
+	{
+		if ((materialHandle < 0) || (materialHandle >= static_cast<int>(g_materialTable.size())))
+		{
+			return;
+		}
+		const MATERIAL_VALUES& material = g_materialTable[materialHandle];
+		g_uniformCache.SetVec3(g_MaterialDiffuseUniform, material.diffuseColor);
+		g_uniformCache.SetVec3(g_MaterialSpecularUniform, material.specularColor);
+		g_uniformCache.SetFloat(g_MaterialShininessUniform, material.shininess);
+	}
 
-	scaleXYZ = glm::vec3(3.2f, 2.99f, 3.0f);
+	// every scene texture resampled into one layer of a texture
+	// array, so the geometry pool can pick the texture per instance
+	// instead of per draw; the layer is the texture's handle and
+	// the array sits on the unit after the 16 single texture slots
+	const int g_TextureArraySize = 1024;
+	const int g_TextureArrayUnit = 16;
+	GLuint g_textureArray = 0;
+	int g_textureArrayLayers = 0;
+	int g_textureArrayLevels = 0;
+
+	// decoded textures are kept on disk with their whole mip chain,
+	// so a warm start maps the cache file and uploads straight from it
+	const char* g_TextureCacheFolder = "texture_cache";
+	const char g_TextureCacheMagic[4] = { 'S', 'T', 'X', 'C' };
+	const uint32_t g_TextureCacheVersion = 1;
+	const int g_MaxTextureLevels = 32;
+
+	// one mip level inside the pixel data of a texture
+	struct TEXTURE_LEVEL
+	{
+		uint64_t offset;
+		int32_t width;
+		int32_t height;
+	};
+
+	// the header of a texture cache file - the pixel data of every
+	// level follows it. The source file's time, size and content
+	// hash must all match for the cached pixels to be used.
+	struct TEXTURE_CACHE_HEADER
+	{
+		char magic[4];
+		uint32_t version;
+		int64_t sourceTime;
+		uint64_t sourceSize;
+		uint64_t sourceHash;
+		int32_t channels;
+		int32_t levelCount;         // levels of the texture itself
+		int32_t layerLevelCount;    // levels of its texture array layer, 0 for none
+		int32_t layerSize;
+		uint64_t dataBytes;
+		TEXTURE_LEVEL levels[g_MaxTextureLevels];   // texture levels, then layer levels
+	};
+
+	/***********************************************************
+	 *  MappedFile
+	 *
+	 *  A read only memory mapping of a whole file, unmapped when
+	 *  the object goes away.
+	 ***********************************************************/
+	class MappedFile
+	{
+	public:
+		MappedFile() : m_data(nullptr), m_size(0)
+#ifdef _WIN32
+			, m_file(INVALID_HANDLE_VALUE), m_mapping(NULL)
+#endif
+		{}
+		~MappedFile()
+		{
+			Close();
+		}
 
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 90.0f;
-	ZrotationDegrees = -90.0f;
+		bool Open(const std::string& path)
+		{
+			Close();
+#ifdef _WIN32
+			m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+			LARGE_INTEGER size;
+			if ((m_file == INVALID_HANDLE_VALUE) || !GetFileSizeEx(m_file, &size) || (size.QuadPart == 0))
+			{
+				Close();
+				return(false);
+			}
+			m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+			m_data = m_mapping ? static_cast<const unsigned char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+			m_size = static_cast<size_t>(size.QuadPart);
+#else
+			int file = open(path.c_str(), O_RDONLY);
+			struct stat info;
+			if ((file < 0) || (fstat(file, &info) != 0) || (info.st_size == 0))
+			{
+				if (file >= 0)
+				{
+					close(file);
+				}
+				return(false);
+			}
+			void* data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+			close(file);
+			m_data = (data != MAP_FAILED) ? static_cast<const unsigned char*>(data) : nullptr;
+			m_size = static_cast<size_t>(info.st_size);
+#endif
+			if (!m_data)
+			{
+				Close();
+				return(false);
+			}
+			return(true);
+		}
 
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(4.0f, 5.0f, -2.0f);
+		void Close()
+		{
+#ifdef _WIN32
+			if (m_data)
+			{
+				UnmapViewOfFile(m_data);
+			}
+			if (m_mapping)
+			{
+				CloseHandle(m_mapping);
+			}
+			if (m_file != INVALID_HANDLE_VALUE)
+			{
+				CloseHandle(m_file);
+			}
+			m_mapping = NULL;
+			m_file = INVALID_HANDLE_VALUE;
+#else
+			if (m_data)
+			{
+				munmap(const_cast<unsigned char*>(m_data), m_size);
+			}
+#endif
+			m_data = nullptr;
+			m_size = 0;
+		}
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+		const unsigned char* Data() const
+		{
+			return(m_data);
+		}
+		size_t Size() const
+		{
+			return(m_size);
+		}
 
-	SetShaderColor(0.2f, 0.2f, 0.2f, 1.0f);
-	SetShaderMaterial("metal");
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawPrismMesh(); 
+	private:
+		MappedFile(const MappedFile&);
+		MappedFile& operator=(const MappedFile&);
 
-	//SetShaderColor(1, 1, 1, 1);
+		const unsigned char* m_data;
+		size_t m_size;
+#ifdef _WIN32
+		HANDLE m_file;
+		HANDLE m_mapping;
+#endif
+	};
 
-	//m_basicMeshes->DrawBoxMeshLines();
+	// a scene texture on its way from the disk to the GPU - a decode
+	// worker fills in the pixels, the GL thread uploads them
+	struct TEXTURE_LOAD
+	{
+		std::string path;
+		GLuint textureID;
+		int handle;                 // texture slot, and layer in the texture array
+		bool bReady;                // false if the pixels could not be produced
+		bool bFromCache;
+		std::string error;
+		TEXTURE_CACHE_HEADER header;
+		const unsigned char* data;  // level pixels, in 'pixels' or the mapped cache file
+		std::vector<unsigned char> pixels;
+		std::unique_ptr<MappedFile> mapping;
+	};
+
+	// the textures are decoded on worker threads while the scene
+	// already renders; draws use their object color until the
+	// texture they name is resident
+	const int g_TextureUploadsPerFrame = 2;
+	std::vector<TEXTURE_LOAD> g_textureLoads;
+	std::vector<std::thread> g_decodeWorkers;
+	std::atomic<size_t> g_nextDecode(0);
+	std::atomic<bool> g_bStopDecoding(false);
+	std::mutex g_decodedMutex;
+	std::vector<int> g_decodedLoads;        // guarded by g_decodedMutex
+	size_t g_uploadedLoads = 0;
+	size_t g_cachedLoads = 0;
+	int g_textureLoadFrames = 0;
+	std::chrono::steady_clock::time_point g_textureLoadStart;
+	std::vector<char> g_textureResident;    // by texture handle
+
+	// pixel buffer objects the uploads alternate between
+	GLuint g_uploadBuffers[2] = { 0, 0 };
+	int g_nextUploadBuffer = 0;
+
+	/***********************************************************
+	 *  TextureResident()
+	 *
+	 *  This function is used for checking if a texture handle
+	 *  can be sampled yet.
+	 ***********************************************************/
+	bool TextureResident(int textureHandle)
+	{
+		return((textureHandle >= 0) && (textureHandle < static_cast<int>(g_textureResident.size())) &&
+			(g_textureResident[textureHandle] != 0));
+	}
 
-	//-------------------------------------------------------------------------------------------------Back Right Fans
+	/***********************************************************
+	 *  ResampleTextureLayer()
+	 *
+	 *  This function is used for converting a decoded image into
+	 *  a layer of the texture array. The image is bilinearly
+	 *  resampled to the layer size and expanded to RGBA, since
+	 *  every layer of the array shares one size and format.
+	 ***********************************************************/
+	void ResampleTextureLayer(const unsigned char* image, int width, int height, int channels, unsigned char* out)
+	{
+		for (int y = 0; y < g_TextureArraySize; y++)
+		{
+			// sample at texel centers so the edges do not drift
+			float sy = std::max(0.0f, (y + 0.5f) * height / g_TextureArraySize - 0.5f);
+			int y0 = std::min(static_cast<int>(sy), height - 1);
+			int y1 = std::min(y0 + 1, height - 1);
+			float fy = sy - y0;
+			for (int x = 0; x < g_TextureArraySize; x++)
+			{
+				float sx = std::max(0.0f, (x + 0.5f) * width / g_TextureArraySize - 0.5f);
+				int x0 = std::min(static_cast<int>(sx), width - 1);
+				int x1 = std::min(x0 + 1, width - 1);
+				float fx = sx - x0;
+				const unsigned char* p00 = image + (static_cast<size_t>(y0) * width + x0) * channels;
+				const unsigned char* p10 = image + (static_cast<size_t>(y0) * width + x1) * channels;
+				const unsigned char* p01 = image + (static_cast<size_t>(y1) * width + x0) * channels;
+				const unsigned char* p11 = image + (static_cast<size_t>(y1) * width + x1) * channels;
+				for (int c = 0; c < 4; c++)
+				{
+					if (c >= channels)
+					{
+						out[c] = 255;
+						continue;
+					}
+					float top = p00[c] + (p10[c] - p00[c]) * fx;
+					float bottom = p01[c] + (p11[c] - p01[c]) * fx;
+					out[c] = static_cast<unsigned char>(top + (bottom - top) * fy + 0.5f);
+				}
+				out += 4;
+			}
+		}
+	}
 
+	/***********************************************************
+	 *  AppendTextureLevel()
+	 *
+	 *  This function is used for reserving the pixels of a new
+	 *  level at the end of a texture's pixel data. Levels start
+	 *  on 4 byte boundaries.
+	 ***********************************************************/
+	TEXTURE_LEVEL AppendTextureLevel(std::vector<unsigned char>& pixels, int width, int height, int channels)
+	{
+		TEXTURE_LEVEL level;
+		level.offset = (pixels.size() + 3) & ~static_cast<uint64_t>(3);
+		level.width = width;
+		level.height = height;
+		pixels.resize(static_cast<size_t>(level.offset) + static_cast<size_t>(width) * height * channels);
+		return(level);
+	}
 
-	scaleXYZ = glm::vec3(4.0f, 1.0f, 11.0f);
+	/***********************************************************
+	 *  AppendMipChain()
+	 *
+	 *  This function is used for box filtering the level at
+	 *  levels[0] down to 1x1, appending each smaller level.
+	 *  Returns the number of levels, counting the first.
+	 ***********************************************************/
+	int AppendMipChain(std::vector<unsigned char>& pixels, TEXTURE_LEVEL* levels, int maxLevels, int channels)
+	{
+		int count = 1;
+		while ((count < maxLevels) && ((levels[count - 1].width > 1) || (levels[count - 1].height > 1)))
+		{
+			const TEXTURE_LEVEL source = levels[count - 1];
+			levels[count] = AppendTextureLevel(pixels, std::max(1, source.width / 2), std::max(1, source.height / 2), channels);
+			const unsigned char* in = &pixels[static_cast<size_t>(source.offset)];
+			unsigned char* out = &pixels[static_cast<size_t>(levels[count].offset)];
+			for (int y = 0; y < levels[count].height; y++)
+			{
+				int y0 = std::min(y * 2, source.height - 1);
+				int y1 = std::min(y * 2 + 1, source.height - 1);
+				for (int x = 0; x < levels[count].width; x++)
+				{
+					int x0 = std::min(x * 2, source.width - 1);
+					int x1 = std::min(x * 2 + 1, source.width - 1);
+					for (int c = 0; c < channels; c++)
+					{
+						int sum = in[(static_cast<size_t>(y0) * source.width + x0) * channels + c] +
+							in[(static_cast<size_t>(y0) * source.width + x1) * channels + c] +
+							in[(static_cast<size_t>(y1) * source.width + x0) * channels + c] +
+							in[(static_cast<size_t>(y1) * source.width + x1) * channels + c];
+						*out++ = static_cast<unsigned char>((sum + 2) / 4);
+					}
+				}
+			}
+			count++;
+		}
+		return(count);
+	}
 
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 90.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+	/***********************************************************
+	 *  TextureCachePath()
+	 *
+	 *  This function is used for naming the cache file of a
+	 *  texture after its source path.
+	 ***********************************************************/
+	std::string TextureCachePath(const std::string& folder, const std::string& sourcePath)
+	{
+		std::string name = sourcePath;
+		for (char& c : name)
+		{
+			if ((c == '/') || (c == '\\') || (c == ':') || (c == '.'))
+			{
+				c = '_';
+			}
+		}
+		return(folder + "/" + name + ".texcache");
+	}
 
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(8.0f, 6.5f, -4.0f);
+	/***********************************************************
+	 *  ReadTextureSource()
+	 *
+	 *  This function is used for reading a texture file and the
+	 *  key its cache file is checked against - the modification
+	 *  time, the size and an FNV-1a hash of the contents.
+	 ***********************************************************/
+	bool ReadTextureSource(const std::string& path, std::vector<unsigned char>& bytes, TEXTURE_CACHE_HEADER& key)
+	{
+		struct stat info;
+		std::ifstream file(path, std::ios::binary);
+		if (!file || (stat(path.c_str(), &info) != 0))
+		{
+			return(false);
+		}
+		bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+		uint64_t hash = 14695981039346656037ull;
+		for (unsigned char byte : bytes)
+		{
+			hash = (hash ^ byte) * 1099511628211ull;
+		}
+		memcpy(key.magic, g_TextureCacheMagic, sizeof(key.magic));
+		key.version = g_TextureCacheVersion;
+		key.sourceTime = static_cast<int64_t>(info.st_mtime);
+		key.sourceSize = bytes.size();
+		key.sourceHash = hash;
+		return(true);
+	}
 
-	SetShaderColor(0.1, 0.1, 0.12, 1);
+	/***********************************************************
+	 *  MapCachedTexture()
+	 *
+	 *  This function is used for mapping the cache file of a
+	 *  texture, if there is one that matches the source key and
+	 *  holds every level the texture needs. Every level must lie
+	 *  inside the file and follow the mip chain the upload
+	 *  expects, so a damaged file is decoded again instead.
+	 ***********************************************************/
+	bool MapCachedTexture(TEXTURE_LOAD& load, const std::string& cachePath, const TEXTURE_CACHE_HEADER& key, bool bWantLayer)
+	{
+		std::unique_ptr<MappedFile> mapping(new MappedFile());
+		if (!mapping->Open(cachePath) || (mapping->Size() < sizeof(TEXTURE_CACHE_HEADER)))
+		{
+			return(false);
+		}
+		TEXTURE_CACHE_HEADER header;
+		memcpy(&header, mapping->Data(), sizeof(header));
+		if ((memcmp(header.magic, key.magic, sizeof(header.magic)) != 0) || (header.version != key.version) ||
+			(header.sourceTime != key.sourceTime) || (header.sourceSize != key.sourceSize) ||
+			(header.sourceHash != key.sourceHash) || (header.layerSize != g_TextureArraySize) ||
+			(bWantLayer && (header.layerLevelCount == 0)) || (header.levelCount <= 0) ||
+			(header.levelCount + header.layerLevelCount > g_MaxTextureLevels) ||
+			(header.dataBytes > mapping->Size() - sizeof(header)) ||
+			((header.channels != 3) && (header.channels != 4)))
+		{
+			return(false);
+		}
+		const int32_t maxLevelSize = 65536;
+		for (int i = 0; i < header.levelCount + header.layerLevelCount; i++)
+		{
+			const TEXTURE_LEVEL& level = header.levels[i];
+			bool bLayer = (i >= header.levelCount);
+			bool bFirst = (i == 0) || (i == header.levelCount);
+			if (bFirst)
+			{
+				if ((level.width <= 0) || (level.height <= 0) || (level.width > maxLevelSize) || (level.height > maxLevelSize) ||
+					(bLayer && ((level.width != header.layerSize) || (level.height != header.layerSize))))
+				{
+					return(false);
+				}
+			}
+			else if ((level.width != std::max(1, header.levels[i - 1].width / 2)) ||
+				(level.height != std::max(1, header.levels[i - 1].height / 2)))
+			{
+				return(false);
+			}
+			uint64_t bytes = static_cast<uint64_t>(level.width) * level.height * (bLayer ? 4 : header.channels);
+			if ((level.offset > header.dataBytes) || (bytes > header.dataBytes - level.offset))
+			{
+				return(false);
+			}
+		}
+		load.header = header;
+		load.data = mapping->Data() + sizeof(header);
+		load.mapping = std::move(mapping);
+		load.bFromCache = true;
+		return(true);
+	}
 
-	// draw the mesh with transformation values
-	SetShaderMaterial("metal");
-	m_basicMeshes->DrawBoxMesh();
+	/***********************************************************
+	 *  DecodeTexture()
+	 *
+	 *  This function is used for decoding a texture and building
+	 *  the mip chains of both the texture and its texture array
+	 *  layer, then writing them to the cache file. A cache file
+	 *  that cannot be written only costs the next start a decode.
+	 ***********************************************************/
+	bool DecodeTexture(TEXTURE_LOAD& load, const std::vector<unsigned char>& bytes, const std::string& cachePath,
+		const TEXTURE_CACHE_HEADER& key, bool bWantLayer)
+	{
+		int width = 0;
+		int height = 0;
+		int channels = 0;
+		unsigned char* image = stbi_load_from_memory(bytes.data(), static_cast<int>(bytes.size()), &width, &height, &channels, 0);
+		if (!image)
+		{
+			load.error = "Could not load image:" + load.path;
+			return(false);
+		}
+		if ((channels != 3) && (channels != 4))
+		{
+			stbi_image_free(image);
+			load.error = "Not implemented to handle image with " + std::to_string(channels) + " channels";
+			return(false);
+		}
 
-	//SetShaderColor(1, 1, 1, 1);
+		TEXTURE_CACHE_HEADER& header = load.header;
+		header = key;
+		header.channels = channels;
+		header.layerSize = g_TextureArraySize;
+		header.levels[0] = AppendTextureLevel(load.pixels, width, height, channels);
+		memcpy(&load.pixels[static_cast<size_t>(header.levels[0].offset)], image, static_cast<size_t>(width) * height * channels);
+		stbi_image_free(image);
+		header.levelCount = AppendMipChain(load.pixels, header.levels, g_MaxTextureLevels, channels);
 
-	//m_basicMeshes->DrawBoxMeshLines();
+		header.layerLevelCount = 0;
+		if (bWantLayer)
+		{
+			TEXTURE_LEVEL* layerLevels = header.levels + header.levelCount;
+			const TEXTURE_LEVEL& source = header.levels[0];
+			layerLevels[0] = AppendTextureLevel(load.pixels, g_TextureArraySize, g_TextureArraySize, 4);
+			ResampleTextureLayer(&load.pixels[static_cast<size_t>(source.offset)], source.width, source.height, channels,
+				&load.pixels[static_cast<size_t>(layerLevels[0].offset)]);
+			header.layerLevelCount = AppendMipChain(load.pixels, layerLevels, g_MaxTextureLevels - header.levelCount, 4);
+		}
+		header.dataBytes = load.pixels.size();
+		load.data = load.pixels.data();
+
+		// written under a temporary name first so that a reader
+		// never maps a half written file
+		std::string tempPath = cachePath + ".tmp";
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(load.pixels.data()), static_cast<std::streamsize>(load.pixels.size()));
+		file.close();
+		std::remove(cachePath.c_str());
+		if (!file || (std::rename(tempPath.c_str(), cachePath.c_str()) != 0))
+		{
+			std::remove(tempPath.c_str());
+		}
+		return(true);
+	}
 
+	/***********************************************************
+	 *  PrepareTextureLoad()
+	 *
+	 *  This function is used for producing the pixels of every
+	 *  level of a queued texture, from its cache file when that
+	 *  is still valid and by decoding the source otherwise.
+	 ***********************************************************/
+	bool PrepareTextureLoad(TEXTURE_LOAD& load, const char* cacheFolder)
+	{
+		std::vector<unsigned char> bytes;
+		TEXTURE_CACHE_HEADER key;
+		memset(&key, 0, sizeof(key));
+		if (!ReadTextureSource(load.path, bytes, key))
+		{
+			load.error = "Could not load image:" + load.path;
+			return(false);
+		}
+		bool bWantLayer = (load.handle < g_textureArrayLayers);
+		std::string cachePath = TextureCachePath(cacheFolder, load.path);
+		if (MapCachedTexture(load, cachePath, key, bWantLayer))
+		{
+			return(true);
+		}
+		return(DecodeTexture(load, bytes, cachePath, key, bWantLayer));
+	}
 
+	/***********************************************************
+	 *  DecodeTextureWorker()
+	 *
+	 *  This function is used as the body of a decode worker. It
+	 *  claims queued textures until none are left, so the GL
+	 *  thread is left with nothing but the uploads.
+	 ***********************************************************/
+	void DecodeTextureWorker()
+	{
+		for (;;)
+		{
+			size_t index = g_nextDecode.fetch_add(1);
+			if (g_bStopDecoding || (index >= g_textureLoads.size()))
+			{
+				return;
+			}
+			TEXTURE_LOAD& load = g_textureLoads[index];
+			load.bReady = PrepareTextureLoad(load, g_TextureCacheFolder);
+
+			std::lock_guard<std::mutex> lock(g_decodedMutex);
+			g_decodedLoads.push_back(static_cast<int>(index));
+		}
+	}
 
-	//--------------------------------------------------------------------------
+	/***********************************************************
+	 *  InitTextureLoad()
+	 *
+	 *  This function is used for setting up a texture load that
+	 *  has not been prepared yet.
+	 ***********************************************************/
+	void InitTextureLoad(TEXTURE_LOAD& load, const std::string& path, GLuint textureID, int textureHandle)
+	{
+		load.path = path;
+		load.textureID = textureID;
+		load.handle = textureHandle;
+		load.bReady = false;
+		load.bFromCache = false;
+		load.error.clear();
+		memset(&load.header, 0, sizeof(load.header));
+		load.data = nullptr;
+		load.pixels.clear();
+		load.mapping.reset();
+	}
 
+	/***********************************************************
+	 *  QueueTextureLoad()
+	 *
+	 *  This function is used for queueing a texture file to be
+	 *  decoded into an already registered texture handle.
+	 ***********************************************************/
+	void QueueTextureLoad(const std::string& path, GLuint textureID, int textureHandle)
+	{
+		TEXTURE_LOAD load;
+		InitTextureLoad(load, path, textureID, textureHandle);
+		g_textureLoads.push_back(std::move(load));
 
+		g_textureResident.resize(textureHandle + 1, 0);
+		g_textureResident[textureHandle] = 0;
+	}
 
+	/***********************************************************
+	 *  CreateTextureFolder()
+	 *
+	 *  This function is used for making sure a cache folder
+	 *  exists. An existing folder is not an error.
+	 ***********************************************************/
+	void CreateTextureFolder(const char* folder)
+	{
+#ifdef _WIN32
+		_mkdir(folder);
+#else
+		mkdir(folder, 0755);
+#endif
+	}
 
-	scaleXYZ = glm::vec3(1.5f, 1.5f, 1.5f);
+	/***********************************************************
+	 *  StartTextureDecoding()
+	 *
+	 *  This function is used for allocating the texture array
+	 *  for the queued textures and starting the decode workers.
+	 *  Nothing may be queued until the workers are stopped.
+	 ***********************************************************/
+	void StartTextureDecoding()
+	{
+		if (g_textureLoads.empty())
+		{
+			return;
+		}
+		g_textureLoadStart = std::chrono::steady_clock::now();
+		CreateTextureFolder(g_TextureCacheFolder);
+
+		// every layer and level is allocated up front; the layers
+		// only become visible once their texture is resident
+		GLint maxLayers = 0;
+		glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+		g_textureArrayLayers = static_cast<int>(g_textureLoads.size());
+		if (g_textureArrayLayers > maxLayers)
+		{
+			std::cerr << "[SceneManager] ERROR: " << g_textureArrayLayers << " texture(s) do not fit a texture array of "
+				<< maxLayers << " layer(s)" << std::endl;
+			g_textureArrayLayers = 0;
+		}
+		else
+		{
+			glGenTextures(1, &g_textureArray);
+			glActiveTexture(GL_TEXTURE0 + g_TextureArrayUnit);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, g_textureArray);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			g_textureArrayLevels = 0;
+			for (int size = g_TextureArraySize; size > 0; size /= 2)
+			{
+				glTexImage3D(GL_TEXTURE_2D_ARRAY, g_textureArrayLevels++, GL_RGBA8, size, size,
+					g_textureArrayLayers, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+			}
+			glActiveTexture(GL_TEXTURE0);
+		}
+		glGenBuffers(2, g_uploadBuffers);
+
+		// the flip flag is global to stb_image, so it is set once
+		// before any worker decodes
+		stbi_set_flip_vertically_on_load(true);
+		unsigned int workers = std::max(1u, std::thread::hardware_concurrency());
+		workers = std::min(workers, static_cast<unsigned int>(g_textureLoads.size()));
+		for (unsigned int i = 0; i < workers; i++)
+		{
+			g_decodeWorkers.emplace_back(DecodeTextureWorker);
+		}
+	}
 
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 90.0f;
+	/***********************************************************
+	 *  StopTextureDecoding()
+	 *
+	 *  This function is used for joining the decode workers and
+	 *  freeing whatever was decoded but never uploaded.
+	 ***********************************************************/
+	void StopTextureDecoding()
+	{
+		g_bStopDecoding = true;
+		for (std::thread& worker : g_decodeWorkers)
+		{
+			worker.join();
+		}
+		g_decodeWorkers.clear();
+		g_bStopDecoding = false;
 
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(8.0f, 6.5f, -3.5f);
+		g_textureLoads.clear();
+		g_decodedLoads.clear();
+		g_nextDecode = 0;
+		g_uploadedLoads = 0;
+		g_cachedLoads = 0;
+		g_textureLoadFrames = 0;
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+		if (g_uploadBuffers[0] != 0)
+		{
+			glDeleteBuffers(2, g_uploadBuffers);
+			g_uploadBuffers[0] = 0;
+			g_uploadBuffers[1] = 0;
+		}
+	}
 
-	SetShaderColor(0.0f, 0.9f, 1.0f, 1.0f);
+	/***********************************************************
+	 *  UploadTextureLoad()
+	 *
+	 *  This function is used for streaming every level of a
+	 *  prepared texture and its texture array layer to the GPU
+	 *  through a pixel buffer object. The texture is bound on
+	 *  its own slot, where BindGLTextures() expects it. Returns
+	 *  false if the texture could not be prepared.
+	 ***********************************************************/
+	bool UploadTextureLoad(const TEXTURE_LOAD& load)
+	{
+		if (!load.bReady)
+		{
+			std::cout << load.error << std::endl;
+			std::cerr << "[SceneManager] ERROR: Failed to load texture: " << load.path << std::endl;
+			return(false);
+		}
+		const TEXTURE_CACHE_HEADER& header = load.header;
+		std::cout << "Successfully loaded image:" << load.path << ", width:" << header.levels[0].width << ", height:"
+			<< header.levels[0].height << ", channels:" << header.channels
+			<< (load.bFromCache ? " (cached)" : "") << std::endl;
+
+		GLuint buffer = g_uploadBuffers[g_nextUploadBuffer];
+		g_nextUploadBuffer = 1 - g_nextUploadBuffer;
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+		// orphaning the old storage keeps the map from waiting on an
+		// upload that is still in flight
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, static_cast<GLsizeiptr>(header.dataBytes), nullptr, GL_STREAM_DRAW);
+		void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, static_cast<GLsizeiptr>(header.dataBytes),
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		if (!mapped)
+		{
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			std::cerr << "[SceneManager] ERROR: Could not map the upload buffer for " << load.path << std::endl;
+			return(false);
+		}
+		memcpy(mapped, load.data, static_cast<size_t>(header.dataBytes));
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
 
-	SetShaderMaterial("metal");
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawTorusMesh();
+		// the levels are tightly packed
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
-	//SetShaderColor(1, 1, 1, 1);
+		glActiveTexture(GL_TEXTURE0 + load.handle);
+		glBindTexture(GL_TEXTURE_2D, load.textureID);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, header.levelCount - 1);
+		for (int i = 0; i < header.levelCount; i++)
+		{
+			const TEXTURE_LEVEL& level = header.levels[i];
+			if (header.channels == 3)
+				glTexImage2D(GL_TEXTURE_2D, i, GL_RGB8, level.width, level.height, 0, GL_RGB, GL_UNSIGNED_BYTE, (void*)static_cast<uintptr_t>(level.offset));
+			else
+				glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA8, level.width, level.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, (void*)static_cast<uintptr_t>(level.offset));
+		}
 
-	//m_basicMeshes->DrawBoxMeshLines();
-	//--------------------------------------------------------------------------
+		if ((g_textureArray != 0) && (load.handle < g_textureArrayLayers))
+		{
+			glActiveTexture(GL_TEXTURE0 + g_TextureArrayUnit);
+			int levels = std::min(header.layerLevelCount, g_textureArrayLevels);
+			for (int i = 0; i < levels; i++)
+			{
+				const TEXTURE_LEVEL& level = header.levels[header.levelCount + i];
+				glTexSubImage3D(GL_TEXTURE_2D_ARRAY, i, 0, 0, load.handle, level.width, level.height, 1,
+					GL_RGBA, GL_UNSIGNED_BYTE, (void*)static_cast<uintptr_t>(level.offset));
+			}
+		}
+		glActiveTexture(GL_TEXTURE0);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		return(true);
+	}
 
-	scaleXYZ = glm::vec3(1.5f, 1.5f, 1.5f);
+	/***********************************************************
+	 *  DeleteTextureArray()
+	 *
+	 *  This function is used for freeing the texture array.
+	 ***********************************************************/
+	void DeleteTextureArray()
+	{
+		if (g_textureArray != 0)
+		{
+			glDeleteTextures(1, &g_textureArray);
+			g_textureArray = 0;
+		}
+		g_textureArrayLayers = 0;
+		g_textureArrayLevels = 0;
+	}
 
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 90.0f;
+	// the scene description, parsed once in PrepareScene()
+	std::vector<SCENE_OBJECT> g_sceneObjects;
+	std::vector<SCENE_DRAW> g_sceneDraws;
+
+	// cached world matrix for each scene object, and the indices of the
+	// objects whose matrices can change after PrepareScene()
+	std::vector<glm::mat4> g_worldMatrices;
+	std::vector<int> g_dynamicObjects;
+	std::chrono::steady_clock::time_point g_lastFrameTime;
+
+	/***********************************************************
+	 *  ParseSceneMesh()
+	 *
+	 *  This function is used for converting a mesh name from
+	 *  the scene file into its mesh type.
+	 ***********************************************************/
+	bool ParseSceneMesh(const std::string& name, SCENE_MESH& mesh)
+	{
+		static const struct { const char* name; SCENE_MESH mesh; } meshNames[] =
+		{
+			{ "plane", MESH_PLANE },
+			{ "box", MESH_BOX },
+			{ "cylinder", MESH_CYLINDER },
+			{ "torus", MESH_TORUS },
+			{ "prism", MESH_PRISM },
+			{ "pyramid4", MESH_PYRAMID4 }
+		};
 
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(8.0f, 3.3f, -3.5f);
+		for (const auto& entry : meshNames)
+		{
+			if (name.compare(entry.name) == 0)
+			{
+				mesh = entry.mesh;
+				return(true);
+			}
+		}
+		return(false);
+	}
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+	/***********************************************************
+	 *  ParseScenePart()
+	 *
+	 *  This function is used for converting a part name from
+	 *  the scene file into a part of the passed in mesh.
+	 ***********************************************************/
+	bool ParseScenePart(SCENE_MESH mesh, const std::string& name, SCENE_PART& part)
+	{
+		static const struct { SCENE_MESH mesh; const char* name; SCENE_PART part; } partNames[] =
+		{
+			{ MESH_BOX, "top", PART_BOX_TOP },
+			{ MESH_BOX, "bottom", PART_BOX_BOTTOM },
+			{ MESH_BOX, "left", PART_BOX_LEFT },
+			{ MESH_BOX, "right", PART_BOX_RIGHT },
+			{ MESH_BOX, "front", PART_BOX_FRONT },
+			{ MESH_BOX, "back", PART_BOX_BACK },
+			{ MESH_CYLINDER, "top", PART_CYLINDER_TOP },
+			{ MESH_CYLINDER, "bottom", PART_CYLINDER_BOTTOM },
+			{ MESH_CYLINDER, "sides", PART_CYLINDER_SIDES }
+		};
 
-	SetShaderColor(0.0f, 0.9f, 1.0f, 1.0f);
+		for (const auto& entry : partNames)
+		{
+			if ((entry.mesh == mesh) && (name.compare(entry.name) == 0))
+			{
+				part = entry.part;
+				return(true);
+			}
+		}
+		return(false);
+	}
 
+	/***********************************************************
+	 *  LoadSceneDescription()
+	 *
+	 *  This function is used for parsing the scene file into
+	 *  the flat object and draw lists that RenderScene() walks.
+	 *  See the header of the scene file for the line format.
+	 ***********************************************************/
+	bool LoadSceneDescription(const char* filename)
+	{
+		std::ifstream file(filename);
+		if (!file.is_open())
+		{
+			std::cerr << "[SceneManager] ERROR: Failed to open scene file: " << filename << std::endl;
+			return(false);
+		}
 
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawTorusMesh();
+		g_sceneObjects.clear();
+		g_sceneDraws.clear();
 
-	//SetShaderColor(1, 1, 1, 1);
+		std::string line;
+		std::string label;
+		int lineNumber = 0;
+		int lightCount = 0;
+		while (std::getline(file, line))
+		{
+			lineNumber++;
+			std::istringstream ss(line);
+			std::string meshName;
+
+			// skip blank lines and comments; the last comment names
+			// the component the objects below it belong to
+			if (!(ss >> meshName))
+			{
+				continue;
+			}
+			if (meshName[0] == '#')
+			{
+				size_t text = line.find_first_not_of("# \t", line.find('#'));
+				if (text != std::string::npos)
+				{
+					label = line.substr(text, line.find_last_not_of(" \t\r") + 1 - text);
+				}
+				continue;
+			}
+
+			// light posX posY posZ  r g b  range - after the lights
+			// SetupSceneLights() placed
+			if (meshName.compare("light") == 0)
+			{
+				glm::vec3 position;
+				glm::vec3 color;
+				float range = 0.0f;
+				if (!(ss >> position.x >> position.y >> position.z >> color.r >> color.g >> color.b >> range) || (range <= 0.0f))
+				{
+					std::cerr << "[SceneManager] ERROR: Invalid light on line " << lineNumber << " of " << filename << std::endl;
+					continue;
+				}
+				g_sceneLights.SetLight(g_sceneLights.Count(), position, glm::vec3(0.0f), color, color, range);
+				lightCount++;
+				continue;
+			}
+
+			SCENE_OBJECT object;
+			std::string materialTag;
+			object.bDynamic = false;
+			object.bDirty = true;
+			object.spinDegreesPerSecond = 0.0f;
+			object.spinDegrees = 0.0f;
+			object.label = label;
+			object.bCovered = false;
+			std::string textureTag;
+			bool bValid = ParseSceneMesh(meshName, object.mesh);
+			bValid = bValid && (ss >> object.scaleXYZ.x >> object.scaleXYZ.y >> object.scaleXYZ.z);
+			bValid = bValid && (ss >> object.rotationDegrees.x >> object.rotationDegrees.y >> object.rotationDegrees.z);
+			bValid = bValid && (ss >> object.positionXYZ.x >> object.positionXYZ.y >> object.positionXYZ.z);
+			bValid = bValid && (ss >> object.color.r >> object.color.g >> object.color.b >> object.color.a);
+			bValid = bValid && (ss >> textureTag >> materialTag);
+			if (!bValid)
+			{
+				std::cerr << "[SceneManager] ERROR: Invalid object on line " << lineNumber << " of " << filename << std::endl;
+				continue;
+			}
+
+			// textures and materials are referred to by handle from here on;
+			// "-" keeps the material of the object before, as it did when
+			// the scene was drawn strictly in file order
+			object.materialHandle = g_sceneObjects.empty() ? -1 : g_sceneObjects.back().materialHandle;
+			if (materialTag.compare("-") != 0)
+			{
+				object.materialHandle = FindHandle(g_materialTags, materialTag);
+				if (object.materialHandle < 0)
+				{
+					std::cerr << "[SceneManager] ERROR: Unknown material '" << materialTag << "' on line " << lineNumber << " of " << filename << std::endl;
+				}
+			}
+			auto resolveTexture = [&](const std::string& tag) {
+				int handle = -1;
+				if (tag.compare("-") != 0)
+				{
+					handle = FindHandle(g_textureTags, tag);
+					if (handle < 0)
+					{
+						std::cerr << "[SceneManager] ERROR: Unknown texture '" << tag << "' on line " << lineNumber << " of " << filename << std::endl;
+					}
+				}
+				return(handle);
+				};
+
+			object.firstDraw = static_cast<int>(g_sceneDraws.size());
+			object.layer = 0;
+			object.instanceGroup = -1;
+
+			// optional per-part textures replace the single full draw
+			std::string partToken;
+			while (ss >> partToken)
+			{
+				// spin=<x|y|z>:<degrees per second> marks the object dynamic
+				char spinAxis = 0;
+				float spinSpeed = 0.0f;
+				if ((partToken.compare(0, 5, "spin=") == 0) &&
+					(sscanf(partToken.c_str() + 5, "%c:%f", &spinAxis, &spinSpeed) == 2) &&
+					(spinAxis >= 'x') && (spinAxis <= 'z'))
+				{
+					object.bDynamic = true;
+					object.spinAxis = glm::vec3(0.0f);
+					object.spinAxis[spinAxis - 'x'] = 1.0f;
+					object.spinDegreesPerSecond = spinSpeed;
+					continue;
+				}
+
+				size_t equals = partToken.find('=');
+				SCENE_DRAW draw;
+				draw.object = static_cast<int>(g_sceneObjects.size());
+				if ((equals == std::string::npos) ||
+					!ParseScenePart(object.mesh, partToken.substr(0, equals), draw.part))
+				{
+					std::cerr << "[SceneManager] ERROR: Unknown part '" << partToken << "' on line " << lineNumber << " of " << filename << std::endl;
+					continue;
+				}
+				draw.textureHandle = resolveTexture(partToken.substr(equals + 1));
+				g_sceneDraws.push_back(draw);
+			}
+
+			if (static_cast<int>(g_sceneDraws.size()) == object.firstDraw)
+			{
+				SCENE_DRAW draw;
+				draw.object = static_cast<int>(g_sceneObjects.size());
+				draw.part = PART_FULL;
+				draw.textureHandle = resolveTexture(textureTag);
+				g_sceneDraws.push_back(draw);
+			}
+
+			object.drawCount = static_cast<int>(g_sceneDraws.size()) - object.firstDraw;
+			g_sceneObjects.push_back(object);
+		}
 
-	//m_basicMeshes->DrawBoxMeshLines();
-	//--------------------------------------------------------------------------
-	scaleXYZ = glm::vec3(1.5f, 1.5f, 1.5f);
+		std::cout << "[SceneManager] Loaded " << g_sceneObjects.size() << " object(s), "
+			<< g_sceneDraws.size() << " draw(s), " << lightCount << " light(s) from " << filename << std::endl;
+		return(true);
+	}
 
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 90.0f;
+	/***********************************************************
+	 *  DrawScenePart()
+	 *
+	 *  This function is used for drawing one part of one of
+	 *  the loaded basic meshes.
+	 ***********************************************************/
+	void DrawScenePart(ShapeMeshes* meshes, SCENE_MESH mesh, SCENE_PART part)
+	{
+		switch (part)
+		{
+		case PART_BOX_TOP: meshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::top); return;
+		case PART_BOX_BOTTOM: meshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::bottom); return;
+		case PART_BOX_LEFT: meshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::left); return;
+		case PART_BOX_RIGHT: meshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::right); return;
+		case PART_BOX_FRONT: meshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::front); return;
+		case PART_BOX_BACK: meshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::back); return;
+		case PART_CYLINDER_TOP: meshes->DrawCylinderMesh(true, false, false); return;
+		case PART_CYLINDER_BOTTOM: meshes->DrawCylinderMesh(false, true, false); return;
+		case PART_CYLINDER_SIDES: meshes->DrawCylinderMesh(false, false, true); return;
+		case PART_FULL: break;
+		}
 
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(8.0f, 9.7f, -3.5f);
+		switch (mesh)
+		{
+		case MESH_PLANE: meshes->DrawPlaneMesh(); break;
+		case MESH_BOX: meshes->DrawBoxMesh(); break;
+		case MESH_CYLINDER: meshes->DrawCylinderMesh(); break;
+		case MESH_TORUS: meshes->DrawTorusMesh(); break;
+		case MESH_PRISM: meshes->DrawPrismMesh(); break;
+		case MESH_PYRAMID4: meshes->DrawPyramid4Mesh(); break;
+		}
+	}
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+	/***********************************************************
+	 *  ComputeModelMatrix()
+	 *
+	 *  This function is used for building a model matrix from
+	 *  scale, rotation (degrees) and position values.
+	 ***********************************************************/
+	glm::mat4 ComputeModelMatrix(
+		glm::vec3 scaleXYZ,
+		float XrotationDegrees,
+		float YrotationDegrees,
+		float ZrotationDegrees,
+		glm::vec3 positionXYZ)
+	{
+		glm::mat4 scale = glm::scale(scaleXYZ);
+		glm::mat4 rotationX = glm::rotate(glm::radians(XrotationDegrees), glm::vec3(1.0f, 0.0f, 0.0f));
+		glm::mat4 rotationY = glm::rotate(glm::radians(YrotationDegrees), glm::vec3(0.0f, 1.0f, 0.0f));
+		glm::mat4 rotationZ = glm::rotate(glm::radians(ZrotationDegrees), glm::vec3(0.0f, 0.0f, 1.0f));
+		glm::mat4 translation = glm::translate(positionXYZ);
 
-	SetShaderColor(0.0f, 0.9f, 1.0f, 1.0f);
+		return(translation * rotationZ * rotationY * rotationX * scale);
+	}
 
+	/***********************************************************
+	 *  ComputeObjectMatrix()
+	 *
+	 *  This function is used for building the world matrix of
+	 *  a scene object, including its current spin.
+	 ***********************************************************/
+	glm::mat4 ComputeObjectMatrix(const SCENE_OBJECT& object)
+	{
+		glm::mat4 model = ComputeModelMatrix(
+			object.scaleXYZ,
+			object.rotationDegrees.x,
+			object.rotationDegrees.y,
+			object.rotationDegrees.z,
+			object.positionXYZ);
+
+		// the spin is about the mesh's own axis, applied after
+		// scaling and before the object's placement rotations
+		if (object.bDynamic)
+		{
+			glm::mat4 placement = ComputeModelMatrix(
+				glm::vec3(1.0f),
+				object.rotationDegrees.x,
+				object.rotationDegrees.y,
+				object.rotationDegrees.z,
+				object.positionXYZ);
+			glm::mat4 spin = glm::rotate(glm::radians(object.spinDegrees), object.spinAxis);
+			model = placement * spin * glm::scale(object.scaleXYZ);
+		}
+		return(model);
+	}
 
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawTorusMesh();
+	// whether the generated copy of each basic mesh was found to
+	// match the ShapeMeshes one; meshes that do not are drawn only
+	// through ShapeMeshes, and their bounds are the measured ones
+	bool g_bMeshMatches[SCENE_MESH_COUNT];
+
+	// local bounds of each basic mesh, and the world space bounding
+	// box of every scene object kept as separate arrays so that the
+	// frustum test can gather the boxes of four objects at once
+	glm::vec3 g_meshBoundsMin[SCENE_MESH_COUNT];
+	glm::vec3 g_meshBoundsMax[SCENE_MESH_COUNT];
+	std::vector<float> g_boundsCenter[3];
+	std::vector<float> g_boundsExtent[3];
+
+	/***********************************************************
+	 *  UpdateObjectBounds()
+	 *
+	 *  This function is used for fitting the world space box of
+	 *  a scene object around its mesh bounds, moved by its
+	 *  cached world matrix.
+	 ***********************************************************/
+	void UpdateObjectBounds(int index)
+	{
+		const glm::mat4& model = g_worldMatrices[index];
+		SCENE_MESH mesh = g_sceneObjects[index].mesh;
+		glm::vec3 localCenter = (g_meshBoundsMin[mesh] + g_meshBoundsMax[mesh]) * 0.5f;
+		glm::vec3 localExtent = (g_meshBoundsMax[mesh] - g_meshBoundsMin[mesh]) * 0.5f;
+
+		// each world extent sums the local extents along the
+		// absolute values of the matrix rows
+		glm::vec3 center = glm::vec3(model * glm::vec4(localCenter, 1.0f));
+		for (int axis = 0; axis < 3; axis++)
+		{
+			g_boundsCenter[axis][index] = center[axis];
+			g_boundsExtent[axis][index] =
+				fabsf(model[0][axis]) * localExtent.x +
+				fabsf(model[1][axis]) * localExtent.y +
+				fabsf(model[2][axis]) * localExtent.z;
+		}
+	}
 
-	//SetShaderColor(1, 1, 1, 1);
+	/***********************************************************
+	 *  TestBoxesOutside()
+	 *
+	 *  This function is used for testing up to four boxes, given
+	 *  by object index into center and extent arrays, against
+	 *  the frustum planes selected by planeMask. Returns a bit
+	 *  per box that lies wholly behind one of the planes. With
+	 *  SSE the four boxes are tested at once.
+	 ***********************************************************/
+	int TestBoxesOutside(const std::vector<float>* center, const std::vector<float>* extent,
+		const int* objects, int count, const glm::vec4* planes, int planeMask)
+	{
+		int outsideMask = 0;
+#ifdef SCENE_CULL_SSE
+		int lanes[4];
+		for (int lane = 0; lane < 4; lane++)
+		{
+			lanes[lane] = objects[std::min(lane, count - 1)];
+		}
+		__m128 centerX = _mm_setr_ps(center[0][lanes[0]], center[0][lanes[1]], center[0][lanes[2]], center[0][lanes[3]]);
+		__m128 centerY = _mm_setr_ps(center[1][lanes[0]], center[1][lanes[1]], center[1][lanes[2]], center[1][lanes[3]]);
+		__m128 centerZ = _mm_setr_ps(center[2][lanes[0]], center[2][lanes[1]], center[2][lanes[2]], center[2][lanes[3]]);
+		__m128 extentX = _mm_setr_ps(extent[0][lanes[0]], extent[0][lanes[1]], extent[0][lanes[2]], extent[0][lanes[3]]);
+		__m128 extentY = _mm_setr_ps(extent[1][lanes[0]], extent[1][lanes[1]], extent[1][lanes[2]], extent[1][lanes[3]]);
+		__m128 extentZ = _mm_setr_ps(extent[2][lanes[0]], extent[2][lanes[1]], extent[2][lanes[2]], extent[2][lanes[3]]);
+		__m128 outside = _mm_setzero_ps();
+		for (int p = 0; p < 6; p++)
+		{
+			if ((planeMask & (1 << p)) == 0)
+			{
+				continue;
+			}
+			__m128 distance = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(centerX, _mm_set1_ps(planes[p].x)), _mm_mul_ps(centerY, _mm_set1_ps(planes[p].y))),
+				_mm_add_ps(_mm_mul_ps(centerZ, _mm_set1_ps(planes[p].z)), _mm_set1_ps(planes[p].w)));
+			__m128 radius = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(extentX, _mm_set1_ps(fabsf(planes[p].x))), _mm_mul_ps(extentY, _mm_set1_ps(fabsf(planes[p].y)))),
+				_mm_mul_ps(extentZ, _mm_set1_ps(fabsf(planes[p].z))));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+		}
+		outsideMask = _mm_movemask_ps(outside) & ((1 << count) - 1);
+#else
+		for (int lane = 0; lane < count; lane++)
+		{
+			int object = objects[lane];
+			for (int p = 0; p < 6; p++)
+			{
+				if ((planeMask & (1 << p)) == 0)
+				{
+					continue;
+				}
+				float distance = center[0][object] * planes[p].x + center[1][object] * planes[p].y +
+					center[2][object] * planes[p].z + planes[p].w;
+				float radius = extent[0][object] * fabsf(planes[p].x) + extent[1][object] * fabsf(planes[p].y) +
+					extent[2][object] * fabsf(planes[p].z);
+				if (distance + radius < 0.0f)
+				{
+					outsideMask |= (1 << lane);
+					break;
+				}
+			}
+		}
+#endif
+		return(outsideMask);
+	}
 
-	//m_basicMeshes->DrawBoxMeshLines();
+	/***********************************************************
+	 *  BoundingVolumeHierarchy
+	 *
+	 *  A binary tree of boxes over a set of objects, given as
+	 *  separate center and extent arrays. It is built with the
+	 *  surface area heuristic and refit in place when objects
+	 *  move, and answers frustum and ray queries without
+	 *  visiting the subtrees that cannot contribute.
+	 ***********************************************************/
+	class BoundingVolumeHierarchy
+	{
+	public:
+		BoundingVolumeHierarchy() : m_center(nullptr), m_extent(nullptr), m_depth(0) {}
 
-	//--------------------------------------------------------------------------
+		// builds the tree over the first count objects of the arrays,
+		// which must stay in place while the tree is used
+		void Build(const std::vector<float>* center, const std::vector<float>* extent, int count)
+		{
+			m_center = center;
+			m_extent = extent;
+			m_nodes.clear();
+			m_objects.resize(count);
+			m_leafOf.assign(count, -1);
+			m_parent.clear();
+			m_depth = 0;
+			if (count == 0)
+			{
+				return;
+			}
+			for (int i = 0; i < count; i++)
+			{
+				m_objects[i] = i;
+			}
+			m_nodes.reserve(2 * count);
+			m_parent.reserve(2 * count);
+			AddNode(-1);
+			BuildNode(0, 0, count, 1);
+		}
 
+		// grows the boxes around the passed in objects, and only
+		// their ancestors, after they have moved
+		void Refit(const std::vector<int>& movedObjects)
+		{
+			for (int object : movedObjects)
+			{
+				for (int node = m_leafOf[object]; node >= 0; node = m_parent[node])
+				{
+					FitNode(node);
+				}
+			}
+		}
 
+		// marks the objects whose boxes are not wholly behind one of
+		// the planes; returns the number marked
+		int CullFrustum(const glm::vec4 planes[6], std::vector<char>& visible) const
+		{
+			std::fill(visible.begin(), visible.end(), 0);
+			if (m_nodes.empty())
+			{
+				return(0);
+			}
+			int visibleCount = 0;
+			int stack[BVH_STACK_SIZE][2];
+			int stackSize = 0;
+			stack[stackSize][0] = 0;
+			stack[stackSize++][1] = 0x3F;
+			while (stackSize > 0)
+			{
+				stackSize--;
+				const BVH_NODE& node = m_nodes[stack[stackSize][0]];
+				int planeMask = stack[stackSize][1];
+
+				// planes the node is wholly in front of are not
+				// tested again below it
+				bool bOutside = false;
+				glm::vec3 center = (node.boundsMin + node.boundsMax) * 0.5f;
+				glm::vec3 extent = (node.boundsMax - node.boundsMin) * 0.5f;
+				for (int p = 0; (p < 6) && !bOutside; p++)
+				{
+					if ((planeMask & (1 << p)) == 0)
+					{
+						continue;
+					}
+					float distance = glm::dot(glm::vec3(planes[p]), center) + planes[p].w;
+					float radius = glm::dot(glm::abs(glm::vec3(planes[p])), extent);
+					bOutside = (distance + radius < 0.0f);
+					if (distance - radius >= 0.0f)
+					{
+						planeMask &= ~(1 << p);
+					}
+				}
+				if (bOutside)
+				{
+					continue;
+				}
+
+				if ((planeMask == 0) || ((node.child >= 0) && (stackSize + 2 > BVH_STACK_SIZE)))
+				{
+					// wholly inside, or too deep to look into
+					for (int i = node.objectFirst; i < node.objectFirst + node.objectCount; i++)
+					{
+						visible[m_objects[i]] = 1;
+					}
+					visibleCount += node.objectCount;
+				}
+				else if (node.child < 0)
+				{
+					int outsideMask = TestBoxesOutside(m_center, m_extent, &m_objects[node.objectFirst], node.objectCount, planes, planeMask);
+					for (int i = 0; i < node.objectCount; i++)
+					{
+						if ((outsideMask & (1 << i)) == 0)
+						{
+							visible[m_objects[node.objectFirst + i]] = 1;
+							visibleCount++;
+						}
+					}
+				}
+				else
+				{
+					stack[stackSize][0] = node.child;
+					stack[stackSize++][1] = planeMask;
+					stack[stackSize][0] = node.child + 1;
+					stack[stackSize++][1] = planeMask;
+				}
+			}
+			return(visibleCount);
+		}
 
-	scaleXYZ = glm::vec3(0.5f, 0.2f, 0.5f);
+		// walks the boxes the ray passes through nearest first, and
+		// hands every object in them to hitTest(object, nearest),
+		// which returns true and lowers nearest for a closer hit;
+		// returns the object hit last, or -1
+		template <class HitTest>
+		int Raycast(const glm::vec3& origin, const glm::vec3& direction, float& nearest, HitTest hitTest) const
+		{
+			int hit = -1;
+			if (m_nodes.empty())
+			{
+				return(hit);
+			}
+			glm::vec3 inverse(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+			int stack[BVH_STACK_SIZE];
+			int stackSize = 0;
+			stack[stackSize++] = 0;
+			while (stackSize > 0)
+			{
+				const BVH_NODE& node = m_nodes[stack[--stackSize]];
+				float entry = 0.0f;
+				if (!RayHitsBox(origin, inverse, node.boundsMin, node.boundsMax, nearest, entry))
+				{
+					continue;
+				}
+				if ((node.child < 0) || (stackSize + 2 > BVH_STACK_SIZE))
+				{
+					for (int i = node.objectFirst; i < node.objectFirst + node.objectCount; i++)
+					{
+						if (hitTest(m_objects[i], nearest))
+						{
+							hit = m_objects[i];
+						}
+					}
+					continue;
+				}
+
+				// the nearer child is pushed last so it is visited first
+				float entryA = 0.0f;
+				float entryB = 0.0f;
+				const BVH_NODE& childA = m_nodes[node.child];
+				const BVH_NODE& childB = m_nodes[node.child + 1];
+				bool bHitA = RayHitsBox(origin, inverse, childA.boundsMin, childA.boundsMax, nearest, entryA);
+				bool bHitB = RayHitsBox(origin, inverse, childB.boundsMin, childB.boundsMax, nearest, entryB);
+				int first = (entryA <= entryB) ? node.child : node.child + 1;
+				int second = (first == node.child) ? node.child + 1 : node.child;
+				if ((first == node.child) ? bHitB : bHitA)
+				{
+					stack[stackSize++] = second;
+				}
+				if ((first == node.child) ? bHitA : bHitB)
+				{
+					stack[stackSize++] = first;
+				}
+			}
+			return(hit);
+		}
 
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 90.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+		size_t NodeCount() const
+		{
+			return(m_nodes.size());
+		}
+		int Depth() const
+		{
+			return(m_depth);
+		}
 
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(8.0f, 9.7f, -3.5f);
+		// the slab test - true if the ray enters the box before
+		// maxDistance, with the distance it enters at
+		static bool RayHitsBox(const glm::vec3& origin, const glm::vec3& inverseDirection,
+			const glm::vec3& boundsMin, const glm::vec3& boundsMax, float maxDistance, float& entry)
+		{
+			float enter = 0.0f;
+			float exit = maxDistance;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				float t0 = (boundsMin[axis] - origin[axis]) * inverseDirection[axis];
+				float t1 = (boundsMax[axis] - origin[axis]) * inverseDirection[axis];
+				if (t0 > t1)
+				{
+					std::swap(t0, t1);
+				}
+				// NaN from a zero direction on a slab boundary keeps the ray
+				enter = (t0 > enter) ? t0 : enter;
+				exit = (t1 < exit) ? t1 : exit;
+				if (enter > exit)
+				{
+					return(false);
+				}
+			}
+			entry = enter;
+			return(true);
+		}
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+	private:
+		struct BVH_NODE
+		{
+			glm::vec3 boundsMin;
+			glm::vec3 boundsMax;
+			int child;                  // first of two children, -1 for a leaf
+			int objectFirst;            // the node's objects in m_objects
+			int objectCount;
+		};
 
-	SetShaderColor(0.0f, 0.0f, 0.0f, 1.0f);
+		static const int LEAF_SIZE = 4;     // TestBoxesOutside() tests four at once
+		static const int BIN_COUNT = 12;
+		static const int BVH_STACK_SIZE = 64;
 
+		int AddNode(int parent)
+		{
+			BVH_NODE node;
+			node.child = -1;
+			node.objectFirst = 0;
+			node.objectCount = 0;
+			m_nodes.push_back(node);
+			m_parent.push_back(parent);
+			return(static_cast<int>(m_nodes.size()) - 1);
+		}
+
+		glm::vec3 ObjectMin(int object) const
+		{
+			return(glm::vec3(m_center[0][object] - m_extent[0][object], m_center[1][object] - m_extent[1][object],
+				m_center[2][object] - m_extent[2][object]));
+		}
+		glm::vec3 ObjectMax(int object) const
+		{
+			return(glm::vec3(m_center[0][object] + m_extent[0][object], m_center[1][object] + m_extent[1][object],
+				m_center[2][object] + m_extent[2][object]));
+		}
 
+		static float SurfaceArea(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+		{
+			glm::vec3 size = glm::max(boundsMax - boundsMin, glm::vec3(0.0f));
+			return(2.0f * (size.x * size.y + size.y * size.z + size.z * size.x));
+		}
 
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh();
+		// recomputes a node's box from its objects or its children
+		void FitNode(int index)
+		{
+			BVH_NODE& node = m_nodes[index];
+			if (node.child >= 0)
+			{
+				node.boundsMin = glm::min(m_nodes[node.child].boundsMin, m_nodes[node.child + 1].boundsMin);
+				node.boundsMax = glm::max(m_nodes[node.child].boundsMax, m_nodes[node.child + 1].boundsMax);
+				return;
+			}
+			node.boundsMin = ObjectMin(m_objects[node.objectFirst]);
+			node.boundsMax = ObjectMax(m_objects[node.objectFirst]);
+			for (int i = node.objectFirst + 1; i < node.objectFirst + node.objectCount; i++)
+			{
+				node.boundsMin = glm::min(node.boundsMin, ObjectMin(m_objects[i]));
+				node.boundsMax = glm::max(node.boundsMax, ObjectMax(m_objects[i]));
+			}
+		}
 
-	//SetShaderColor(1, 1, 1, 1);
+		// splits the objects of a node into two children where the
+		// binned surface area heuristic finds the cheapest split,
+		// until a node holds no more than a leaf's worth
+		void BuildNode(int index, int first, int count, int depth)
+		{
+			m_depth = std::max(m_depth, depth);
+			m_nodes[index].objectFirst = first;
+			m_nodes[index].objectCount = count;
+			m_nodes[index].child = -1;
+
+			glm::vec3 centroidMin(m_center[0][m_objects[first]], m_center[1][m_objects[first]], m_center[2][m_objects[first]]);
+			glm::vec3 centroidMax = centroidMin;
+			glm::vec3 boundsMin = ObjectMin(m_objects[first]);
+			glm::vec3 boundsMax = ObjectMax(m_objects[first]);
+			for (int i = first + 1; i < first + count; i++)
+			{
+				int object = m_objects[i];
+				glm::vec3 centroid(m_center[0][object], m_center[1][object], m_center[2][object]);
+				centroidMin = glm::min(centroidMin, centroid);
+				centroidMax = glm::max(centroidMax, centroid);
+				boundsMin = glm::min(boundsMin, ObjectMin(object));
+				boundsMax = glm::max(boundsMax, ObjectMax(object));
+			}
+			m_nodes[index].boundsMin = boundsMin;
+			m_nodes[index].boundsMax = boundsMax;
+			for (int i = first; i < first + count; i++)
+			{
+				m_leafOf[m_objects[i]] = index;
+			}
+			if (count <= LEAF_SIZE)
+			{
+				return;
+			}
+
+			// cost of each split between bins, on each axis
+			float bestCost = 0.0f;
+			int bestAxis = -1;
+			int bestSplit = 0;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				float span = centroidMax[axis] - centroidMin[axis];
+				if (span <= 0.0f)
+				{
+					continue;
+				}
+				int binCount[BIN_COUNT] = { 0 };
+				glm::vec3 binMin[BIN_COUNT];
+				glm::vec3 binMax[BIN_COUNT];
+				float scale = BIN_COUNT / span;
+				for (int i = first; i < first + count; i++)
+				{
+					int object = m_objects[i];
+					int bin = std::min(BIN_COUNT - 1, static_cast<int>((m_center[axis][object] - centroidMin[axis]) * scale));
+					binMin[bin] = binCount[bin] ? glm::min(binMin[bin], ObjectMin(object)) : ObjectMin(object);
+					binMax[bin] = binCount[bin] ? glm::max(binMax[bin], ObjectMax(object)) : ObjectMax(object);
+					binCount[bin]++;
+				}
+
+				float rightArea[BIN_COUNT];
+				int rightCount[BIN_COUNT];
+				glm::vec3 sweepMin;
+				glm::vec3 sweepMax;
+				int sweepCount = 0;
+				for (int bin = BIN_COUNT - 1; bin > 0; bin--)
+				{
+					if (binCount[bin])
+					{
+						sweepMin = sweepCount ? glm::min(sweepMin, binMin[bin]) : binMin[bin];
+						sweepMax = sweepCount ? glm::max(sweepMax, binMax[bin]) : binMax[bin];
+						sweepCount += binCount[bin];
+					}
+					rightArea[bin] = sweepCount ? SurfaceArea(sweepMin, sweepMax) : 0.0f;
+					rightCount[bin] = sweepCount;
+				}
+				sweepCount = 0;
+				for (int split = 1; split < BIN_COUNT; split++)
+				{
+					int bin = split - 1;
+					if (binCount[bin])
+					{
+						sweepMin = sweepCount ? glm::min(sweepMin, binMin[bin]) : binMin[bin];
+						sweepMax = sweepCount ? glm::max(sweepMax, binMax[bin]) : binMax[bin];
+						sweepCount += binCount[bin];
+					}
+					if ((sweepCount == 0) || (rightCount[split] == 0))
+					{
+						continue;
+					}
+					float cost = SurfaceArea(sweepMin, sweepMax) * sweepCount + rightArea[split] * rightCount[split];
+					if ((bestAxis < 0) || (cost < bestCost))
+					{
+						bestCost = cost;
+						bestAxis = axis;
+						bestSplit = split;
+					}
+				}
+			}
+
+			int middle = first + count / 2;
+			if (bestAxis >= 0)
+			{
+				float scale = BIN_COUNT / (centroidMax[bestAxis] - centroidMin[bestAxis]);
+				float minimum = centroidMin[bestAxis];
+				const std::vector<float>& centers = m_center[bestAxis];
+				middle = static_cast<int>(std::partition(m_objects.begin() + first, m_objects.begin() + first + count,
+					[&](int object) {
+						return(std::min(BIN_COUNT - 1, static_cast<int>((centers[object] - minimum) * scale)) < bestSplit);
+					}) - m_objects.begin());
+			}
+			// objects stacked on one point still split, by count
+
+			int child = AddNode(index);
+			AddNode(index);
+			m_nodes[index].child = child;
+			BuildNode(child, first, middle - first, depth + 1);
+			BuildNode(child + 1, middle, first + count - middle, depth + 1);
+		}
 
-	//m_basicMeshes->DrawBoxMeshLines();
+		const std::vector<float>* m_center;
+		const std::vector<float>* m_extent;
+		std::vector<BVH_NODE> m_nodes;
+		std::vector<int> m_objects;     // object indices, each node's contiguous
+		std::vector<int> m_leafOf;      // the leaf holding each object
+		std::vector<int> m_parent;      // by node, -1 for the root
+		int m_depth;
+	};
+
+	// the hierarchy over the scene objects' boxes
+	BoundingVolumeHierarchy g_sceneBvh;
+	std::vector<int> g_movedObjects;
+
+	/***********************************************************
+	 *  BuildWorldMatrices()
+	 *
+	 *  This function is used for filling the world matrix cache
+	 *  for every scene object. It runs once in PrepareScene().
+	 ***********************************************************/
+	void BuildWorldMatrices()
+	{
+		g_worldMatrices.resize(g_sceneObjects.size());
+		g_dynamicObjects.clear();
+		for (size_t i = 0; i < g_sceneObjects.size(); i++)
+		{
+			SCENE_OBJECT& object = g_sceneObjects[i];
+			g_worldMatrices[i] = ComputeObjectMatrix(object);
+			object.bDirty = false;
+			if (object.bDynamic)
+			{
+				g_dynamicObjects.push_back(static_cast<int>(i));
+			}
+		}
+		g_lastFrameTime = std::chrono::steady_clock::now();
+	}
 
-	//--------------------------------------------------------------------------
-	scaleXYZ = glm::vec3(0.5f, 0.2f, 0.5f);
+	/***********************************************************
+	 *  UpdateWorldMatrices()
+	 *
+	 *  This function is used for advancing the dynamic objects
+	 *  and recomputing only the world matrices, and bounds,
+	 *  marked dirty, then refitting the hierarchy around them.
+	 *  Static objects keep the matrices from PrepareScene().
+	 ***********************************************************/
+	void UpdateWorldMatrices(float elapsedSeconds)
+	{
+		for (int index : g_dynamicObjects)
+		{
+			SCENE_OBJECT& object = g_sceneObjects[index];
+			if (object.spinDegreesPerSecond != 0.0f)
+			{
+				object.spinDegrees = fmodf(object.spinDegrees + (object.spinDegreesPerSecond * elapsedSeconds), 360.0f);
+				object.bDirty = true;
+			}
+			if (object.bDirty)
+			{
+				g_worldMatrices[index] = ComputeObjectMatrix(object);
+				UpdateObjectBounds(index);
+				g_movedObjects.push_back(index);
+				object.bDirty = false;
+			}
+		}
 
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 90.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+		// only the boxes above the moved objects are refit
+		if (!g_movedObjects.empty())
+		{
+			g_sceneBvh.Refit(g_movedObjects);
+			g_movedObjects.clear();
+		}
+	}
 
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(8.0f, 3.3f, -3.5f);
+	// one vertex of the generated basic meshes - the same layout
+	// as ShapeMeshes: position, normal, texture coordinate
+	struct MESH_VERTEX
+	{
+		glm::vec3 position;
+		glm::vec3 normal;
+		glm::vec2 uv;
+		GLint face;                 // which face texture of the object it shows
+		glm::vec2 lightmapUV;       // see GenerateLightmapUVs()
+	};
+
+	// a basic mesh generated for the geometry pool, with the index
+	// range of each part that can be drawn on its own
+	struct MESH_GEOMETRY
+	{
+		GLint baseVertex;
+		GLsizei partFirst[SCENE_PART_COUNT];
+		GLsizei partCount[SCENE_PART_COUNT];
+		float lightmapLayout;       // size of the lightmap chart layout, in texture coordinates
+	};
+
+	// a lightmap chart gets at least this many texels per texture
+	// coordinate unit, which leaves it a texel of gutter on each side
+	const int LIGHTMAP_TEXELS_PER_CHART = 8;
+
+	/***********************************************************
+	 *  MeshBuilder
+	 *
+	 *  Collects the vertices and indices of a generated mesh.
+	 *  Triangles are wound counter-clockwise around the normals
+	 *  of their vertices no matter the order they are added in.
+	 ***********************************************************/
+	class MeshBuilder
+	{
+	public:
+		MeshBuilder() : face(0) {}
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+		std::vector<MESH_VERTEX> vertices;
+		std::vector<GLuint> indices;
+		GLint face;                 // the face of the vertices added next
 
-	SetShaderColor(0.0f, 0.0f, 0.0f, 1.0f);
+		GLuint AddVertex(glm::vec3 position, glm::vec3 normal, glm::vec2 uv)
+		{
+			MESH_VERTEX vertex;
+			vertex.position = position;
+			vertex.normal = normal;
+			vertex.uv = uv;
+			vertex.face = face;
+			vertex.lightmapUV = glm::vec2(0.0f);
+			vertices.push_back(vertex);
+			return(static_cast<GLuint>(vertices.size()) - 1);
+		}
 
+		void AddTriangle(GLuint a, GLuint b, GLuint c)
+		{
+			glm::vec3 faceNormal = glm::cross(
+				vertices[b].position - vertices[a].position,
+				vertices[c].position - vertices[a].position);
+			glm::vec3 vertexNormal = vertices[a].normal + vertices[b].normal + vertices[c].normal;
+			indices.push_back(a);
+			if (glm::dot(faceNormal, vertexNormal) < 0.0f)
+			{
+				std::swap(b, c);
+			}
+			indices.push_back(b);
+			indices.push_back(c);
+		}
 
+		// a flat quad around center, spanning +-halfU and +-halfV
+		void AddQuad(glm::vec3 center, glm::vec3 halfU, glm::vec3 halfV)
+		{
+			glm::vec3 normal = glm::normalize(glm::cross(halfU, halfV));
+			GLuint a = AddVertex(center - halfU - halfV, normal, glm::vec2(0.0f, 0.0f));
+			GLuint b = AddVertex(center + halfU - halfV, normal, glm::vec2(1.0f, 0.0f));
+			GLuint c = AddVertex(center + halfU + halfV, normal, glm::vec2(1.0f, 1.0f));
+			GLuint d = AddVertex(center - halfU + halfV, normal, glm::vec2(0.0f, 1.0f));
+			AddTriangle(a, b, c);
+			AddTriangle(a, c, d);
+		}
 
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh();
+		// a flat triangle with a normal facing away from inside
+		void AddFlatTriangle(glm::vec3 p0, glm::vec3 p1, glm::vec3 p2, glm::vec3 inside)
+		{
+			glm::vec3 normal = glm::normalize(glm::cross(p1 - p0, p2 - p0));
+			if (glm::dot(normal, p0 - inside) < 0.0f)
+			{
+				normal = -normal;
+			}
+			AddTriangle(
+				AddVertex(p0, normal, glm::vec2(0.0f, 0.0f)),
+				AddVertex(p1, normal, glm::vec2(1.0f, 0.0f)),
+				AddVertex(p2, normal, glm::vec2(0.5f, 1.0f)));
+		}
 
-	//SetShaderColor(1, 1, 1, 1);
+		GLsizei IndexCount() const
+		{
+			return(static_cast<GLsizei>(indices.size()));
+		}
+	};
+
+	/***********************************************************
+	 *  HashBytes()
+	 *
+	 *  This function is used for folding a block of memory into
+	 *  a running FNV-1a hash.
+	 ***********************************************************/
+	uint64_t HashBytes(uint64_t hash, const void* data, size_t size)
+	{
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; i++)
+		{
+			hash = (hash ^ bytes[i]) * 1099511628211ull;
+		}
+		return(hash);
+	}
 
-	//m_basicMeshes->DrawBoxMeshLines();
-	//--------------------------------------------------------------------------
+	// a vertex as the lightmap weld compares it - the position,
+	// normal and texture coordinate snapped to LIGHTMAP_WELD_STEP,
+	// so vertices that differ by less than a step usually share
+	// a key and are welded too
+	const float LIGHTMAP_WELD_STEP = 1.0f / 65536.0f;
 
-	scaleXYZ = glm::vec3(0.5f, 0.2f, 0.5f);
+	struct LIGHTMAP_WELD_KEY
+	{
+		int32_t values[8];
 
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 90.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+		bool operator==(const LIGHTMAP_WELD_KEY& other) const
+		{
+			return(memcmp(values, other.values, sizeof(values)) == 0);
+		}
+	};
 
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(8.0f, 6.5f, -3.5f);
+	struct LightmapWeldHash
+	{
+		size_t operator()(const LIGHTMAP_WELD_KEY& key) const
+		{
+			return(static_cast<size_t>(HashBytes(14695981039346656037ull, key.values, sizeof(key.values))));
+		}
+	};
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+	LIGHTMAP_WELD_KEY MakeWeldKey(const MESH_VERTEX& vertex)
+	{
+		const float components[8] = {
+			vertex.position.x, vertex.position.y, vertex.position.z,
+			vertex.normal.x, vertex.normal.y, vertex.normal.z,
+			vertex.uv.x, vertex.uv.y };
+		LIGHTMAP_WELD_KEY key;
+		for (int i = 0; i < 8; i++)
+		{
+			key.values[i] = static_cast<int32_t>(std::lround(components[i] / LIGHTMAP_WELD_STEP));
+		}
+		return(key);
+	}
 
-	SetShaderColor(0.0f, 0.0f, 0.0f, 1.0f);
+	/***********************************************************
+	 *  GenerateLightmapUVs()
+	 *
+	 *  This function is used for giving every vertex of a built
+	 *  mesh a lightmap coordinate that no other triangle shares.
+	 *  Vertices that match in position, normal and coordinate,
+	 *  to within LIGHTMAP_WELD_STEP, are welded through a hash,
+	 *  the triangles that then touch form one chart, and the
+	 *  charts are laid out on shelves by their texture
+	 *  coordinate bounds with a gutter around each. The layout
+	 *  is scaled into 0 to 1; returns its size before scaling.
+	 ***********************************************************/
+	float GenerateLightmapUVs(MeshBuilder& builder)
+	{
+		const float gutter = 1.0f / LIGHTMAP_TEXELS_PER_CHART;
+		std::vector<MESH_VERTEX>& vertices = builder.vertices;
+		std::vector<GLuint> chartOf(vertices.size());
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			chartOf[i] = static_cast<GLuint>(i);
+		}
+		auto findChart = [&](GLuint vertex) {
+			while (chartOf[vertex] != vertex)
+			{
+				chartOf[vertex] = chartOf[chartOf[vertex]];
+				vertex = chartOf[vertex];
+			}
+			return(vertex);
+			};
+
+		// weld onto the first vertex with the same key, then join
+		// the corners of every triangle
+		std::unordered_map<LIGHTMAP_WELD_KEY, GLuint, LightmapWeldHash> welded;
+		welded.reserve(vertices.size());
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			auto first = welded.emplace(MakeWeldKey(vertices[i]), static_cast<GLuint>(i));
+			if (!first.second)
+			{
+				chartOf[findChart(static_cast<GLuint>(i))] = findChart(first.first->second);
+			}
+		}
+		for (size_t i = 0; i + 2 < builder.indices.size(); i += 3)
+		{
+			GLuint a = findChart(builder.indices[i]);
+			chartOf[findChart(builder.indices[i + 1])] = a;
+			chartOf[findChart(builder.indices[i + 2])] = a;
+		}
 
+		// the texture coordinate bounds of each chart
+		struct LIGHTMAP_CHART
+		{
+			GLuint root;
+			glm::vec2 low;
+			glm::vec2 high;
+			glm::vec2 offset;
+		};
+		std::vector<LIGHTMAP_CHART> charts;
+		std::vector<int> chartIndex(vertices.size(), -1);
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			GLuint root = findChart(static_cast<GLuint>(i));
+			if (chartIndex[root] < 0)
+			{
+				LIGHTMAP_CHART chart;
+				chart.root = root;
+				chart.low = chart.high = vertices[i].uv;
+				chartIndex[root] = static_cast<int>(charts.size());
+				charts.push_back(chart);
+			}
+			LIGHTMAP_CHART& chart = charts[chartIndex[root]];
+			chart.low = glm::vec2(std::min(chart.low.x, vertices[i].uv.x), std::min(chart.low.y, vertices[i].uv.y));
+			chart.high = glm::vec2(std::max(chart.high.x, vertices[i].uv.x), std::max(chart.high.y, vertices[i].uv.y));
+		}
+		if (charts.empty())
+		{
+			return(0.0f);
+		}
 
+		// tallest first onto shelves about as wide as the layout is tall
+		float area = 0.0f;
+		std::vector<int> order(charts.size());
+		for (size_t i = 0; i < charts.size(); i++)
+		{
+			glm::vec2 size = charts[i].high - charts[i].low + 2.0f * gutter;
+			area += size.x * size.y;
+			order[i] = static_cast<int>(i);
+		}
+		std::sort(order.begin(), order.end(), [&](int a, int b) {
+			return((charts[a].high.y - charts[a].low.y) > (charts[b].high.y - charts[b].low.y));
+			});
+		float shelfWidth = std::sqrt(area);
+		glm::vec2 cursor(0.0f);
+		float shelfHeight = 0.0f;
+		glm::vec2 layout(0.0f);
+		for (int i : order)
+		{
+			glm::vec2 size = charts[i].high - charts[i].low + 2.0f * gutter;
+			if ((cursor.x > 0.0f) && (cursor.x + size.x > shelfWidth))
+			{
+				cursor = glm::vec2(0.0f, cursor.y + shelfHeight);
+				shelfHeight = 0.0f;
+			}
+			charts[i].offset = cursor + gutter - charts[i].low;
+			cursor.x += size.x;
+			shelfHeight = std::max(shelfHeight, size.y);
+			layout = glm::vec2(std::max(layout.x, cursor.x), std::max(layout.y, cursor.y + shelfHeight));
+		}
 
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh();
+		float scale = 1.0f / std::max(layout.x, layout.y);
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			const LIGHTMAP_CHART& chart = charts[chartIndex[findChart(static_cast<GLuint>(i))]];
+			vertices[i].lightmapUV = (vertices[i].uv + chart.offset) * scale;
+		}
+		return(std::max(layout.x, layout.y));
+	}
 
-	//SetShaderColor(1, 1, 1, 1);
+	/***********************************************************
+	 *  BuildMeshGeometry()
+	 *
+	 *  This function is used for generating one of the basic
+	 *  meshes with the same extents as the ShapeMeshes version,
+	 *  noting where each of its parts starts in the indices,
+	 *  marking the vertices of each part with its face and
+	 *  charting its lightmap coordinates.
+	 ***********************************************************/
+	void BuildMeshGeometry(SCENE_MESH mesh, MeshBuilder& builder, MESH_GEOMETRY& geometry)
+	{
+		const float pi = 3.14159265f;
+		const int segments = 36;
+		const glm::vec3 xAxis(1.0f, 0.0f, 0.0f);
+		const glm::vec3 yAxis(0.0f, 1.0f, 0.0f);
+		const glm::vec3 zAxis(0.0f, 0.0f, 1.0f);
 
-	//m_basicMeshes->DrawBoxMeshLines();
+		for (int part = 0; part < SCENE_PART_COUNT; part++)
+		{
+			geometry.partFirst[part] = 0;
+			geometry.partCount[part] = 0;
+		}
+		auto beginPart = [&](SCENE_PART part) {
+			geometry.partFirst[part] = builder.IndexCount();
+			builder.face = PartFace(part);
+			};
+		auto endPart = [&](SCENE_PART part) {
+			geometry.partCount[part] = builder.IndexCount() - geometry.partFirst[part];
+			builder.face = 0;
+			};
+
+		switch (mesh)
+		{
+		case MESH_PLANE:
+			// 2 x 2 in the XZ plane, facing up
+			builder.AddQuad(glm::vec3(0.0f), xAxis, -zAxis);
+			break;
+		case MESH_BOX:
+			// 1 x 1 x 1 centered on the origin, one quad per side
+			beginPart(PART_BOX_TOP);
+			builder.AddQuad(yAxis * 0.5f, xAxis * 0.5f, -zAxis * 0.5f);
+			endPart(PART_BOX_TOP);
+			beginPart(PART_BOX_BOTTOM);
+			builder.AddQuad(-yAxis * 0.5f, xAxis * 0.5f, zAxis * 0.5f);
+			endPart(PART_BOX_BOTTOM);
+			beginPart(PART_BOX_LEFT);
+			builder.AddQuad(-xAxis * 0.5f, zAxis * 0.5f, yAxis * 0.5f);
+			endPart(PART_BOX_LEFT);
+			beginPart(PART_BOX_RIGHT);
+			builder.AddQuad(xAxis * 0.5f, -zAxis * 0.5f, yAxis * 0.5f);
+			endPart(PART_BOX_RIGHT);
+			beginPart(PART_BOX_FRONT);
+			builder.AddQuad(zAxis * 0.5f, xAxis * 0.5f, yAxis * 0.5f);
+			endPart(PART_BOX_FRONT);
+			beginPart(PART_BOX_BACK);
+			builder.AddQuad(-zAxis * 0.5f, -xAxis * 0.5f, yAxis * 0.5f);
+			endPart(PART_BOX_BACK);
+			break;
+		case MESH_CYLINDER:
+			// radius 1 around the Y axis, from y = 0 to y = 1
+			for (int cap = 0; cap < 2; cap++)
+			{
+				SCENE_PART part = (cap == 0) ? PART_CYLINDER_TOP : PART_CYLINDER_BOTTOM;
+				float y = (cap == 0) ? 1.0f : 0.0f;
+				glm::vec3 normal = (cap == 0) ? yAxis : -yAxis;
+				beginPart(part);
+				GLuint center = builder.AddVertex(glm::vec3(0.0f, y, 0.0f), normal, glm::vec2(0.5f, 0.5f));
+				for (int i = 0; i < segments; i++)
+				{
+					float a0 = 2.0f * pi * i / segments;
+					float a1 = 2.0f * pi * (i + 1) / segments;
+					GLuint v0 = builder.AddVertex(glm::vec3(cosf(a0), y, sinf(a0)), normal, glm::vec2(0.5f + 0.5f * cosf(a0), 0.5f + 0.5f * sinf(a0)));
+					GLuint v1 = builder.AddVertex(glm::vec3(cosf(a1), y, sinf(a1)), normal, glm::vec2(0.5f + 0.5f * cosf(a1), 0.5f + 0.5f * sinf(a1)));
+					builder.AddTriangle(center, v0, v1);
+				}
+				endPart(part);
+			}
+			beginPart(PART_CYLINDER_SIDES);
+			for (int i = 0; i < segments; i++)
+			{
+				float a0 = 2.0f * pi * i / segments;
+				float a1 = 2.0f * pi * (i + 1) / segments;
+				glm::vec3 n0(cosf(a0), 0.0f, sinf(a0));
+				glm::vec3 n1(cosf(a1), 0.0f, sinf(a1));
+				float u0 = static_cast<float>(i) / segments;
+				float u1 = static_cast<float>(i + 1) / segments;
+				GLuint b0 = builder.AddVertex(n0, n0, glm::vec2(u0, 0.0f));
+				GLuint b1 = builder.AddVertex(n1, n1, glm::vec2(u1, 0.0f));
+				GLuint t1 = builder.AddVertex(n1 + yAxis, n1, glm::vec2(u1, 1.0f));
+				GLuint t0 = builder.AddVertex(n0 + yAxis, n0, glm::vec2(u0, 1.0f));
+				builder.AddTriangle(b0, b1, t1);
+				builder.AddTriangle(b0, t1, t0);
+			}
+			endPart(PART_CYLINDER_SIDES);
+			break;
+		case MESH_TORUS:
+		{
+			// ring of radius 1 in the XY plane with a thin tube
+			const float tubeRadius = 0.1f;
+			const int tubeSegments = 12;
+			GLuint first = static_cast<GLuint>(builder.vertices.size());
+			for (int i = 0; i <= segments; i++)
+			{
+				float theta = 2.0f * pi * i / segments;
+				for (int j = 0; j <= tubeSegments; j++)
+				{
+					float phi = 2.0f * pi * j / tubeSegments;
+					glm::vec3 normal(cosf(phi) * cosf(theta), cosf(phi) * sinf(theta), sinf(phi));
+					glm::vec3 center(cosf(theta), sinf(theta), 0.0f);
+					builder.AddVertex(center + normal * tubeRadius, normal,
+						glm::vec2(static_cast<float>(i) / segments, static_cast<float>(j) / tubeSegments));
+				}
+			}
+			for (int i = 0; i < segments; i++)
+			{
+				for (int j = 0; j < tubeSegments; j++)
+				{
+					GLuint v00 = first + i * (tubeSegments + 1) + j;
+					GLuint v10 = v00 + (tubeSegments + 1);
+					builder.AddTriangle(v00, v10, v10 + 1);
+					builder.AddTriangle(v00, v10 + 1, v00 + 1);
+				}
+			}
+			break;
+		}
+		case MESH_PRISM:
+		{
+			// triangular cross section in XY, 1 deep along Z
+			glm::vec3 corners[3] = {
+				glm::vec3(-0.5f, -0.5f, 0.0f), glm::vec3(0.5f, -0.5f, 0.0f), glm::vec3(0.0f, 0.5f, 0.0f) };
+			glm::vec3 inside(0.0f, -1.0f / 6.0f, 0.0f);
+			builder.AddFlatTriangle(corners[0] + zAxis * 0.5f, corners[1] + zAxis * 0.5f, corners[2] + zAxis * 0.5f, inside);
+			builder.AddFlatTriangle(corners[0] - zAxis * 0.5f, corners[1] - zAxis * 0.5f, corners[2] - zAxis * 0.5f, inside);
+			for (int i = 0; i < 3; i++)
+			{
+				glm::vec3 edge = corners[(i + 1) % 3] - corners[i];
+				glm::vec3 center = (corners[i] + corners[(i + 1) % 3]) * 0.5f;
+				builder.AddQuad(center, edge * 0.5f, (glm::dot(glm::cross(edge, zAxis), center - inside) > 0.0f) ? zAxis * 0.5f : -zAxis * 0.5f);
+			}
+			break;
+		}
+		case MESH_PYRAMID4:
+		{
+			// 1 x 1 base at y = -0.5 with the apex at y = 0.5
+			glm::vec3 apex(0.0f, 0.5f, 0.0f);
+			glm::vec3 corners[4] = {
+				glm::vec3(-0.5f, -0.5f, 0.5f), glm::vec3(0.5f, -0.5f, 0.5f),
+				glm::vec3(0.5f, -0.5f, -0.5f), glm::vec3(-0.5f, -0.5f, -0.5f) };
+			for (int i = 0; i < 4; i++)
+			{
+				builder.AddFlatTriangle(corners[i], corners[(i + 1) % 4], apex, glm::vec3(0.0f));
+			}
+			builder.AddQuad(-yAxis * 0.5f, xAxis * 0.5f, zAxis * 0.5f);
+			break;
+		}
+		}
 
+		geometry.partFirst[PART_FULL] = 0;
+		geometry.partCount[PART_FULL] = builder.IndexCount();
+		geometry.lightmapLayout = GenerateLightmapUVs(builder);
+	}
 
-	//--------------------------------------------------------------------------
+	// which scene objects passed the frustum test this frame, and
+	// the test in progress
+	std::vector<char> g_objectVisible;
+	std::vector<char> g_cullResult;
+	bool g_bVisibilityChanged = true;
 
+	// running totals for the culling report
+	struct CULL_STATS
+	{
+		unsigned long long frames;
+		unsigned long long visible;
+		unsigned long long culled;
+		unsigned long long occluded;
+		double microseconds;
+	};
+	CULL_STATS g_cullStats = { 0, 0, 0, 0, 0.0 };
+
+	// the occlusion query of every scene object; an object whose box
+	// passed no samples the last time it was tested stays hidden
+	// until a later query sees it again
+	struct OCCLUSION_QUERY
+	{
+		GLuint query;
+		bool bPending;              // issued, and the result not read yet
+		bool bOccluded;
+	};
+	std::vector<OCCLUSION_QUERY> g_occlusionQueries;
+	std::vector<char> g_frustumVisible;
+
+	/***********************************************************
+	 *  HideOccludedObjects()
+	 *
+	 *  This function is used for reading back the occlusion
+	 *  queries that have finished and clearing the visible mark
+	 *  of the objects they found hidden. Results the GPU has not
+	 *  finished are left for a later frame instead of waiting
+	 *  on them. Returns the number of objects hidden.
+	 ***********************************************************/
+	int HideOccludedObjects(std::vector<char>& visible)
+	{
+		int hidden = 0;
+		for (size_t i = 0; i < g_occlusionQueries.size(); i++)
+		{
+			OCCLUSION_QUERY& occlusion = g_occlusionQueries[i];
+			if (occlusion.bPending)
+			{
+				GLuint bAvailable = GL_FALSE;
+				glGetQueryObjectuiv(occlusion.query, GL_QUERY_RESULT_AVAILABLE, &bAvailable);
+				if (bAvailable == GL_TRUE)
+				{
+					GLuint bSamplesPassed = GL_TRUE;
+					glGetQueryObjectuiv(occlusion.query, GL_QUERY_RESULT, &bSamplesPassed);
+					occlusion.bOccluded = (bSamplesPassed == GL_FALSE);
+					occlusion.bPending = false;
+				}
+			}
+
+			if (!visible[i])
+			{
+				// an object coming back into view is drawn until tested
+				occlusion.bOccluded = false;
+			}
+			else if (occlusion.bOccluded)
+			{
+				visible[i] = 0;
+				hidden++;
+			}
+		}
+		return(hidden);
+	}
 
+	/***********************************************************
+	 *  BuildObjectBounds()
+	 *
+	 *  This function is used for measuring the local bounds of
+	 *  the basic meshes, fitting the world space box of every
+	 *  scene object and building the hierarchy over the boxes.
+	 *  Runs after BuildWorldMatrices().
+	 ***********************************************************/
+	void BuildObjectBounds()
+	{
+		for (int mesh = 0; mesh < SCENE_MESH_COUNT; mesh++)
+		{
+			// VerifyMeshGeometry() measured the real bounds of these
+			if (!g_bMeshMatches[mesh])
+			{
+				continue;
+			}
+			MeshBuilder builder;
+			MESH_GEOMETRY geometry;
+			BuildMeshGeometry(static_cast<SCENE_MESH>(mesh), builder, geometry);
+			g_meshBoundsMin[mesh] = glm::vec3(0.0f);
+			g_meshBoundsMax[mesh] = glm::vec3(0.0f);
+			for (size_t i = 0; i < builder.vertices.size(); i++)
+			{
+				const glm::vec3& position = builder.vertices[i].position;
+				g_meshBoundsMin[mesh] = (i == 0) ? position : glm::min(g_meshBoundsMin[mesh], position);
+				g_meshBoundsMax[mesh] = (i == 0) ? position : glm::max(g_meshBoundsMax[mesh], position);
+			}
+		}
 
-	scaleXYZ = glm::vec3(1.2f, 0.2f, 1.2f);
+		for (int axis = 0; axis < 3; axis++)
+		{
+			g_boundsCenter[axis].assign(g_sceneObjects.size(), 0.0f);
+			g_boundsExtent[axis].assign(g_sceneObjects.size(), 0.0f);
+		}
+		for (size_t i = 0; i < g_sceneObjects.size(); i++)
+		{
+			UpdateObjectBounds(static_cast<int>(i));
+		}
+		g_objectVisible.assign(g_sceneObjects.size(), 1);
+		g_cullResult.assign(g_sceneObjects.size(), 1);
+		g_bVisibilityChanged = true;
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		g_sceneBvh.Build(g_boundsCenter, g_boundsExtent, static_cast<int>(g_sceneObjects.size()));
+		std::cout << "[SceneManager] Bounding volume hierarchy: " << g_sceneBvh.NodeCount() << " node(s), depth "
+			<< g_sceneBvh.Depth() << ", built in "
+			<< std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() << " us" << std::endl;
+	}
 
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 90.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+	/***********************************************************
+	 *  ExtractFrustumPlanes()
+	 *
+	 *  This function is used for pulling the six clip planes out
+	 *  of a view projection matrix, normalized so that a plane
+	 *  returns distances. Returns false for a matrix without a
+	 *  usable frustum.
+	 ***********************************************************/
+	bool ExtractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6])
+	{
+		glm::vec4 rows[4];
+		for (int row = 0; row < 4; row++)
+		{
+			rows[row] = glm::vec4(viewProjection[0][row], viewProjection[1][row], viewProjection[2][row], viewProjection[3][row]);
+		}
+		for (int axis = 0; axis < 3; axis++)
+		{
+			planes[axis * 2] = rows[3] + rows[axis];
+			planes[axis * 2 + 1] = rows[3] - rows[axis];
+		}
+		for (int i = 0; i < 6; i++)
+		{
+			float length = glm::length(glm::vec3(planes[i]));
+			if (!(length > 1e-6f))
+			{
+				return(false);
+			}
+			planes[i] /= length;
+		}
+		return(true);
+	}
 
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(8.0f, 6.5f, -3.6f);
+	/***********************************************************
+	 *  ReadProgramMatrix()
+	 *
+	 *  This function is used for reading back a matrix uniform,
+	 *  like the camera's, from the scene program. Returns a
+	 *  zero matrix if the program does not use it.
+	 *
+	 *  The ViewManager sets the camera through the ShaderManager,
+	 *  so this is the only way the scene sees it, but every call
+	 *  is a glGetUniformfv that makes the driver catch up. It is
+	 *  made twice a frame, for the view and the projection.
+	 ***********************************************************/
+	glm::mat4 ReadProgramMatrix(int handle)
+	{
+		glm::mat4 value(0.0f);
+		GLint location = g_uniformCache.Location(handle);
+		if ((g_uniformCache.Program() != 0) && (location >= 0))
+		{
+			glGetUniformfv(g_uniformCache.Program(), location, glm::value_ptr(value));
+		}
+		return(value);
+	}
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+	/***********************************************************
+	 *  CullSceneObjects()
+	 *
+	 *  This function is used for testing the scene objects
+	 *  against the camera frustum. The hierarchy drops whole
+	 *  groups of objects behind a plane, and accepts whole
+	 *  groups inside every plane, without testing their boxes.
+	 *  Objects the last occlusion queries found hidden are
+	 *  dropped after that.
+	 ***********************************************************/
+	void CullSceneObjects(const glm::mat4& view, const glm::mat4& projection)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		const int count = static_cast<int>(g_sceneObjects.size());
+		glm::vec4 planes[6];
+		int visible = count;
+		if (ExtractFrustumPlanes(projection * view, planes))
+		{
+			visible = g_sceneBvh.CullFrustum(planes, g_cullResult);
+		}
+		else
+		{
+			// without a camera nothing can be ruled out
+			std::fill(g_cullResult.begin(), g_cullResult.end(), 1);
+		}
+		g_frustumVisible.assign(g_cullResult.begin(), g_cullResult.end());
+		int occluded = HideOccludedObjects(g_cullResult);
+		if (g_cullResult != g_objectVisible)
+		{
+			g_objectVisible.swap(g_cullResult);
+			g_bVisibilityChanged = true;
+		}
 
-	SetShaderColor(0.3f, 0.95f, 1.0f, 1.0f);
+		g_cullStats.frames++;
+		g_cullStats.visible += visible - occluded;
+		g_cullStats.culled += count - visible;
+		g_cullStats.occluded += occluded;
+		g_cullStats.microseconds += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+	}
 
+	/***********************************************************
+	 *  PickSceneObject()
+	 *
+	 *  This function is used for finding the nearest scene
+	 *  object along a world space ray. The hierarchy narrows the
+	 *  search to the boxes the ray passes through, and each
+	 *  candidate is tested against its mesh bounds in its own
+	 *  space, so rotated objects are hit only where they are.
+	 *  Returns -1 when the ray hits nothing.
+	 ***********************************************************/
+	int PickSceneObject(const glm::vec3& origin, const glm::vec3& direction, float& distance)
+	{
+		distance = std::numeric_limits<float>::max();
+		return(g_sceneBvh.Raycast(origin, direction, distance, [&](int object, float& nearest) {
+			if (g_sceneObjects[object].bCovered)
+			{
+				return(false);
+			}
+
+			// the ray parameter is the same in world and local space
+			glm::mat4 toLocal = glm::inverse(g_worldMatrices[object]);
+			glm::vec3 localOrigin = glm::vec3(toLocal * glm::vec4(origin, 1.0f));
+			glm::vec3 localDirection = glm::vec3(toLocal * glm::vec4(direction, 0.0f));
+			glm::vec3 inverseDirection(1.0f / localDirection.x, 1.0f / localDirection.y, 1.0f / localDirection.z);
+			SCENE_MESH mesh = g_sceneObjects[object].mesh;
+			float entry = 0.0f;
+			if (!BoundingVolumeHierarchy::RayHitsBox(localOrigin, inverseDirection,
+				g_meshBoundsMin[mesh], g_meshBoundsMax[mesh], nearest, entry))
+			{
+				return(false);
+			}
+			nearest = entry;
+			return(true);
+			}));
+	}
 
+	// whether the pick button was down on the last frame, and the
+	// object picked last
+	bool g_bPickButtonDown = false;
+	int g_pickedObject = -1;
+
+	/***********************************************************
+	 *  PollScenePicking()
+	 *
+	 *  This function is used for picking the object under the
+	 *  mouse cursor when the left button goes down. The picked
+	 *  object is outlined in the debug overlay.
+	 ***********************************************************/
+	void PollScenePicking(const glm::mat4& view, const glm::mat4& projection)
+	{
+		GLFWwindow* window = glfwGetCurrentContext();
+		if (window == nullptr)
+		{
+			return;
+		}
+		bool bPressed = (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS);
+		bool bClicked = bPressed && !g_bPickButtonDown;
+		g_bPickButtonDown = bPressed;
+		if (!bClicked)
+		{
+			return;
+		}
 
+		double cursorX = 0.0;
+		double cursorY = 0.0;
+		int width = 0;
+		int height = 0;
+		glfwGetCursorPos(window, &cursorX, &cursorY);
+		glfwGetWindowSize(window, &width, &height);
+		g_pickedObject = -1;
+		if ((width <= 0) || (height <= 0))
+		{
+			return;
+		}
 
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh();
+		// the cursor's line through the view volume, from the near
+		// plane to the far plane
+		float ndcX = static_cast<float>(2.0 * cursorX / width - 1.0);
+		float ndcY = static_cast<float>(1.0 - 2.0 * cursorY / height);
+		glm::mat4 toWorld = glm::inverse(projection * view);
+		glm::vec4 nearPoint = toWorld * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+		glm::vec4 farPoint = toWorld * glm::vec4(ndcX, ndcY, 1.0f, 1.0f);
+		if ((nearPoint.w == 0.0f) || (farPoint.w == 0.0f))
+		{
+			return;
+		}
+		glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+		glm::vec3 direction = glm::vec3(farPoint) / farPoint.w - origin;
+		if (!(glm::length(direction) > 0.0f))
+		{
+			return;
+		}
 
-	//SetShaderColor(1, 1, 1, 1);
+		float distance = 0.0f;
+		g_pickedObject = PickSceneObject(origin, glm::normalize(direction), distance);
+	}
 
-	//m_basicMeshes->DrawBoxMeshLines();
+	/***********************************************************
+	 *  ReportCulling()
+	 *
+	 *  This function is used for logging how many objects the
+	 *  frustum test kept and culled, and how many the occlusion
+	 *  queries hid, per frame.
+	 ***********************************************************/
+	void ReportCulling()
+	{
+		if (g_cullStats.frames == 0)
+		{
+			return;
+		}
+		std::cout << "[SceneManager] Culling per frame: " << (g_cullStats.visible / g_cullStats.frames)
+			<< " visible, " << (g_cullStats.culled / g_cullStats.frames) << " culled, "
+			<< (g_cullStats.occluded / g_cullStats.frames) << " occluded of " << g_sceneObjects.size()
+			<< " object(s), " << (g_cullStats.microseconds / g_cullStats.frames) << " us" << std::endl;
+	}
 
+	// the view frustum is split into screen tiles and, from the near
+	// to the far plane, into slices a constant ratio deep; the same
+	// numbers are defined in the pool shader
+	const int CLUSTER_TILES_X = 16;
+	const int CLUSTER_TILES_Y = 9;
+	const int CLUSTER_SLICES = 24;
+	const int CLUSTER_COUNT = CLUSTER_TILES_X * CLUSTER_TILES_Y * CLUSTER_SLICES;
+	const GLuint CLUSTER_LIGHT_BINDING = 2;
+
+	/***********************************************************
+	 *  ClusterLightGrid
+	 *
+	 *  Bins the scene lights into the clusters of the view
+	 *  frustum, so that the pool shader only evaluates the
+	 *  lights that reach the cluster a fragment is in. The
+	 *  slices are shared out between worker threads, each
+	 *  writing the lists of its own clusters, and the lists
+	 *  are then packed into one shader storage buffer: a
+	 *  header, an (offset, count) pair per cluster and the
+	 *  light indices. Nothing is binned again until the camera
+	 *  or a light changes.
+	 ***********************************************************/
+	class ClusterLightGrid
+	{
+	public:
+		ClusterLightGrid() : m_buffer(0), m_lightVersion(0), m_bBuilt(false), m_generation(0),
+			m_pending(0), m_bStop(false), m_rebuilds(0), m_lightReferences(0), m_microseconds(0.0)
+		{
+		}
 
-	//--------------------------------------------------------------------------
+		// rebins the lights if the camera or any light changed since
+		// the last frame, and uploads the new lists
+		void Update(const glm::mat4& view, const glm::mat4& projection)
+		{
+			if (m_bBuilt && (view == m_view) && (projection == m_projection) &&
+				(g_sceneLights.Version() == m_lightVersion))
+			{
+				return;
+			}
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			if (!m_bBuilt || (projection != m_projection))
+			{
+				BuildClusterBounds(projection);
+			}
+			m_view = view;
+			m_projection = projection;
+			m_lightVersion = g_sceneLights.Version();
+			m_bBuilt = true;
+
+			// the lights that are on, moved into view space once
+			m_lights.clear();
+			m_lightIndices.clear();
+			for (int i = 0; i < g_sceneLights.Count(); i++)
+			{
+				const SCENE_LIGHT& light = g_sceneLights.Light(i);
+				if (light.position.w != 0.0f)
+				{
+					glm::vec4 center = view * glm::vec4(glm::vec3(light.position), 1.0f);
+					m_lights.push_back(glm::vec4(glm::vec3(center), light.diffuse.w));
+					m_lightIndices.push_back(static_cast<GLuint>(i));
+				}
+			}
+
+			BinLights();
+			Upload();
+
+			m_rebuilds++;
+			m_microseconds += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+		}
 
+		void Destroy()
+		{
+			if (!m_workers.empty())
+			{
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					m_bStop = true;
+				}
+				m_wake.notify_all();
+				for (std::thread& worker : m_workers)
+				{
+					worker.join();
+				}
+				m_workers.clear();
+				m_bStop = false;
+			}
+			glDeleteBuffers(1, &m_buffer);
+			m_buffer = 0;
+			m_bBuilt = false;
+		}
 
+		void Report() const
+		{
+			if (m_rebuilds == 0)
+			{
+				return;
+			}
+			std::cout << "[SceneManager] Light clusters: " << m_rebuilds << " rebuild(s) on "
+				<< (m_workers.size() + 1) << " thread(s), " << (m_microseconds / m_rebuilds) << " us and "
+				<< (m_lightReferences / m_rebuilds) << " light reference(s) in " << CLUSTER_COUNT
+				<< " cluster(s) each" << std::endl;
+		}
 
-	scaleXYZ = glm::vec3(1.2f, 0.2f, 1.2f);
+	private:
+		// the lists one thread produced for its run of slices
+		struct CLUSTER_BIN
+		{
+			int firstSlice;
+			int endSlice;
+			std::vector<GLuint> indices;
+			std::vector<int> candidates;    // the lights reaching into the slice
+		};
 
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 90.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+		// finds the view space box of every cluster, and how the pool
+		// shader turns a depth into a slice
+		void BuildClusterBounds(const glm::mat4& projection)
+		{
+			m_clusterMin.resize(CLUSTER_COUNT);
+			m_clusterMax.resize(CLUSTER_COUNT);
+
+			// an orthographic view has no depth ratio to slice by, so
+			// every cluster covers the whole view and gets every light
+			if (projection[2][3] == 0.0f)
+			{
+				m_sliceScale = m_sliceBias = 0.0f;
+				std::fill(m_clusterMin.begin(), m_clusterMin.end(), glm::vec3(-std::numeric_limits<float>::max()));
+				std::fill(m_clusterMax.begin(), m_clusterMax.end(), glm::vec3(std::numeric_limits<float>::max()));
+				return;
+			}
+
+			// the near and far planes and the off center terms, read back
+			// from the perspective matrix
+			float nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+			float farPlane = projection[3][2] / (projection[2][2] + 1.0f);
+			float depthRatio = std::log(farPlane / nearPlane);
+			m_sliceScale = CLUSTER_SLICES / depthRatio;
+			m_sliceBias = -CLUSTER_SLICES * std::log(nearPlane) / depthRatio;
+
+			for (int slice = 0; slice < CLUSTER_SLICES; slice++)
+			{
+				float depths[2] = {
+					nearPlane * std::pow(farPlane / nearPlane, static_cast<float>(slice) / CLUSTER_SLICES),
+					nearPlane * std::pow(farPlane / nearPlane, static_cast<float>(slice + 1) / CLUSTER_SLICES) };
+				for (int y = 0; y < CLUSTER_TILES_Y; y++)
+				{
+					for (int x = 0; x < CLUSTER_TILES_X; x++)
+					{
+						glm::vec3 low(std::numeric_limits<float>::max());
+						glm::vec3 high(-std::numeric_limits<float>::max());
+						for (int corner = 0; corner < 8; corner++)
+						{
+							float ndcX = -1.0f + 2.0f * (x + (corner & 1)) / CLUSTER_TILES_X;
+							float ndcY = -1.0f + 2.0f * (y + ((corner >> 1) & 1)) / CLUSTER_TILES_Y;
+							float depth = depths[corner >> 2];
+							glm::vec3 point((ndcX + projection[2][0]) * depth / projection[0][0],
+								(ndcY + projection[2][1]) * depth / projection[1][1], -depth);
+							low = glm::min(low, point);
+							high = glm::max(high, point);
+						}
+						int cluster = (slice * CLUSTER_TILES_Y + y) * CLUSTER_TILES_X + x;
+						m_clusterMin[cluster] = low;
+						m_clusterMax[cluster] = high;
+					}
+				}
+			}
+		}
 
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(8.0f, 3.3f, -3.6f);
+		// shares the slices out between this thread and the workers,
+		// starting the workers the first time
+		void BinLights()
+		{
+			if (m_bins.empty())
+			{
+				unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+				threads = std::min(threads, static_cast<unsigned int>(CLUSTER_SLICES));
+				m_bins.resize(threads);
+				for (unsigned int i = 0; i < threads; i++)
+				{
+					m_bins[i].firstSlice = CLUSTER_SLICES * i / threads;
+					m_bins[i].endSlice = CLUSTER_SLICES * (i + 1) / threads;
+				}
+				for (unsigned int i = 1; i < threads; i++)
+				{
+					m_workers.emplace_back(&ClusterLightGrid::BinWorker, this, i);
+				}
+			}
+			m_clusters.resize(CLUSTER_COUNT * 2);
+
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_pending = static_cast<int>(m_workers.size());
+				m_generation++;
+			}
+			m_wake.notify_all();
+			BinSlices(m_bins[0]);
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_done.wait(lock, [this]() { return(m_pending == 0); });
+		}
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+		void BinWorker(unsigned int bin)
+		{
+			unsigned int seen = 0;
+			for (;;)
+			{
+				{
+					std::unique_lock<std::mutex> lock(m_mutex);
+					m_wake.wait(lock, [&]() { return(m_bStop || (m_generation != seen)); });
+					if (m_bStop)
+					{
+						return;
+					}
+					seen = m_generation;
+				}
+				BinSlices(m_bins[bin]);
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					m_pending--;
+				}
+				m_done.notify_one();
+			}
+		}
 
-	SetShaderColor(0.3f, 0.95f, 1.0f, 1.0f);
+		// lists the lights reaching each cluster of a run of slices;
+		// the offsets are relative to the run until Upload() packs them
+		void BinSlices(CLUSTER_BIN& bin)
+		{
+			const int tiles = CLUSTER_TILES_X * CLUSTER_TILES_Y;
+			bin.indices.clear();
+			for (int slice = bin.firstSlice; slice < bin.endSlice; slice++)
+			{
+				// every cluster of a slice spans the same depths
+				int firstCluster = slice * tiles;
+				float sliceNear = -m_clusterMax[firstCluster].z;
+				float sliceFar = -m_clusterMin[firstCluster].z;
+				bin.candidates.clear();
+				for (size_t i = 0; i < m_lights.size(); i++)
+				{
+					float depth = -m_lights[i].z;
+					float range = m_lights[i].w;
+					if ((range == 0.0f) || ((depth + range >= sliceNear) && (depth - range <= sliceFar)))
+					{
+						bin.candidates.push_back(static_cast<int>(i));
+					}
+				}
+
+				for (int cluster = firstCluster; cluster < firstCluster + tiles; cluster++)
+				{
+					GLuint first = static_cast<GLuint>(bin.indices.size());
+					for (int i : bin.candidates)
+					{
+						// lights without a range reach every cluster
+						const glm::vec4& light = m_lights[i];
+						if (light.w > 0.0f)
+						{
+							glm::vec3 nearest = glm::clamp(glm::vec3(light), m_clusterMin[cluster], m_clusterMax[cluster]);
+							glm::vec3 offset = nearest - glm::vec3(light);
+							if (glm::dot(offset, offset) > light.w * light.w)
+							{
+								continue;
+							}
+						}
+						bin.indices.push_back(m_lightIndices[i]);
+					}
+					m_clusters[cluster * 2] = first;
+					m_clusters[cluster * 2 + 1] = static_cast<GLuint>(bin.indices.size()) - first;
+				}
+			}
+		}
 
+		// packs the header, the cluster pairs and every run's indices
+		// into the storage buffer the pool shader reads
+		void Upload()
+		{
+			const size_t header = 4;
+			size_t indexCount = 0;
+			for (const CLUSTER_BIN& bin : m_bins)
+			{
+				indexCount += bin.indices.size();
+			}
+			m_upload.resize(header + m_clusters.size() + indexCount);
+			memcpy(&m_upload[0], &m_sliceScale, sizeof(float));
+			memcpy(&m_upload[1], &m_sliceBias, sizeof(float));
+			m_upload[2] = m_upload[3] = 0;
+
+			GLuint* indices = &m_upload[header + m_clusters.size()];
+			GLuint base = 0;
+			for (const CLUSTER_BIN& bin : m_bins)
+			{
+				int first = bin.firstSlice * CLUSTER_TILES_X * CLUSTER_TILES_Y;
+				int end = bin.endSlice * CLUSTER_TILES_X * CLUSTER_TILES_Y;
+				for (int cluster = first; cluster < end; cluster++)
+				{
+					m_upload[header + cluster * 2] = m_clusters[cluster * 2] + base;
+					m_upload[header + cluster * 2 + 1] = m_clusters[cluster * 2 + 1];
+				}
+				std::copy(bin.indices.begin(), bin.indices.end(), indices + base);
+				base += static_cast<GLuint>(bin.indices.size());
+			}
+			m_lightReferences += indexCount;
+
+			if (m_buffer == 0)
+			{
+				glGenBuffers(1, &m_buffer);
+			}
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_buffer);
+			glBufferData(GL_SHADER_STORAGE_BUFFER, m_upload.size() * sizeof(GLuint), m_upload.data(), GL_STREAM_DRAW);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CLUSTER_LIGHT_BINDING, m_buffer);
+		}
 
+		GLuint m_buffer;
+		glm::mat4 m_view;
+		glm::mat4 m_projection;
+		unsigned int m_lightVersion;
+		bool m_bBuilt;
+		float m_sliceScale;
+		float m_sliceBias;
+		std::vector<glm::vec3> m_clusterMin;        // view space box of each cluster
+		std::vector<glm::vec3> m_clusterMax;
+		std::vector<glm::vec4> m_lights;            // view space center, range
+		std::vector<GLuint> m_lightIndices;         // light slot of each of m_lights
+		std::vector<GLuint> m_clusters;             // offset and count of each cluster
+		std::vector<GLuint> m_upload;
+		std::vector<CLUSTER_BIN> m_bins;            // the first is binned by the calling thread
+		std::vector<std::thread> m_workers;
+		std::mutex m_mutex;
+		std::condition_variable m_wake;
+		std::condition_variable m_done;
+		unsigned int m_generation;
+		int m_pending;
+		bool m_bStop;
+		unsigned long long m_rebuilds;
+		unsigned long long m_lightReferences;
+		double m_microseconds;
+	};
+	ClusterLightGrid g_lightClusters;
+
+	// geometry pool program - the lighting follows the scene shader,
+	// with the model matrix, color and material of each instance read
+	// from the object records and its texture from the texture array
+	const char* g_PoolVertexShader = R"(
+#version 430 core
+layout(location = 0) in vec3 inVertexPosition;
+layout(location = 1) in vec3 inVertexNormal;
+layout(location = 2) in vec2 inTextureCoordinate;
+layout(location = 3) in ivec4 inInstance;     // object record, face texture layers
+layout(location = 4) in int inVertexFace;
+layout(location = 5) in vec2 inLightmapCoordinate;
+
+struct ObjectRecord
+{
+	mat4 model;
+	vec4 color;
+	vec4 diffuseShininess;
+	vec4 specular;
+	vec4 lightmapRect;
+};
+
+layout(std430, binding = 0) readonly buffer ObjectRecords
+{
+	ObjectRecord records[];
+};
+
+out vec3 fragmentPosition;
+out vec3 fragmentVertexNormal;
+out vec2 fragmentTextureCoordinate;
+flat out vec4 fragmentColor;
+flat out vec4 fragmentDiffuseShininess;
+flat out vec3 fragmentSpecular;
+flat out int fragmentTextureLayer;
+out vec4 fragmentClipPosition;
+out vec2 fragmentLightmapCoordinate;
+flat out int fragmentLightmapped;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+	ObjectRecord record = records[inInstance.x];
+	vec4 worldPosition = record.model * vec4(inVertexPosition, 1.0);
+	fragmentPosition = worldPosition.xyz;
+	fragmentVertexNormal = mat3(transpose(inverse(record.model))) * inVertexNormal;
+	fragmentTextureCoordinate = inTextureCoordinate;
+	fragmentColor = record.color;
+	fragmentDiffuseShininess = record.diffuseShininess;
+	fragmentSpecular = record.specular.rgb;
+	fragmentLightmapCoordinate = record.lightmapRect.xy + inLightmapCoordinate * record.lightmapRect.zw;
+	fragmentLightmapped = (record.lightmapRect.z > 0.0) ? 1 : 0;
+
+	// two faces to an int, each layer stored plus one in 16 bits
+	int faceLayers = inInstance[1 + inVertexFace / 2];
+	fragmentTextureLayer = ((faceLayers >> (16 * (inVertexFace % 2))) & 0xFFFF) - 1;
+	gl_Position = projection * view * worldPosition;
+	fragmentClipPosition = gl_Position;
+}
+)";
 
+	const char* g_PoolFragmentShader = R"(
+#version 430 core
+#define TOTAL_POINT_LIGHTS 128
+#define CLUSTER_TILES_X 16
+#define CLUSTER_TILES_Y 9
+#define CLUSTER_SLICES 24
+#define SHADOW_LIGHTS 4
 
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh();
+struct PointLight
+{
+	vec4 position;      // w is 1 when the light is on
+	vec4 ambient;
+	vec4 diffuse;       // w is the distance it reaches, 0 for everywhere
+	vec4 specular;
+};
 
-	//SetShaderColor(1, 1, 1, 1);
+layout(std140, binding = 1) uniform SceneLights
+{
+	PointLight pointLights[TOTAL_POINT_LIGHTS];
+	int lightCount;
+};
 
-	//m_basicMeshes->DrawBoxMeshLines();
+// the lights reaching each cluster of the view frustum
+layout(std430, binding = 2) readonly buffer ClusterLights
+{
+	vec4 clusterDepth;      // log depth to slice scale and bias
+	uvec2 clusters[CLUSTER_TILES_X * CLUSTER_TILES_Y * CLUSTER_SLICES];   // first index, count
+	uint lightIndices[];
+};
+
+in vec3 fragmentPosition;
+in vec3 fragmentVertexNormal;
+in vec2 fragmentTextureCoordinate;
+flat in vec4 fragmentColor;
+flat in vec4 fragmentDiffuseShininess;
+flat in vec3 fragmentSpecular;
+flat in int fragmentTextureLayer;
+in vec4 fragmentClipPosition;
+in vec2 fragmentLightmapCoordinate;
+flat in int fragmentLightmapped;
+
+out vec4 outFragmentColor;
+
+uniform bool bUseLighting;
+uniform sampler2DArray objectTextures;
+uniform vec2 UVscale;
+uniform vec3 viewPosition;
+layout(binding = 17) uniform sampler2D lightmap;
+
+// the depth cube maps of the first lights - the static casters alone,
+// and with the dynamic casters drawn in
+layout(binding = 18) uniform samplerCubeArrayShadow staticShadowMaps;
+layout(binding = 19) uniform samplerCubeArrayShadow shadowMaps;
+uniform vec4 shadowLights[SHADOW_LIGHTS];  // near and far plane, z is 1 when it casts
+
+// lights with a range fade out smoothly before reaching it
+float Attenuation(PointLight light)
+{
+	if (light.diffuse.w <= 0.0)
+	{
+		return(1.0);
+	}
+	float distance = length(light.position.xyz - fragmentPosition);
+	float window = clamp(1.0 - pow(distance / light.diffuse.w, 4.0), 0.0, 1.0);
+	return(window * window / (1.0 + distance * distance));
+}
 
-//--------------------------------------------------------------------------
+// how much of a light reaches the fragment past the casters in maps
+float ShadowVisibility(samplerCubeArrayShadow maps, int light, vec3 normal)
+{
+	if ((light >= SHADOW_LIGHTS) || (shadowLights[light].z == 0.0))
+	{
+		return(1.0);
+	}
 
+	// pushed off the surface a little so it does not shadow itself
+	vec3 toFragment = fragmentPosition + normal * 0.02 - pointLights[light].position.xyz;
+	float nearPlane = shadowLights[light].x;
+	float farPlane = shadowLights[light].y;
+	float axis = max(abs(toFragment.x), max(abs(toFragment.y), abs(toFragment.z)));
+	if (axis >= farPlane)
+	{
+		return(1.0);
+	}
+	float depth = (farPlane + nearPlane) / (farPlane - nearPlane) - (2.0 * farPlane * nearPlane) / ((farPlane - nearPlane) * axis);
+	return(texture(maps, vec4(toFragment, float(light)), depth * 0.5 + 0.5));
+}
 
-	scaleXYZ = glm::vec3(1.2f, 0.2f, 1.2f);
+vec3 CalcDiffuseLight(PointLight light, vec3 normal, vec3 baseColor)
+{
+	float diffuseImpact = max(dot(normal, normalize(light.position.xyz - fragmentPosition)), 0.0);
+	return(light.diffuse.rgb * diffuseImpact * fragmentDiffuseShininess.rgb * baseColor * Attenuation(light));
+}
 
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 90.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+vec3 CalcPointLight(PointLight light, float visibility, vec3 normal, vec3 viewDirection, vec3 baseColor)
+{
+	vec3 lightDirection = normalize(light.position.xyz - fragmentPosition);
+	float diffuseImpact = max(dot(normal, lightDirection), 0.0);
+	vec3 reflectDirection = reflect(-lightDirection, normal);
+	float specularImpact = pow(max(dot(viewDirection, reflectDirection), 0.0), fragmentDiffuseShininess.w);
+
+	vec3 ambient = light.ambient.rgb * baseColor;
+	vec3 diffuse = light.diffuse.rgb * diffuseImpact * fragmentDiffuseShininess.rgb * baseColor;
+	vec3 specular = light.specular.rgb * specularImpact * fragmentSpecular;
+	return((ambient + (diffuse + specular) * visibility) * Attenuation(light));
+}
 
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(8.0f, 9.7f, -3.6f);
+void main()
+{
+	vec4 baseColor = fragmentColor;
+	if (fragmentTextureLayer >= 0)
+	{
+		baseColor = texture(objectTextures, vec3(fragmentTextureCoordinate * UVscale, fragmentTextureLayer));
+	}
+	if (!bUseLighting)
+	{
+		outFragmentColor = baseColor;
+		return;
+	}
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+	vec3 normal = normalize(fragmentVertexNormal);
 
-	SetShaderColor(0.3f, 0.95f, 1.0f, 1.0f);
+	// static objects were lit once by the baker, static shadows
+	// included; only the light the dynamic casters block is taken away
+	if (fragmentLightmapped != 0)
+	{
+		vec3 lit = baseColor.rgb * texture(lightmap, fragmentLightmapCoordinate).rgb;
+		for (int i = 0; i < min(lightCount, SHADOW_LIGHTS); i++)
+		{
+			float blocked = ShadowVisibility(staticShadowMaps, i, normal) - ShadowVisibility(shadowMaps, i, normal);
+			if (blocked > 0.0)
+			{
+				lit -= CalcDiffuseLight(pointLights[i], normal, baseColor.rgb) * blocked;
+			}
+		}
+		outFragmentColor = vec4(max(lit, vec3(0.0)), baseColor.a);
+		return;
+	}
 
+	vec3 viewDirection = normalize(viewPosition - fragmentPosition);
+	vec3 lighting = vec3(0.0);
 
+	// only the lights binned into this fragment's cluster
+	vec2 screen = (fragmentClipPosition.xy / fragmentClipPosition.w) * 0.5 + 0.5;
+	ivec2 tile = clamp(ivec2(screen * vec2(CLUSTER_TILES_X, CLUSTER_TILES_Y)), ivec2(0), ivec2(CLUSTER_TILES_X - 1, CLUSTER_TILES_Y - 1));
+	int slice = clamp(int(log(fragmentClipPosition.w) * clusterDepth.x + clusterDepth.y), 0, CLUSTER_SLICES - 1);
+	uvec2 cluster = clusters[(slice * CLUSTER_TILES_Y + tile.y) * CLUSTER_TILES_X + tile.x];
+	for (uint i = 0u; i < cluster.y; i++)
+	{
+		int light = int(lightIndices[cluster.x + i]);
+		lighting += CalcPointLight(pointLights[light], ShadowVisibility(shadowMaps, light, normal), normal, viewDirection, baseColor.rgb);
+	}
+	outFragmentColor = vec4(lighting, baseColor.a);
+}
+)";
 
+	// per instance data in the object record buffer (std430)
+	struct OBJECT_RECORD
+	{
+		glm::mat4 model;
+		glm::vec4 color;
+		glm::vec4 diffuseShininess;
+		glm::vec4 specular;
+		glm::vec4 lightmapRect;     // offset and size of its lightmap tile, no size for none
+	};
+
+	// the layout glMultiDrawElementsIndirect() reads commands in
+	struct DRAW_COMMAND
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	// what each instance of a draw command reads - the per instance
+	// attribute steps through these from the command's base instance
+	struct INSTANCE_ENTRY
+	{
+		GLint record;
+		GLint faceLayers[MESH_FACE_COUNT / 2];  // see PackFaceLayers()
+	};
 
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh();
+	// opaque objects sharing a mesh, parts, textures, material and
+	// layer, drawn as instances of one command per part
+	struct INSTANCE_GROUP
+	{
+		SCENE_MESH mesh;
+		int materialHandle;
+		int layer;
+		int firstDraw;              // the draws of the first member
+		int drawCount;
+		std::vector<int> objects;
+		int baseInstance;           // first object record of the group
+		bool bDynamic;
+	};
+
+	// one part of every member of a group, before it is sorted
+	// into a draw command
+	struct INSTANCE_DRAW
+	{
+		int group;
+		SCENE_PART part;
+		int faceTextures[MESH_FACE_COUNT];
+	};
+
+	// uniforms of the pool program copied from the scene program
+	// every frame, such as the camera and the lights
+	struct SHARED_UNIFORM
+	{
+		GLenum type;
+		int source;                 // handle in the scene uniform cache
+		int handle;                 // handle in the pool uniform cache
+	};
+
+	// every basic mesh in one vertex and one index buffer
+	GLuint g_poolProgram = 0;
+	GLuint g_poolVao = 0;
+	GLuint g_poolVertexBuffer = 0;
+	GLuint g_poolIndexBuffer = 0;
+	GLuint g_instanceTableBuffer = 0;
+	GLuint g_recordBuffer = 0;
+	GLuint g_commandBuffer = 0;
+	MESH_GEOMETRY g_meshGeometry[SCENE_MESH_COUNT];
+	UniformCache g_poolUniforms;
+	std::vector<SHARED_UNIFORM> g_sharedUniforms;
+	GLuint g_sharedUniformSource = 0;
+	std::vector<INSTANCE_GROUP> g_instanceGroups;
+	std::vector<INSTANCE_DRAW> g_instanceDraws;
+	std::vector<OBJECT_RECORD> g_objectRecords;
+	std::vector<DRAW_COMMAND> g_drawCommands;
+	std::vector<INSTANCE_ENTRY> g_instanceTable;
+	std::vector<int> g_instanceTextures;    // the layers each entry shows once resident, by face
+	std::vector<int> g_instanceObjects;     // the scene object of each entry
+
+	// the commands and instance table entries of the objects that
+	// passed the frustum test, rebuilt when the visibility changes
+	std::vector<DRAW_COMMAND> g_visibleCommands;
+	std::vector<INSTANCE_ENTRY> g_visibleTable;
+	bool g_bInstanceTableDirty = true;
+
+	/***********************************************************
+	 *  CompileShaderStage()
+	 *
+	 *  This function is used for compiling one stage of one of
+	 *  the programs built here, logging the errors if it fails.
+	 ***********************************************************/
+	GLuint CompileShaderStage(GLenum stage, const char* source, const char* name)
+	{
+		GLuint shader = glCreateShader(stage);
+		glShaderSource(shader, 1, &source, NULL);
+		glCompileShader(shader);
 
-	//SetShaderColor(1, 1, 1, 1);
+		GLint bCompiled = GL_FALSE;
+		glGetShaderiv(shader, GL_COMPILE_STATUS, &bCompiled);
+		if (bCompiled != GL_TRUE)
+		{
+			char infoLog[1024] = { 0 };
+			glGetShaderInfoLog(shader, sizeof(infoLog), NULL, infoLog);
+			std::cerr << "[SceneManager] ERROR: Failed to compile " << name << " shader: " << infoLog << std::endl;
+			glDeleteShader(shader);
+			return(0);
+		}
+		return(shader);
+	}
 
-	//m_basicMeshes->DrawBoxMeshLines();
+	/***********************************************************
+	 *  LinkShaderProgram()
+	 *
+	 *  This function is used for compiling and linking a vertex
+	 *  and fragment shader pair, optionally capturing one vertex
+	 *  output with transform feedback. Returns 0, after logging
+	 *  the errors, if either step fails.
+	 ***********************************************************/
+	GLuint LinkShaderProgram(const char* vertexSource, const char* fragmentSource, const char* name,
+		const char* feedbackVarying = NULL)
+	{
+		GLuint vertexShader = CompileShaderStage(GL_VERTEX_SHADER, vertexSource, name);
+		GLuint fragmentShader = CompileShaderStage(GL_FRAGMENT_SHADER, fragmentSource, name);
+		if ((vertexShader == 0) || (fragmentShader == 0))
+		{
+			glDeleteShader(vertexShader);
+			glDeleteShader(fragmentShader);
+			return(0);
+		}
 
+		GLuint program = glCreateProgram();
+		glAttachShader(program, vertexShader);
+		glAttachShader(program, fragmentShader);
+		if (feedbackVarying != NULL)
+		{
+			glTransformFeedbackVaryings(program, 1, &feedbackVarying, GL_INTERLEAVED_ATTRIBS);
+		}
+		glLinkProgram(program);
+		glDeleteShader(vertexShader);
+		glDeleteShader(fragmentShader);
 
+		GLint bLinked = GL_FALSE;
+		glGetProgramiv(program, GL_LINK_STATUS, &bLinked);
+		if (bLinked != GL_TRUE)
+		{
+			char infoLog[1024] = { 0 };
+			glGetProgramInfoLog(program, sizeof(infoLog), NULL, infoLog);
+			std::cerr << "[SceneManager] ERROR: Failed to link " << name << " program: " << infoLog << std::endl;
+			glDeleteProgram(program);
+			return(0);
+		}
+		return(program);
+	}
 
-	//-----------------------------------------------------------------------------------------------------GPU
+	// shadow caster program - the pool's vertices placed by the object
+	// records, drawn into one face of a light's cube map with depth only
+	const char* g_ShadowVertexShader = R"(
+#version 430 core
+layout(location = 0) in vec3 inVertexPosition;
+layout(location = 3) in int inRecord;
 
+struct ObjectRecord
+{
+	mat4 model;
+	vec4 color;
+	vec4 diffuseShininess;
+	vec4 specular;
+	vec4 lightmapRect;
+};
+
+layout(std430, binding = 0) readonly buffer ObjectRecords
+{
+	ObjectRecord records[];
+};
 
-	scaleXYZ = glm::vec3(11.0f, 1.5f, 7.0f);
+uniform mat4 lightViewProjection;
 
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+void main()
+{
+	gl_Position = lightViewProjection * records[inRecord].model * vec4(inVertexPosition, 1.0);
+}
+)";
 
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-2.0f, 5.0f, 0.0f);
+	const char* g_ShadowFragmentShader = R"(
+#version 430 core
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+void main()
+{
+}
+)";
+
+	// the lights SetupSceneLights() places cast shadows - SHADOW_LIGHTS
+	// in the pool shader - each into a depth cube map
+	const int SHADOW_LIGHT_COUNT = SCENE_PROGRAM_LIGHTS;
+	const GLsizei SHADOW_MAP_SIZE = 512;
+	const float SHADOW_NEAR_PLANE = 0.05f;
+	const int g_StaticShadowUnit = 18;      // the bindings in the pool shader
+	const int g_ShadowMapUnit = 19;
+
+	/***********************************************************
+	 *  ShadowMapCache
+	 *
+	 *  Keeps two cube maps per shadowed light. The static one
+	 *  holds the depth of the static casters only and is drawn
+	 *  again only when its light moves, changes range or comes
+	 *  on, or the static casters are rebuilt. The other is the
+	 *  one the pool shader shadows with: a copy of the static
+	 *  map with the dynamic casters drawn over it, redone only
+	 *  when a dynamic caster that reaches the light has moved.
+	 *  The casters are the pooled opaque objects, drawn with
+	 *  two indirect multi-draws per cube face.
+	 ***********************************************************/
+	class ShadowMapCache
+	{
+	public:
+		ShadowMapCache() : m_program(0), m_vao(0), m_instanceBuffer(0), m_commandBuffer(0),
+			m_staticMaps(0), m_maps(0), m_framebuffer(0), m_viewProjection(-1),
+			m_staticCommands(0), m_dynamicCommands(0), m_staticVersion(0),
+			m_staticRenders(0), m_composites(0), m_frames(0)
+		{
+			for (int i = 0; i < SHADOW_LIGHT_COUNT; i++)
+			{
+				m_lights[i].bActive = false;
+				m_lights[i].staticVersion = 0;
+				m_lights[i].farPlane = 0.0f;
+				m_handles[i] = -1;
+			}
+		}
 
-	SetShaderColor(0.1, 0.1, 0.12, 1);
-	
-	SetShaderTexture("gputop");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::top);
-	SetShaderTexture("black");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::bottom);
-	SetShaderTexture("black");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::left);
-	SetShaderTexture("gpuside");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::right);
-	SetShaderTexture("gpufront");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::front);
-	SetShaderTexture("black");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::back);
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
+		// builds the program, the two cube map arrays and the vertex
+		// array that reads the pool's vertices; without them no light
+		// casts a shadow
+		void Create()
+		{
+			m_program = LinkShaderProgram(g_ShadowVertexShader, g_ShadowFragmentShader, "shadow caster");
+			if (m_program == 0)
+			{
+				return;
+			}
+			m_viewProjection = glGetUniformLocation(m_program, "lightViewProjection");
+
+			glGenVertexArrays(1, &m_vao);
+			glGenBuffers(1, &m_instanceBuffer);
+			glGenBuffers(1, &m_commandBuffer);
+			glBindVertexArray(m_vao);
+			glBindBuffer(GL_ARRAY_BUFFER, g_poolVertexBuffer);
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(MESH_VERTEX), (void*)offsetof(MESH_VERTEX, position));
+			glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+			glEnableVertexAttribArray(3);
+			glVertexAttribIPointer(3, 1, GL_INT, sizeof(GLint), (void*)0);
+			glVertexAttribDivisor(3, 1);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_poolIndexBuffer);
+			glBindVertexArray(0);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+			GLuint* maps[2] = { &m_staticMaps, &m_maps };
+			const int units[2] = { g_StaticShadowUnit, g_ShadowMapUnit };
+			for (int i = 0; i < 2; i++)
+			{
+				glGenTextures(1, maps[i]);
+				glActiveTexture(GL_TEXTURE0 + units[i]);
+				glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, *maps[i]);
+				glTexStorage3D(GL_TEXTURE_CUBE_MAP_ARRAY, 1, GL_DEPTH_COMPONENT32F, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE,
+					SHADOW_LIGHT_COUNT * 6);
+				glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+				glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+				glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+				glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+			}
+			glActiveTexture(GL_TEXTURE0);
+
+			glGenFramebuffers(1, &m_framebuffer);
+			glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+			glDrawBuffer(GL_NONE);
+			glReadBuffer(GL_NONE);
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		}
 
+		// splits the pool's draw commands into those of the static
+		// and of the dynamic casters, and has every light drawn again.
+		// Runs after BuildGeometryPoolDraws().
+		void BuildCasters()
+		{
+			if (m_program == 0)
+			{
+				return;
+			}
+			std::vector<DRAW_COMMAND> commands[2];
+			std::vector<GLint> records[2];
+			m_dynamicObjects.clear();
+			for (const DRAW_COMMAND& command : g_drawCommands)
+			{
+				DRAW_COMMAND split[2] = { command, command };
+				for (int kind = 0; kind < 2; kind++)
+				{
+					split[kind].baseInstance = static_cast<GLuint>(records[kind].size());
+				}
+				for (GLuint i = command.baseInstance; i < command.baseInstance + command.instanceCount; i++)
+				{
+					int object = g_instanceObjects[i];
+					int kind = g_sceneObjects[object].bDynamic ? 1 : 0;
+					records[kind].push_back(g_instanceTable[i].record);
+					if ((kind == 1) && (std::find(m_dynamicObjects.begin(), m_dynamicObjects.end(), object) == m_dynamicObjects.end()))
+					{
+						m_dynamicObjects.push_back(object);
+					}
+				}
+				for (int kind = 0; kind < 2; kind++)
+				{
+					split[kind].instanceCount = static_cast<GLuint>(records[kind].size()) - split[kind].baseInstance;
+					if (split[kind].instanceCount > 0)
+					{
+						commands[kind].push_back(split[kind]);
+					}
+				}
+			}
+
+			// the dynamic casters follow the static ones in both buffers
+			for (DRAW_COMMAND& command : commands[1])
+			{
+				command.baseInstance += static_cast<GLuint>(records[0].size());
+			}
+			m_staticCommands = static_cast<GLsizei>(commands[0].size());
+			m_dynamicCommands = static_cast<GLsizei>(commands[1].size());
+			commands[0].insert(commands[0].end(), commands[1].begin(), commands[1].end());
+			records[0].insert(records[0].end(), records[1].begin(), records[1].end());
+			glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+			glBufferData(GL_ARRAY_BUFFER, records[0].size() * sizeof(GLint), records[0].data(), GL_STATIC_DRAW);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+			glBufferData(GL_DRAW_INDIRECT_BUFFER, commands[0].size() * sizeof(DRAW_COMMAND), commands[0].data(), GL_STATIC_DRAW);
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+			m_dynamicMatrices.assign(m_dynamicObjects.size(), glm::mat4(0.0f));
+			m_dynamicReach.assign(m_dynamicObjects.size(), 0u);
+			m_staticVersion++;
+		}
 
-	//SetShaderColor(1, 1, 1, 1);
+		// brings the maps up to date for this frame; the dynamic records
+		// must already hold this frame's matrices
+		void Update()
+		{
+			if ((m_program == 0) || (m_staticCommands + m_dynamicCommands == 0))
+			{
+				return;
+			}
+			m_frames++;
+
+			// a light whose static map no longer matches it is drawn again
+			uint32_t staleStatic = 0;
+			for (int i = 0; i < SHADOW_LIGHT_COUNT; i++)
+			{
+				const SCENE_LIGHT& light = g_sceneLights.Light(i);
+				SHADOW_LIGHT& shadow = m_lights[i];
+				if ((i >= g_sceneLights.Count()) || (light.position.w == 0.0f))
+				{
+					shadow.bActive = false;
+					continue;
+				}
+				if (!shadow.bActive || (shadow.position != glm::vec3(light.position)) ||
+					(shadow.range != light.diffuse.w) || (shadow.staticVersion != m_staticVersion))
+				{
+					shadow.bActive = true;
+					shadow.position = glm::vec3(light.position);
+					shadow.range = light.diffuse.w;
+					shadow.staticVersion = m_staticVersion;
+					shadow.farPlane = FarPlane(shadow);
+					staleStatic |= (1u << i);
+				}
+			}
+
+			// a dynamic caster that moved spoils the maps of the lights
+			// it reaches now and of those it reached before
+			uint32_t staleComposite = staleStatic;
+			for (size_t i = 0; i < m_dynamicObjects.size(); i++)
+			{
+				int object = m_dynamicObjects[i];
+				uint32_t reach = LightsReached(object);
+				if (g_worldMatrices[object] != m_dynamicMatrices[i])
+				{
+					staleComposite |= reach | m_dynamicReach[i];
+					m_dynamicMatrices[i] = g_worldMatrices[object];
+				}
+				m_dynamicReach[i] = reach;
+			}
+			if (staleComposite == 0)
+			{
+				return;
+			}
+
+			GLint framebuffer = 0;
+			GLint viewport[4] = { 0, 0, 0, 0 };
+			glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+			glGetIntegerv(GL_VIEWPORT, viewport);
+			glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+			glViewport(0, 0, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE);
+			glUseProgram(m_program);
+			glBindVertexArray(m_vao);
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, g_recordBuffer);
+			g_renderStates.SetDepthMask(true);
+			glEnable(GL_POLYGON_OFFSET_FILL);
+			glPolygonOffset(2.0f, 4.0f);
+
+			for (int i = 0; i < SHADOW_LIGHT_COUNT; i++)
+			{
+				if ((staleStatic & (1u << i)) != 0)
+				{
+					DrawCasters(i, m_staticMaps, 0, m_staticCommands, true);
+					m_staticRenders++;
+				}
+				if ((staleComposite & (1u << i)) != 0)
+				{
+					glCopyImageSubData(m_staticMaps, GL_TEXTURE_CUBE_MAP_ARRAY, 0, 0, 0, i * 6,
+						m_maps, GL_TEXTURE_CUBE_MAP_ARRAY, 0, 0, 0, i * 6, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, 6);
+					if (m_dynamicCommands > 0)
+					{
+						DrawCasters(i, m_maps, m_staticCommands, m_dynamicCommands, false);
+					}
+					m_composites++;
+				}
+			}
+
+			glDisable(GL_POLYGON_OFFSET_FILL);
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+			glBindVertexArray(0);
+			glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(framebuffer));
+			glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+			glUseProgram(g_uniformCache.Program());
+		}
 
-	//m_basicMeshes->DrawBoxMeshLines();
+		// sets the near and far planes of the lights that cast, in the
+		// program the cache is attached to
+		void Apply(UniformCache& cache)
+		{
+			if (m_program == 0)
+			{
+				return;
+			}
+			for (int i = 0; i < SHADOW_LIGHT_COUNT; i++)
+			{
+				if (m_handles[i] < 0)
+				{
+					m_handles[i] = cache.Resolve(("shadowLights[" + std::to_string(i) + "]").c_str());
+				}
+				const SHADOW_LIGHT& shadow = m_lights[i];
+				cache.SetVec4(m_handles[i], shadow.bActive ?
+					glm::vec4(SHADOW_NEAR_PLANE, shadow.farPlane, 1.0f, 0.0f) : glm::vec4(0.0f));
+			}
+		}
 
+		void Destroy()
+		{
+			if (m_program == 0)
+			{
+				return;
+			}
+			glDeleteFramebuffers(1, &m_framebuffer);
+			glDeleteTextures(1, &m_staticMaps);
+			glDeleteTextures(1, &m_maps);
+			glDeleteVertexArrays(1, &m_vao);
+			glDeleteBuffers(1, &m_instanceBuffer);
+			glDeleteBuffers(1, &m_commandBuffer);
+			glDeleteProgram(m_program);
+			m_program = 0;
+		}
 
-	
+		void Report() const
+		{
+			std::cout << "[SceneManager] Shadow maps: " << m_staticRenders << " static render(s) and "
+				<< m_composites << " composite(s) of " << SHADOW_LIGHT_COUNT << " light(s) over "
+				<< m_frames << " frame(s), " << m_dynamicObjects.size() << " dynamic caster(s)" << std::endl;
+		}
 
-	
+	private:
+		struct SHADOW_LIGHT
+		{
+			bool bActive;
+			glm::vec3 position;
+			float range;
+			float farPlane;
+			unsigned int staticVersion;     // of the casters its static map shows
+		};
 
-	//----------------------------------------------------------------------------------------------------Motherboard components 
-	
-	
-	//--------------------------------------------------------------CPU Cooler
+		// a light with a range reaches no further; one without reaches
+		// the far corner of the scene
+		float FarPlane(const SHADOW_LIGHT& shadow) const
+		{
+			if (shadow.range > 0.0f)
+			{
+				return(shadow.range);
+			}
+			float farthest = SHADOW_NEAR_PLANE * 2.0f;
+			for (size_t i = 0; i < g_sceneObjects.size(); i++)
+			{
+				glm::vec3 center(g_boundsCenter[0][i], g_boundsCenter[1][i], g_boundsCenter[2][i]);
+				glm::vec3 extent(g_boundsExtent[0][i], g_boundsExtent[1][i], g_boundsExtent[2][i]);
+				farthest = std::max(farthest, glm::length(glm::abs(center - shadow.position) + extent));
+			}
+			return(farthest);
+		}
 
-	scaleXYZ = glm::vec3(1.0f, 0.5f, 1.0f);
+		// a bit per light whose far plane the object's box comes inside
+		uint32_t LightsReached(int object) const
+		{
+			glm::vec3 center(g_boundsCenter[0][object], g_boundsCenter[1][object], g_boundsCenter[2][object]);
+			glm::vec3 extent(g_boundsExtent[0][object], g_boundsExtent[1][object], g_boundsExtent[2][object]);
+			uint32_t reach = 0;
+			for (int i = 0; i < SHADOW_LIGHT_COUNT; i++)
+			{
+				const SHADOW_LIGHT& shadow = m_lights[i];
+				glm::vec3 outside = glm::max(glm::abs(center - shadow.position) - extent, glm::vec3(0.0f));
+				if (shadow.bActive && (glm::dot(outside, outside) < shadow.farPlane * shadow.farPlane))
+				{
+					reach |= (1u << i);
+				}
+			}
+			return(reach);
+		}
 
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 90.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 90.0f;
+		// draws a range of the caster commands into the six faces of a
+		// light's cube map, clearing each face first when asked
+		void DrawCasters(int light, GLuint maps, GLsizei firstCommand, GLsizei commandCount, bool bClear)
+		{
+			static const glm::vec3 directions[6] = {
+				glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f),
+				glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f) };
+			static const glm::vec3 ups[6] = {
+				glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f),
+				glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f) };
+
+			const SHADOW_LIGHT& shadow = m_lights[light];
+			glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, SHADOW_NEAR_PLANE, shadow.farPlane);
+			for (int face = 0; face < 6; face++)
+			{
+				glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, maps, 0, light * 6 + face);
+				if (bClear)
+				{
+					glClear(GL_DEPTH_BUFFER_BIT);
+				}
+				if (commandCount == 0)
+				{
+					continue;
+				}
+				glm::mat4 viewProjection = projection * glm::lookAt(shadow.position, shadow.position + directions[face], ups[face]);
+				glUniformMatrix4fv(m_viewProjection, 1, GL_FALSE, glm::value_ptr(viewProjection));
+				glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(firstCommand * sizeof(DRAW_COMMAND)),
+					commandCount, 0);
+			}
+		}
 
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-2.3f, 8.8f, -1.4f);
+		GLuint m_program;
+		GLuint m_vao;
+		GLuint m_instanceBuffer;        // the record of each caster instance
+		GLuint m_commandBuffer;         // the static commands, then the dynamic
+		GLuint m_staticMaps;
+		GLuint m_maps;
+		GLuint m_framebuffer;
+		GLint m_viewProjection;
+		GLsizei m_staticCommands;
+		GLsizei m_dynamicCommands;
+		unsigned int m_staticVersion;
+		SHADOW_LIGHT m_lights[SHADOW_LIGHT_COUNT];
+		int m_handles[SHADOW_LIGHT_COUNT];
+		std::vector<int> m_dynamicObjects;
+		std::vector<glm::mat4> m_dynamicMatrices;  // as last drawn into the maps
+		std::vector<uint32_t> m_dynamicReach;      // the lights each reached then
+		unsigned long long m_staticRenders;
+		unsigned long long m_composites;
+		unsigned long long m_frames;
+	};
+	ShadowMapCache g_shadowMaps;
+
+	// mesh capture program - passes the ShapeMeshes positions
+	// straight through to a transform feedback buffer
+	const char* g_CaptureVertexShader = R"(
+#version 430 core
+layout(location = 0) in vec3 inVertexPosition;
+
+out vec3 capturedPosition;
+
+void main()
+{
+	capturedPosition = inVertexPosition;
+	gl_Position = vec4(inVertexPosition, 1.0);
+}
+)";
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+	const char* g_CaptureFragmentShader = R"(
+#version 430 core
 
-	SetShaderColor(0.2f, 0.2f, 0.2f, 1.0f);
-	SetShaderTexture("cpucooler");
-	m_basicMeshes->DrawCylinderMesh(true, false, false);
+void main()
+{
+}
+)";
+
+	/***********************************************************
+	 *  VerifyMeshGeometry()
+	 *
+	 *  This function is used for checking every generated mesh
+	 *  against the ShapeMeshes mesh it stands in for. Each
+	 *  ShapeMeshes mesh is drawn once with the rasterizer off
+	 *  and its triangles captured with transform feedback; the
+	 *  triangle count and the bounds must match the generated
+	 *  copy. A mesh that differs is logged and kept out of the
+	 *  geometry pool, and so out of the shadow maps and the
+	 *  lightmap. If nothing can be captured the copies are used.
+	 ***********************************************************/
+	void VerifyMeshGeometry(ShapeMeshes* meshes)
+	{
+		static const char* meshNames[SCENE_MESH_COUNT] = { "plane", "box", "cylinder", "torus", "prism", "pyramid4" };
+		std::fill(g_bMeshMatches, g_bMeshMatches + SCENE_MESH_COUNT, true);
 
-	// draw the mesh with transformation values
-	SetShaderTexture("black");
-	m_basicMeshes->DrawCylinderMesh(false, false, true);
+		GLuint program = LinkShaderProgram(g_CaptureVertexShader, g_CaptureFragmentShader, "mesh capture", "capturedPosition");
+		if (program == 0)
+		{
+			return;
+		}
 
+		// the copies, with room to spare for a larger ShapeMeshes mesh
+		MeshBuilder builders[SCENE_MESH_COUNT];
+		MESH_GEOMETRY geometry;
+		size_t capacity = 0;
+		for (int mesh = 0; mesh < SCENE_MESH_COUNT; mesh++)
+		{
+			BuildMeshGeometry(static_cast<SCENE_MESH>(mesh), builders[mesh], geometry);
+			capacity = std::max(capacity, 4 * (builders[mesh].indices.size() / 3));
+		}
 
+		GLint previousProgram = 0;
+		glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+		GLuint feedbackBuffer = 0;
+		GLuint query = 0;
+		glGenBuffers(1, &feedbackBuffer);
+		glGenQueries(1, &query);
+		glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, feedbackBuffer);
+		glBufferData(GL_TRANSFORM_FEEDBACK_BUFFER, capacity * 3 * sizeof(glm::vec3), NULL, GL_STREAM_READ);
+		glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, feedbackBuffer);
+		glUseProgram(program);
+		glEnable(GL_RASTERIZER_DISCARD);
+
+		int captured = 0;
+		int mismatches = 0;
+		for (int mesh = 0; mesh < SCENE_MESH_COUNT; mesh++)
+		{
+			glBeginQuery(GL_PRIMITIVES_GENERATED, query);
+			glBeginTransformFeedback(GL_TRIANGLES);
+			DrawScenePart(meshes, static_cast<SCENE_MESH>(mesh), PART_FULL);
+			glEndTransformFeedback();
+			glEndQuery(GL_PRIMITIVES_GENERATED);
+
+			GLuint triangles = 0;
+			glGetQueryObjectuiv(query, GL_QUERY_RESULT, &triangles);
+			if (triangles == 0)
+			{
+				continue;
+			}
+			captured++;
+
+			const MeshBuilder& builder = builders[mesh];
+			glm::vec3 copyMin = builder.vertices[0].position;
+			glm::vec3 copyMax = copyMin;
+			for (const MESH_VERTEX& vertex : builder.vertices)
+			{
+				copyMin = glm::min(copyMin, vertex.position);
+				copyMax = glm::max(copyMax, vertex.position);
+			}
+
+			// only the triangles that fitted were written out
+			size_t written = std::min(static_cast<size_t>(triangles), capacity);
+			glm::vec3 shapeMin = copyMin;
+			glm::vec3 shapeMax = copyMax;
+			const glm::vec3* positions = static_cast<const glm::vec3*>(glMapBufferRange(GL_TRANSFORM_FEEDBACK_BUFFER,
+				0, written * 3 * sizeof(glm::vec3), GL_MAP_READ_BIT));
+			if (positions != NULL)
+			{
+				shapeMin = shapeMax = positions[0];
+				for (size_t i = 1; i < written * 3; i++)
+				{
+					shapeMin = glm::min(shapeMin, positions[i]);
+					shapeMax = glm::max(shapeMax, positions[i]);
+				}
+				glUnmapBuffer(GL_TRANSFORM_FEEDBACK_BUFFER);
+			}
+			if (written < triangles)
+			{
+				shapeMin = glm::min(shapeMin, copyMin);
+				shapeMax = glm::max(shapeMax, copyMax);
+			}
+
+			const float tolerance = 0.001f;
+			bool bSameBounds = true;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				bSameBounds = bSameBounds && (fabsf(shapeMin[axis] - copyMin[axis]) <= tolerance) &&
+					(fabsf(shapeMax[axis] - copyMax[axis]) <= tolerance);
+			}
+			if ((triangles == builder.indices.size() / 3) && bSameBounds)
+			{
+				continue;
+			}
+
+			std::cerr << "[SceneManager] ERROR: Generated " << meshNames[mesh] << " mesh does not match ShapeMeshes ("
+				<< builder.indices.size() / 3 << " triangle(s) against " << triangles
+				<< (bSameBounds ? ")" : ", different bounds)") << "; drawing it through ShapeMeshes only" << std::endl;
+			g_bMeshMatches[mesh] = false;
+			g_meshBoundsMin[mesh] = shapeMin;
+			g_meshBoundsMax[mesh] = shapeMax;
+			mismatches++;
+		}
 
-	//-----------------------------------------------------------------------------Ram
+		glDisable(GL_RASTERIZER_DISCARD);
+		glUseProgram(static_cast<GLuint>(previousProgram));
+		glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+		glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, 0);
+		glDeleteQueries(1, &query);
+		glDeleteBuffers(1, &feedbackBuffer);
+		glDeleteProgram(program);
+		if (captured == 0)
+		{
+			std::cout << "[SceneManager] Could not capture the ShapeMeshes meshes; using the generated copies" << std::endl;
+		}
+		else if (mismatches == 0)
+		{
+			std::cout << "[SceneManager] Generated meshes match ShapeMeshes (" << captured << " checked)" << std::endl;
+		}
+	}
 
+	/***********************************************************
+	 *  CreateGeometryPool()
+	 *
+	 *  This function is used for building the pool program and
+	 *  packing every generated mesh into one vertex buffer and
+	 *  one index buffer behind a single vertex array. Returns
+	 *  false if the program cannot be built, leaving every
+	 *  object to be drawn on its own.
+	 ***********************************************************/
+	bool CreateGeometryPool()
+	{
+		GLuint program = LinkShaderProgram(g_PoolVertexShader, g_PoolFragmentShader, "geometry pool");
+		if (program == 0)
+		{
+			return(false);
+		}
+		g_poolProgram = program;
 
-	scaleXYZ = glm::vec3(2.5f, 1.5f, 5.0f);
+		// start from a copy of the scene handles, so every handle
+		// names the same uniform in both programs
+		g_poolUniforms = g_uniformCache;
+		g_poolUniforms.Attach(g_poolProgram);
 
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 90.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+		// each mesh is appended to the pool; its indices stay local
+		// to the mesh and are offset by its base vertex when drawn
+		MeshBuilder pool;
+		for (int mesh = 0; mesh < SCENE_MESH_COUNT; mesh++)
+		{
+			MeshBuilder builder;
+			MESH_GEOMETRY& geometry = g_meshGeometry[mesh];
+			BuildMeshGeometry(static_cast<SCENE_MESH>(mesh), builder, geometry);
+
+			geometry.baseVertex = static_cast<GLint>(pool.vertices.size());
+			for (int part = 0; part < SCENE_PART_COUNT; part++)
+			{
+				geometry.partFirst[part] += pool.IndexCount();
+			}
+			pool.vertices.insert(pool.vertices.end(), builder.vertices.begin(), builder.vertices.end());
+			pool.indices.insert(pool.indices.end(), builder.indices.begin(), builder.indices.end());
+		}
 
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(0.7f, 8.3f, -1.5f);
+		glGenVertexArrays(1, &g_poolVao);
+		glGenBuffers(1, &g_poolVertexBuffer);
+		glGenBuffers(1, &g_poolIndexBuffer);
+		glGenBuffers(1, &g_instanceTableBuffer);
+		glGenBuffers(1, &g_recordBuffer);
+		glGenBuffers(1, &g_commandBuffer);
+		glBindVertexArray(g_poolVao);
+
+		glBindBuffer(GL_ARRAY_BUFFER, g_poolVertexBuffer);
+		glBufferData(GL_ARRAY_BUFFER, pool.vertices.size() * sizeof(MESH_VERTEX), pool.vertices.data(), GL_STATIC_DRAW);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(MESH_VERTEX), (void*)offsetof(MESH_VERTEX, position));
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(MESH_VERTEX), (void*)offsetof(MESH_VERTEX, normal));
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(MESH_VERTEX), (void*)offsetof(MESH_VERTEX, uv));
+		glEnableVertexAttribArray(4);
+		glVertexAttribIPointer(4, 1, GL_INT, sizeof(MESH_VERTEX), (void*)offsetof(MESH_VERTEX, face));
+		glEnableVertexAttribArray(5);
+		glVertexAttribPointer(5, 2, GL_FLOAT, GL_FALSE, sizeof(MESH_VERTEX), (void*)offsetof(MESH_VERTEX, lightmapUV));
+
+		// the instance table entry steps once per instance, so the
+		// base instance of a draw command selects its first entry
+		glBindBuffer(GL_ARRAY_BUFFER, g_instanceTableBuffer);
+		glEnableVertexAttribArray(3);
+		glVertexAttribIPointer(3, 4, GL_INT, sizeof(INSTANCE_ENTRY), (void*)0);
+		glVertexAttribDivisor(3, 1);
+
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_poolIndexBuffer);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, pool.indices.size() * sizeof(GLuint), pool.indices.data(), GL_STATIC_DRAW);
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		std::cout << "[SceneManager] Geometry pool: " << pool.vertices.size() << " vertices, "
+			<< pool.indices.size() << " indices" << std::endl;
+		g_shadowMaps.Create();
+		return(true);
+	}
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+	/***********************************************************
+	 *  SyncSharedUniforms()
+	 *
+	 *  This function is used for copying the uniforms the scene
+	 *  program owns, like the camera and the lights, into the
+	 *  pool program. The values come from the scene uniform
+	 *  cache rather than from GL, and only changed values are
+	 *  sent on.
+	 ***********************************************************/
+	void SyncSharedUniforms(GLuint sourceProgram)
+	{
+		if (sourceProgram != g_sharedUniformSource)
+		{
+			// find the active uniforms of the pool program that also
+			// exist in the scene program
+			g_sharedUniforms.clear();
+			g_sharedUniformSource = sourceProgram;
+			GLint uniformCount = 0;
+			glGetProgramiv(g_poolProgram, GL_ACTIVE_UNIFORMS, &uniformCount);
+			for (GLint i = 0; i < uniformCount; i++)
+			{
+				char name[256] = { 0 };
+				GLint size = 0;
+				SHARED_UNIFORM shared;
+				glGetActiveUniform(g_poolProgram, i, sizeof(name), NULL, &size, &shared.type, name);
+				shared.source = g_uniformCache.Resolve(name);
+				if ((g_uniformCache.Location(shared.source) < 0) || (size != 1))
+				{
+					continue;
+				}
+				shared.handle = g_poolUniforms.Resolve(name);
+				g_sharedUniforms.push_back(shared);
+			}
+		}
 
-	SetShaderColor(0.0f, 0.0f, 0.0f, 1.0f);
-	SetShaderTexture("ram");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::top);
-	SetShaderTexture("black");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::bottom);
-	SetShaderTexture("black");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::left);
-	SetShaderTexture("black");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::right);
-	SetShaderTexture("black");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::front);
-	SetShaderTexture("black");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::back);
-	SetShaderMaterial("metal");
+		// uniforms the scene cache has not set yet are left alone
+		for (const SHARED_UNIFORM& shared : g_sharedUniforms)
+		{
+			g_uniformCache.Forward(shared.source, shared.type, g_poolUniforms, shared.handle);
+		}
+	}
 
+	/***********************************************************
+	 *  PartsCoverFaces()
+	 *
+	 *  This function is used for checking whether a draw list
+	 *  gives every face of its mesh a texture through its parts,
+	 *  filling in the texture of each face when it does.
+	 ***********************************************************/
+	bool PartsCoverFaces(SCENE_MESH mesh, int firstDraw, int drawCount, int faceTextures[MESH_FACE_COUNT])
+	{
+		int faceCount = MeshFaceCount(mesh);
+		int covered = 0;
+		std::fill(faceTextures, faceTextures + MESH_FACE_COUNT, -1);
+		for (int i = firstDraw; i < firstDraw + drawCount; i++)
+		{
+			const SCENE_DRAW& draw = g_sceneDraws[i];
+			if (draw.part == PART_FULL)
+			{
+				return(false);
+			}
+			int bit = 1 << PartFace(draw.part);
+			if ((covered & bit) != 0)
+			{
+				return(false);
+			}
+			covered |= bit;
+			faceTextures[PartFace(draw.part)] = draw.textureHandle;
+		}
+		return((faceCount > 1) && (covered == (1 << faceCount) - 1));
+	}
 
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
+	/***********************************************************
+	 *  PackFaceLayers()
+	 *
+	 *  This function is used for packing the texture layers of
+	 *  the faces of an instance table entry, two faces to an
+	 *  int. Each layer is stored plus one in 16 bits, so that a
+	 *  face whose texture is not resident yet stores 0 and is
+	 *  drawn with the record color.
+	 ***********************************************************/
+	void PackFaceLayers(INSTANCE_ENTRY& entry, const int* faceTextures)
+	{
+		std::fill(entry.faceLayers, entry.faceLayers + MESH_FACE_COUNT / 2, 0);
+		for (int face = 0; face < MESH_FACE_COUNT; face++)
+		{
+			int layer = TextureResident(faceTextures[face]) ? faceTextures[face] : -1;
+			entry.faceLayers[face / 2] |= ((layer + 1) & 0xFFFF) << (16 * (face % 2));
+		}
+	}
 
-	//SetShaderColor(1, 1, 1, 1);
+	/***********************************************************
+	 *  BuildInstanceGroups()
+	 *
+	 *  This function is used for grouping the opaque objects
+	 *  that only differ by transform and color, and writing one
+	 *  object record per member. Every opaque object whose
+	 *  textures are all in the texture array ends up in a group,
+	 *  even if it is the only member. A group whose parts give
+	 *  every face of its mesh a texture is drawn whole, with
+	 *  the texture of each face taken from the instance table.
+	 *  Runs after BuildRenderQueue(), which assigns the layers.
+	 ***********************************************************/
+	void BuildInstanceGroups()
+	{
+		g_instanceGroups.clear();
+		g_instanceDraws.clear();
+		g_objectRecords.clear();
+
+		// objects can share a group when their draw lists match
+		auto sameDraws = [](const SCENE_OBJECT& a, const INSTANCE_GROUP& group) {
+			if ((a.mesh != group.mesh) || (a.materialHandle != group.materialHandle) ||
+				(a.layer != group.layer) || (a.drawCount != group.drawCount))
+			{
+				return(false);
+			}
+			for (int i = 0; i < a.drawCount; i++)
+			{
+				const SCENE_DRAW& drawA = g_sceneDraws[a.firstDraw + i];
+				const SCENE_DRAW& drawB = g_sceneDraws[group.firstDraw + i];
+				if ((drawA.part != drawB.part) || (drawA.textureHandle != drawB.textureHandle))
+				{
+					return(false);
+				}
+			}
+			return(true);
+			};
+
+		for (size_t i = 0; i < g_sceneObjects.size(); i++)
+		{
+			const SCENE_OBJECT& object = g_sceneObjects[i];
+			bool bPooled = (object.color.a >= 1.0f) && !object.bCovered && g_bMeshMatches[object.mesh];
+			for (int draw = object.firstDraw; draw < object.firstDraw + object.drawCount; draw++)
+			{
+				bPooled = bPooled && (g_sceneDraws[draw].textureHandle < g_textureArrayLayers);
+			}
+			if (!bPooled)
+			{
+				continue;
+			}
+			size_t group = 0;
+			while ((group < g_instanceGroups.size()) && !sameDraws(object, g_instanceGroups[group]))
+			{
+				group++;
+			}
+			if (group == g_instanceGroups.size())
+			{
+				INSTANCE_GROUP candidate;
+				candidate.mesh = object.mesh;
+				candidate.materialHandle = object.materialHandle;
+				candidate.layer = object.layer;
+				candidate.firstDraw = object.firstDraw;
+				candidate.drawCount = object.drawCount;
+				candidate.baseInstance = 0;
+				candidate.bDynamic = false;
+				g_instanceGroups.push_back(candidate);
+			}
+			g_instanceGroups[group].objects.push_back(static_cast<int>(i));
+			g_instanceGroups[group].bDynamic = g_instanceGroups[group].bDynamic || object.bDynamic;
+		}
 
-	//m_basicMeshes->DrawBoxMeshLines();
+		for (size_t groupIndex = 0; groupIndex < g_instanceGroups.size(); groupIndex++)
+		{
+			INSTANCE_GROUP& group = g_instanceGroups[groupIndex];
+			group.baseInstance = static_cast<int>(g_objectRecords.size());
+
+			MATERIAL_VALUES material = { glm::vec3(0.0f), glm::vec3(0.0f), 0.0f };
+			if (group.materialHandle >= 0)
+			{
+				material = g_materialTable[group.materialHandle];
+			}
+			for (int index : group.objects)
+			{
+				OBJECT_RECORD record;
+				record.model = g_worldMatrices[index];
+				record.color = g_sceneObjects[index].color;
+				record.diffuseShininess = glm::vec4(material.diffuseColor, material.shininess);
+				record.specular = glm::vec4(material.specularColor, 0.0f);
+				record.lightmapRect = glm::vec4(0.0f);
+				g_objectRecords.push_back(record);
+				g_sceneObjects[index].instanceGroup = static_cast<int>(groupIndex);
+			}
+
+			int faceTextures[MESH_FACE_COUNT];
+			if (PartsCoverFaces(group.mesh, group.firstDraw, group.drawCount, faceTextures))
+			{
+				INSTANCE_DRAW instanceDraw;
+				instanceDraw.group = static_cast<int>(groupIndex);
+				instanceDraw.part = PART_FULL;
+				std::copy(faceTextures, faceTextures + MESH_FACE_COUNT, instanceDraw.faceTextures);
+				g_instanceDraws.push_back(instanceDraw);
+				continue;
+			}
+			for (int i = 0; i < group.drawCount; i++)
+			{
+				const SCENE_DRAW& draw = g_sceneDraws[group.firstDraw + i];
+				INSTANCE_DRAW instanceDraw;
+				instanceDraw.group = static_cast<int>(groupIndex);
+				instanceDraw.part = draw.part;
+				std::fill(instanceDraw.faceTextures, instanceDraw.faceTextures + MESH_FACE_COUNT, draw.textureHandle);
+				g_instanceDraws.push_back(instanceDraw);
+			}
+		}
+	}
 
+	/***********************************************************
+	 *  UpdateObjectRecords()
+	 *
+	 *  This function is used for copying the world matrices of
+	 *  groups with dynamic members into the record buffer.
+	 *  Static groups keep the records uploaded in PrepareScene().
+	 ***********************************************************/
+	void UpdateObjectRecords()
+	{
+		bool bBound = false;
+		for (const INSTANCE_GROUP& group : g_instanceGroups)
+		{
+			if (!group.bDynamic)
+			{
+				continue;
+			}
+			for (size_t i = 0; i < group.objects.size(); i++)
+			{
+				g_objectRecords[group.baseInstance + i].model = g_worldMatrices[group.objects[i]];
+			}
+			if (!bBound)
+			{
+				glBindBuffer(GL_SHADER_STORAGE_BUFFER, g_recordBuffer);
+				bBound = true;
+			}
+			glBufferSubData(GL_SHADER_STORAGE_BUFFER, group.baseInstance * sizeof(OBJECT_RECORD),
+				group.objects.size() * sizeof(OBJECT_RECORD), &g_objectRecords[group.baseInstance]);
+		}
+		if (bBound)
+		{
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		}
+	}
 
+	/***********************************************************
+	 *  DestroyGeometryPool()
+	 *
+	 *  This function is used for freeing the pool program and
+	 *  its vertex, index, record and command buffers.
+	 ***********************************************************/
+	void DestroyGeometryPool()
+	{
+		if (g_poolProgram == 0)
+		{
+			return;
+		}
+		glDeleteVertexArrays(1, &g_poolVao);
+		glDeleteBuffers(1, &g_poolVertexBuffer);
+		glDeleteBuffers(1, &g_poolIndexBuffer);
+		glDeleteBuffers(1, &g_instanceTableBuffer);
+		glDeleteBuffers(1, &g_recordBuffer);
+		glDeleteBuffers(1, &g_commandBuffer);
+		glDeleteProgram(g_poolProgram);
+		g_shadowMaps.Destroy();
+		g_poolProgram = 0;
+		g_sharedUniformSource = 0;
+	}
 
-	//---------------------------------------------------------------------------------------------------Bottom Fans
+	// occlusion proxy program - the world box of an object drawn
+	// without writing color or depth, so that its query only tells
+	// whether any of it would pass the depth test
+	const char* g_ProxyVertexShader = R"(
+#version 430 core
+layout(location = 0) in vec3 inVertexPosition;
 
-	scaleXYZ = glm::vec3(4.0f, 1.0f, 11.0f);
+uniform mat4 viewProjection;
+uniform vec3 boxCenter;
+uniform vec3 boxExtent;
 
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 90.0f;
-	ZrotationDegrees = 0.0f;
+void main()
+{
+	gl_Position = viewProjection * vec4(boxCenter + inVertexPosition * boxExtent, 1.0);
+}
+)";
 
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(1.5f, 1.5f, 2.0f);
+	const char* g_ProxyFragmentShader = R"(
+#version 430 core
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+void main()
+{
+}
+)";
+
+	// a proxy box's faces would lie on the faces of a box shaped
+	// object and fail the depth test against it, so every proxy is
+	// grown a little
+	const float g_ProxyMarginScale = 1.01f;
+	const float g_ProxyMargin = 0.01f;
+
+	GLuint g_proxyProgram = 0;
+	GLuint g_proxyVao = 0;
+	GLuint g_proxyVertexBuffer = 0;
+	GLuint g_proxyIndexBuffer = 0;
+	GLint g_proxyViewProjection = -1;
+	GLint g_proxyCenter = -1;
+	GLint g_proxyExtent = -1;
+
+	/***********************************************************
+	 *  CreateOcclusionQueries()
+	 *
+	 *  This function is used for building the proxy program,
+	 *  the unit box it draws, and a query for every scene
+	 *  object. Without the program no object is ever hidden.
+	 ***********************************************************/
+	void CreateOcclusionQueries()
+	{
+		g_occlusionQueries.clear();
+		g_frustumVisible.assign(g_sceneObjects.size(), 1);
+		g_proxyProgram = LinkShaderProgram(g_ProxyVertexShader, g_ProxyFragmentShader, "occlusion proxy");
+		if (g_proxyProgram == 0)
+		{
+			return;
+		}
+		g_proxyViewProjection = glGetUniformLocation(g_proxyProgram, "viewProjection");
+		g_proxyCenter = glGetUniformLocation(g_proxyProgram, "boxCenter");
+		g_proxyExtent = glGetUniformLocation(g_proxyProgram, "boxExtent");
+
+		// the corners of a box from -1 to 1, and its twelve triangles
+		const GLfloat corners[] = {
+			-1.0f, -1.0f, -1.0f,   1.0f, -1.0f, -1.0f,   1.0f, 1.0f, -1.0f,   -1.0f, 1.0f, -1.0f,
+			-1.0f, -1.0f, 1.0f,    1.0f, -1.0f, 1.0f,    1.0f, 1.0f, 1.0f,    -1.0f, 1.0f, 1.0f };
+		const GLuint triangles[] = {
+			0, 2, 1,  0, 3, 2,     4, 5, 6,  4, 6, 7,
+			0, 1, 5,  0, 5, 4,     3, 7, 6,  3, 6, 2,
+			0, 4, 7,  0, 7, 3,     1, 2, 6,  1, 6, 5 };
+
+		glGenVertexArrays(1, &g_proxyVao);
+		glGenBuffers(1, &g_proxyVertexBuffer);
+		glGenBuffers(1, &g_proxyIndexBuffer);
+		glBindVertexArray(g_proxyVao);
+		glBindBuffer(GL_ARRAY_BUFFER, g_proxyVertexBuffer);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (void*)0);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_proxyIndexBuffer);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(triangles), triangles, GL_STATIC_DRAW);
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		std::vector<GLuint> queries(g_sceneObjects.size());
+		if (!queries.empty())
+		{
+			glGenQueries(static_cast<GLsizei>(queries.size()), queries.data());
+		}
+		for (GLuint query : queries)
+		{
+			OCCLUSION_QUERY occlusion;
+			occlusion.query = query;
+			occlusion.bPending = false;
+			occlusion.bOccluded = false;
+			g_occlusionQueries.push_back(occlusion);
+		}
+	}
 
-	SetShaderColor(0.1, 0.1, 0.12, 1);
-	SetShaderMaterial("metal");
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
+	/***********************************************************
+	 *  IssueOcclusionQueries()
+	 *
+	 *  This function is used for drawing the proxy box of every
+	 *  object in the camera's view against the finished depth
+	 *  buffer, each inside its own query. The results are read
+	 *  by HideOccludedObjects() on a following frame, and an
+	 *  object whose last query is still running is not tested
+	 *  again until it finishes.
+	 ***********************************************************/
+	void IssueOcclusionQueries(const glm::mat4& view, const glm::mat4& projection)
+	{
+		glm::mat4 viewProjection = projection * view;
+		glm::vec4 planes[6];
+		if ((g_proxyProgram == 0) || !ExtractFrustumPlanes(viewProjection, planes))
+		{
+			return;
+		}
 
-	//SetShaderColor(1, 1, 1, 1);
+		glUseProgram(g_proxyProgram);
+		glUniformMatrix4fv(g_proxyViewProjection, 1, GL_FALSE, glm::value_ptr(viewProjection));
+		glBindVertexArray(g_proxyVao);
+		g_renderStates.SetColorMask(false);
+		g_renderStates.SetDepthMask(false);
+		for (size_t i = 0; i < g_occlusionQueries.size(); i++)
+		{
+			OCCLUSION_QUERY& occlusion = g_occlusionQueries[i];
+			if (!g_frustumVisible[i] || occlusion.bPending || g_sceneObjects[i].bCovered)
+			{
+				continue;
+			}
+			glm::vec3 center(g_boundsCenter[0][i], g_boundsCenter[1][i], g_boundsCenter[2][i]);
+			glm::vec3 extent(g_boundsExtent[0][i], g_boundsExtent[1][i], g_boundsExtent[2][i]);
+			extent = extent * g_ProxyMarginScale + glm::vec3(g_ProxyMargin);
+
+			// the near plane would cut away the faces of a box the
+			// camera is in or next to, so such an object is seen
+			float distance = glm::dot(glm::vec3(planes[4]), center) + planes[4].w;
+			float radius = glm::dot(glm::abs(glm::vec3(planes[4])), extent);
+			if (distance - radius <= 0.0f)
+			{
+				occlusion.bOccluded = false;
+				continue;
+			}
+
+			glUniform3fv(g_proxyCenter, 1, glm::value_ptr(center));
+			glUniform3fv(g_proxyExtent, 1, glm::value_ptr(extent));
+			glBeginQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE, occlusion.query);
+			glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, (void*)0);
+			glEndQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE);
+			occlusion.bPending = true;
+		}
+		g_renderStates.SetColorMask(true);
+		g_renderStates.SetDepthMask(true);
+		glBindVertexArray(0);
+		glUseProgram(g_uniformCache.Program());
+	}
 
-	//m_basicMeshes->DrawBoxMeshLines();
+	/***********************************************************
+	 *  DestroyOcclusionQueries()
+	 *
+	 *  This function is used for freeing the queries and the
+	 *  proxy program and box.
+	 ***********************************************************/
+	void DestroyOcclusionQueries()
+	{
+		for (const OCCLUSION_QUERY& occlusion : g_occlusionQueries)
+		{
+			glDeleteQueries(1, &occlusion.query);
+		}
+		g_occlusionQueries.clear();
+		if (g_proxyProgram == 0)
+		{
+			return;
+		}
+		glDeleteVertexArrays(1, &g_proxyVao);
+		glDeleteBuffers(1, &g_proxyVertexBuffer);
+		glDeleteBuffers(1, &g_proxyIndexBuffer);
+		glDeleteProgram(g_proxyProgram);
+		g_proxyProgram = 0;
+	}
 
+	// debug outline program - world space lines with a color per
+	// vertex
+	const char* g_OutlineVertexShader = R"(
+#version 430 core
+layout(location = 0) in vec3 inVertexPosition;
+layout(location = 1) in vec4 inVertexColor;
 
-	//----------------------------------------------------------------------------
+out vec4 fragmentColor;
 
-	scaleXYZ = glm::vec3(1.5f, 1.5f, 1.5f);
+uniform mat4 viewProjection;
 
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 90.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+void main()
+{
+	fragmentColor = inVertexColor;
+	gl_Position = viewProjection * vec4(inVertexPosition, 1.0);
+}
+)";
 
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(1.5f, 2.0f, 2.0f);
+	const char* g_OutlineFragmentShader = R"(
+#version 430 core
+in vec4 fragmentColor;
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+out vec4 outFragmentColor;
 
-	SetShaderColor(0.0f, 0.9f, 1.0f, 1.0f);
+void main()
+{
+	outFragmentColor = fragmentColor;
+}
+)";
 
-	SetShaderMaterial("metal");
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawTorusMesh();
+	// one end of an outline segment
+	struct OUTLINE_VERTEX
+	{
+		glm::vec3 position;
+		GLuint color;               // RGBA, 8 bits each from the lowest
+	};
+
+	// outline colors - static objects, dynamic objects and the object
+	// picked last
+	const GLuint g_StaticOutlineColor = 0xFFB0B0B0;
+	const GLuint g_DynamicOutlineColor = 0xFF00D0FF;
+	const GLuint g_PickedOutlineColor = 0xFF2020FF;
+
+	/***********************************************************
+	 *  DebugLineBatcher
+	 *
+	 *  Collects line segments and draws all of them with one
+	 *  GL_LINES call. The vertex buffer stays mapped, split in
+	 *  regions the frames write in turn, each fenced until the
+	 *  GPU has drawn from it. Static segments are kept until
+	 *  changed and copied into a region only when it does not
+	 *  hold them yet; the per frame segments follow them.
+	 *  Without buffer storage a single buffer is orphaned and
+	 *  refilled with all the segments every frame instead.
+	 ***********************************************************/
+	/***********************************************************
+	 *  HasBufferStorage()
+	 *
+	 *  This function is used for checking whether the context
+	 *  can make persistently mapped buffers, which takes GL 4.4
+	 *  or the ARB_buffer_storage extension.
+	 ***********************************************************/
+	bool HasBufferStorage()
+	{
+		GLint major = 0;
+		GLint minor = 0;
+		glGetIntegerv(GL_MAJOR_VERSION, &major);
+		glGetIntegerv(GL_MINOR_VERSION, &minor);
+		if ((major > 4) || ((major == 4) && (minor >= 4)))
+		{
+			return(true);
+		}
 
-	//SetShaderColor(1, 1, 1, 1);
+		GLint count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+		for (GLint i = 0; i < count; i++)
+		{
+			const GLubyte* name = glGetStringi(GL_EXTENSIONS, i);
+			if ((name != nullptr) && (strcmp(reinterpret_cast<const char*>(name), "GL_ARB_buffer_storage") == 0))
+			{
+				return(true);
+			}
+		}
+		return(false);
+	}
 
-	//m_basicMeshes->DrawBoxMeshLines();
+	class DebugLineBatcher
+	{
+	public:
+		DebugLineBatcher() : m_program(0), m_vao(0), m_buffer(0), m_viewProjection(-1), m_mapped(nullptr),
+			m_bPersistent(false), m_region(0), m_staticVersion(1), m_bOverflowed(false)
+		{
+			for (int i = 0; i < REGION_COUNT; i++)
+			{
+				m_fences[i] = 0;
+				m_regionVersion[i] = 0;
+			}
+		}
 
-	//----------------------------------------------------------------------------
+		// builds the program and the buffer, which is mapped for
+		// good where buffer storage is available
+		bool Create()
+		{
+			m_program = LinkShaderProgram(g_OutlineVertexShader, g_OutlineFragmentShader, "debug outline");
+			if (m_program == 0)
+			{
+				return(false);
+			}
+			m_viewProjection = glGetUniformLocation(m_program, "viewProjection");
+
+			const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			const GLsizeiptr size = REGION_COUNT * REGION_VERTICES * sizeof(OUTLINE_VERTEX);
+			m_bPersistent = HasBufferStorage();
+			glGenVertexArrays(1, &m_vao);
+			glGenBuffers(1, &m_buffer);
+			glBindVertexArray(m_vao);
+			glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+			if (m_bPersistent)
+			{
+				glBufferStorage(GL_ARRAY_BUFFER, size, NULL, flags);
+				m_mapped = static_cast<OUTLINE_VERTEX*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags));
+			}
+			else
+			{
+				glBufferData(GL_ARRAY_BUFFER, REGION_VERTICES * sizeof(OUTLINE_VERTEX), NULL, GL_STREAM_DRAW);
+			}
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(OUTLINE_VERTEX), (void*)offsetof(OUTLINE_VERTEX, position));
+			glEnableVertexAttribArray(1);
+			glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(OUTLINE_VERTEX), (void*)offsetof(OUTLINE_VERTEX, color));
+			glBindVertexArray(0);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+			if (m_bPersistent && (m_mapped == nullptr))
+			{
+				std::cerr << "[SceneManager] ERROR: Failed to map the debug outline buffer" << std::endl;
+				Destroy();
+				return(false);
+			}
+			return(true);
+		}
 
-	scaleXYZ = glm::vec3(1.5f, 1.5f, 1.5f);
+		void Destroy()
+		{
+			for (int i = 0; i < REGION_COUNT; i++)
+			{
+				if (m_fences[i] != 0)
+				{
+					glDeleteSync(m_fences[i]);
+					m_fences[i] = 0;
+				}
+				m_regionVersion[i] = 0;
+			}
+			if (m_program == 0)
+			{
+				return;
+			}
+			if (m_mapped != nullptr)
+			{
+				glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+				glUnmapBuffer(GL_ARRAY_BUFFER);
+				glBindBuffer(GL_ARRAY_BUFFER, 0);
+				m_mapped = nullptr;
+			}
+			glDeleteVertexArrays(1, &m_vao);
+			glDeleteBuffers(1, &m_buffer);
+			glDeleteProgram(m_program);
+			m_program = 0;
+		}
 
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 90.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+		bool IsCreated() const
+		{
+			return(m_program != 0);
+		}
 
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-2.0f, 2.0f, 2.0f);
+		// the twelve edges of a box, kept until ClearStatic()
+		void AddStaticBox(const glm::vec3& center, const glm::vec3& extent, GLuint color)
+		{
+			AddBox(m_static, center, extent, color);
+			m_staticVersion++;
+		}
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+		void ClearStatic()
+		{
+			m_static.clear();
+			m_staticVersion++;
+		}
 
-	SetShaderColor(0.0f, 0.9f, 1.0f, 1.0f);
+		// the twelve edges of a box, drawn on the next Draw() only
+		void AddBox(const glm::vec3& center, const glm::vec3& extent, GLuint color)
+		{
+			AddBox(m_frame, center, extent, color);
+		}
 
-	SetShaderMaterial("metal");
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawTorusMesh();
+		void Draw(const glm::mat4& viewProjection)
+		{
+			if (m_program == 0)
+			{
+				return;
+			}
+
+			size_t staticCount = std::min(m_static.size(), static_cast<size_t>(REGION_VERTICES));
+			size_t frameCount = std::min(m_frame.size(), REGION_VERTICES - staticCount);
+			if (m_bPersistent)
+			{
+				// the region is rewritten only once the GPU is done with it
+				if (m_fences[m_region] != 0)
+				{
+					glClientWaitSync(m_fences[m_region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+					glDeleteSync(m_fences[m_region]);
+					m_fences[m_region] = 0;
+				}
+
+				OUTLINE_VERTEX* region = m_mapped + m_region * REGION_VERTICES;
+				if (m_regionVersion[m_region] != m_staticVersion)
+				{
+					memcpy(region, m_static.data(), staticCount * sizeof(OUTLINE_VERTEX));
+					m_regionVersion[m_region] = m_staticVersion;
+				}
+				memcpy(region + staticCount, m_frame.data(), frameCount * sizeof(OUTLINE_VERTEX));
+			}
+			else
+			{
+				// orphaning the storage lets the driver hand back fresh
+				// memory while the last frame's draw still reads the old
+				glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+				glBufferData(GL_ARRAY_BUFFER, REGION_VERTICES * sizeof(OUTLINE_VERTEX), NULL, GL_STREAM_DRAW);
+				glBufferSubData(GL_ARRAY_BUFFER, 0, staticCount * sizeof(OUTLINE_VERTEX), m_static.data());
+				glBufferSubData(GL_ARRAY_BUFFER, staticCount * sizeof(OUTLINE_VERTEX), frameCount * sizeof(OUTLINE_VERTEX), m_frame.data());
+				glBindBuffer(GL_ARRAY_BUFFER, 0);
+			}
+			if (!m_bOverflowed && (staticCount + frameCount < m_static.size() + m_frame.size()))
+			{
+				std::cerr << "[SceneManager] ERROR: Too many debug outline segments, some are not drawn" << std::endl;
+				m_bOverflowed = true;
+			}
+
+			glUseProgram(m_program);
+			glUniformMatrix4fv(m_viewProjection, 1, GL_FALSE, glm::value_ptr(viewProjection));
+			glBindVertexArray(m_vao);
+			glDrawArrays(GL_LINES, m_bPersistent ? m_region * REGION_VERTICES : 0, static_cast<GLsizei>(staticCount + frameCount));
+			glBindVertexArray(0);
+			glUseProgram(g_uniformCache.Program());
+
+			if (m_bPersistent)
+			{
+				m_fences[m_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+				m_region = (m_region + 1) % REGION_COUNT;
+			}
+			m_frame.clear();
+		}
 
-	//SetShaderColor(1, 1, 1, 1);
+	private:
+		static const int REGION_COUNT = 3;
+		static const int REGION_VERTICES = 16384;
 
-	//m_basicMeshes->DrawBoxMeshLines();
+		static void AddBox(std::vector<OUTLINE_VERTEX>& lines, const glm::vec3& center, const glm::vec3& extent, GLuint color)
+		{
+			// corner i has the high X, Y and Z side where bits 0, 1 and 2 are set
+			for (int i = 0; i < 8; i++)
+			{
+				for (int axis = 0; axis < 3; axis++)
+				{
+					int bit = 1 << axis;
+					if ((i & bit) != 0)
+					{
+						continue;
+					}
+					OUTLINE_VERTEX ends[2];
+					for (int end = 0; end < 2; end++)
+					{
+						int corner = (end == 0) ? i : (i | bit);
+						ends[end].position = glm::vec3(
+							center.x + ((corner & 1) ? extent.x : -extent.x),
+							center.y + ((corner & 2) ? extent.y : -extent.y),
+							center.z + ((corner & 4) ? extent.z : -extent.z));
+						ends[end].color = color;
+						lines.push_back(ends[end]);
+					}
+				}
+			}
+		}
 
+		GLuint m_program;
+		GLuint m_vao;
+		GLuint m_buffer;
+		GLint m_viewProjection;
+		OUTLINE_VERTEX* m_mapped;
+		bool m_bPersistent;                           // whether m_mapped holds the regions
+		GLsync m_fences[REGION_COUNT];
+		unsigned int m_regionVersion[REGION_COUNT];   // static version each region holds
+		int m_region;
+		unsigned int m_staticVersion;
+		std::vector<OUTLINE_VERTEX> m_static;
+		std::vector<OUTLINE_VERTEX> m_frame;
+		bool m_bOverflowed;
+	};
+
+	// the bounding box outlines of the scene objects, toggled with
+	// the B key; created the first time they are shown
+	DebugLineBatcher g_outlines;
+	bool g_bShowOutlines = false;
+	bool g_bOutlineKeyDown = false;
+
+	/***********************************************************
+	 *  PollOutlineToggle()
+	 *
+	 *  This function is used for turning the outline overlay on
+	 *  and off when the B key goes down.
+	 ***********************************************************/
+	void PollOutlineToggle()
+	{
+		GLFWwindow* window = glfwGetCurrentContext();
+		if (window == nullptr)
+		{
+			return;
+		}
+		bool bPressed = (glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS);
+		if (bPressed && !g_bOutlineKeyDown)
+		{
+			g_bShowOutlines = !g_bShowOutlines;
+		}
+		g_bOutlineKeyDown = bPressed;
+	}
 
+	/***********************************************************
+	 *  DrawSceneOutlines()
+	 *
+	 *  This function is used for drawing the world space box of
+	 *  every scene object as an overlay. The boxes of static
+	 *  objects are built once; those of dynamic objects, and of
+	 *  the picked object, are added every frame.
+	 ***********************************************************/
+	void DrawSceneOutlines(const glm::mat4& view, const glm::mat4& projection)
+	{
+		if (!g_bShowOutlines)
+		{
+			return;
+		}
+		if (!g_outlines.IsCreated())
+		{
+			if (!g_outlines.Create())
+			{
+				g_bShowOutlines = false;
+				return;
+			}
+			g_outlines.ClearStatic();
+			for (size_t i = 0; i < g_sceneObjects.size(); i++)
+			{
+				if (!g_sceneObjects[i].bDynamic && !g_sceneObjects[i].bCovered)
+				{
+					g_outlines.AddStaticBox(
+						glm::vec3(g_boundsCenter[0][i], g_boundsCenter[1][i], g_boundsCenter[2][i]),
+						glm::vec3(g_boundsExtent[0][i], g_boundsExtent[1][i], g_boundsExtent[2][i]),
+						g_StaticOutlineColor);
+				}
+			}
+		}
 
-	//----------------------------------------------------------------------------
+		for (int index : g_dynamicObjects)
+		{
+			g_outlines.AddBox(
+				glm::vec3(g_boundsCenter[0][index], g_boundsCenter[1][index], g_boundsCenter[2][index]),
+				glm::vec3(g_boundsExtent[0][index], g_boundsExtent[1][index], g_boundsExtent[2][index]),
+				g_DynamicOutlineColor);
+		}
+		if (g_pickedObject >= 0)
+		{
+			g_outlines.AddBox(
+				glm::vec3(g_boundsCenter[0][g_pickedObject], g_boundsCenter[1][g_pickedObject], g_boundsCenter[2][g_pickedObject]),
+				glm::vec3(g_boundsExtent[0][g_pickedObject], g_boundsExtent[1][g_pickedObject], g_boundsExtent[2][g_pickedObject]),
+				g_PickedOutlineColor);
+		}
 
-	scaleXYZ = glm::vec3(1.5f, 1.5f, 1.5f);
+		// the overlay is depth tested against the scene but does
+		// not hide anything itself
+		g_renderStates.SetBlend(false);
+		g_renderStates.SetDepthMask(false);
+		g_outlines.Draw(projection * view);
+	}
 
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 90.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+	// packed render queue sort key, most significant bits first:
+	//   pass:2 layer:4 blend:1 instanced:1 texture:12 material:12 mesh:8 draw:24
+	// opaque draws sort by texture, then material, then mesh.
+	// Transparent draws use the texture, material and mesh bits for
+	// the view depth of their object instead, far to near, so that
+	// each blends over what is behind it; their layer is left zero
+	// and coinciding ones keep their file order.
+	// For instanced draws the draw bits index g_instanceDraws; they
+	// are sorted once into the draw commands of the geometry pool.
+	const int SORT_DRAW_BITS = 24;
+	const int SORT_MESH_SHIFT = 24;
+	const int SORT_MATERIAL_SHIFT = 32;
+	const int SORT_TEXTURE_SHIFT = 44;
+	const int SORT_INSTANCED_SHIFT = 56;
+	const int SORT_BLEND_SHIFT = 57;
+	const int SORT_LAYER_SHIFT = 58;
+	const int SORT_PASS_SHIFT = 62;
+	const uint64_t SORT_DRAW_MASK = (1ull << SORT_DRAW_BITS) - 1;
+
+	enum RENDER_PASS
+	{
+		PASS_OPAQUE,
+		PASS_TRANSPARENT
+	};
+
+	// texture, material or mesh state that the geometry pool reads
+	// per record
+	const int STATE_PER_RECORD = -2;
+
+	// the draws of the current frame as sort keys; the draw index
+	// in the low bits means no payload has to be sorted with them
+	std::vector<uint64_t> g_renderQueue;
+	std::vector<uint64_t> g_renderQueueScratch;
+
+	/***********************************************************
+	 *  RenderStateCounter
+	 *
+	 *  Counts the draw calls and the texture, material, mesh and
+	 *  blend changes a sequence of draws needs, so that the file
+	 *  order and the sorted order of the render queue can be
+	 *  compared.
+	 ***********************************************************/
+	class RenderStateCounter
+	{
+	public:
+		RenderStateCounter() : calls(0), textures(0), materials(0), meshes(0), blends(0), frames(0), m_bFirst(true) {}
 
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(5.0f, 2.0f, 2.0f);
+		void BeginFrame()
+		{
+			m_bFirst = true;
+			frames++;
+		}
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+		void Submit(int textureHandle, int materialHandle, int mesh, bool bBlend)
+		{
+			calls++;
+			if (m_bFirst || (textureHandle != m_textureHandle)) textures++;
+			if (m_bFirst || (materialHandle != m_materialHandle)) materials++;
+			if (m_bFirst || (mesh != m_mesh)) meshes++;
+			if (m_bFirst || (bBlend != m_bBlend)) blends++;
+			m_bFirst = false;
+			m_textureHandle = textureHandle;
+			m_materialHandle = materialHandle;
+			m_mesh = mesh;
+			m_bBlend = bBlend;
+		}
 
-	SetShaderColor(0.0f, 0.9f, 1.0f, 1.0f);
+		void Submit(const SCENE_DRAW& draw)
+		{
+			const SCENE_OBJECT& object = g_sceneObjects[draw.object];
+			Submit(draw.textureHandle, object.materialHandle, object.mesh, (object.color.a < 1.0f));
+		}
 
-	SetShaderMaterial("metal");
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawTorusMesh();
+		unsigned long long calls;
+		unsigned long long textures;
+		unsigned long long materials;
+		unsigned long long meshes;
+		unsigned long long blends;
+		unsigned long long frames;
+
+	private:
+		bool m_bFirst;
+		int m_textureHandle;
+		int m_materialHandle;
+		int m_mesh;
+		bool m_bBlend;
+	};
+
+	// state changes of one frame in file order, and of every
+	// frame submitted through the render queue
+	RenderStateCounter g_fileOrderChanges;
+	RenderStateCounter g_queueChanges;
+
+	/***********************************************************
+	 *  FarToNearBits()
+	 *
+	 *  This function is used for turning a view depth into bits
+	 *  that sort the farthest depth first.
+	 ***********************************************************/
+	uint32_t FarToNearBits(float depth)
+	{
+		// flipping the sign bit of positive floats, and every bit of
+		// negative ones, makes their bits sort like their values
+		uint32_t bits = 0;
+		memcpy(&bits, &depth, sizeof(bits));
+		bits = (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+		return(~bits);
+	}
 
-	//SetShaderColor(1, 1, 1, 1);
+	/***********************************************************
+	 *  MakeSortKey()
+	 *
+	 *  This function is used for packing the state a draw needs
+	 *  into its render queue sort key, or for a transparent draw
+	 *  its depth along the view.
+	 ***********************************************************/
+	uint64_t MakeSortKey(int drawIndex, const glm::mat4& view)
+	{
+		const SCENE_DRAW& draw = g_sceneDraws[drawIndex];
+		const SCENE_OBJECT& object = g_sceneObjects[draw.object];
+		bool bBlend = (object.color.a < 1.0f);
+
+		uint64_t key = static_cast<uint64_t>(drawIndex) & SORT_DRAW_MASK;
+		key |= static_cast<uint64_t>(bBlend ? PASS_TRANSPARENT : PASS_OPAQUE) << SORT_PASS_SHIFT;
+		key |= static_cast<uint64_t>(bBlend ? 1 : 0) << SORT_BLEND_SHIFT;
+		if (!bBlend)
+		{
+			key |= static_cast<uint64_t>(object.layer & 0xF) << SORT_LAYER_SHIFT;
+			key |= static_cast<uint64_t>((draw.textureHandle + 1) & 0xFFF) << SORT_TEXTURE_SHIFT;
+			key |= static_cast<uint64_t>((object.materialHandle + 1) & 0xFFF) << SORT_MATERIAL_SHIFT;
+			key |= static_cast<uint64_t>(((object.mesh << 4) | draw.part) & 0xFF) << SORT_MESH_SHIFT;
+		}
+		else
+		{
+			// the camera looks down -Z, so the depth is the negated
+			// view space Z of the object's center
+			float depth = -(view[0][2] * g_boundsCenter[0][draw.object] + view[1][2] * g_boundsCenter[1][draw.object] +
+				view[2][2] * g_boundsCenter[2][draw.object] + view[3][2]);
+			key |= static_cast<uint64_t>(FarToNearBits(depth)) << SORT_MESH_SHIFT;
+		}
+		return(key);
+	}
 
-	//m_basicMeshes->DrawBoxMeshLines();
+	/***********************************************************
+	 *  MakeInstanceSortKey()
+	 *
+	 *  This function is used for packing the state an instanced
+	 *  draw needs into its render queue sort key.
+	 ***********************************************************/
+	uint64_t MakeInstanceSortKey(int instanceDrawIndex)
+	{
+		const INSTANCE_DRAW& draw = g_instanceDraws[instanceDrawIndex];
+		const INSTANCE_GROUP& group = g_instanceGroups[draw.group];
+
+		uint64_t key = static_cast<uint64_t>(instanceDrawIndex) & SORT_DRAW_MASK;
+		key |= static_cast<uint64_t>(PASS_OPAQUE) << SORT_PASS_SHIFT;
+		key |= static_cast<uint64_t>(group.layer & 0xF) << SORT_LAYER_SHIFT;
+		key |= 1ull << SORT_INSTANCED_SHIFT;
+		key |= static_cast<uint64_t>((draw.faceTextures[0] + 1) & 0xFFF) << SORT_TEXTURE_SHIFT;
+		key |= static_cast<uint64_t>((group.materialHandle + 1) & 0xFFF) << SORT_MATERIAL_SHIFT;
+		key |= static_cast<uint64_t>(((group.mesh << 4) | draw.part) & 0xFF) << SORT_MESH_SHIFT;
+		return(key);
+	}
 
+	/***********************************************************
+	 *  RadixSortKeys()
+	 *
+	 *  This function is used for sorting the render queue with
+	 *  an LSD radix sort, one byte per pass. Passes where every
+	 *  key has the same byte are skipped.
+	 ***********************************************************/
+	void RadixSortKeys(std::vector<uint64_t>& keys, std::vector<uint64_t>& scratch)
+	{
+		scratch.resize(keys.size());
+		for (int shift = 0; shift < 64; shift += 8)
+		{
+			size_t counts[256] = { 0 };
+			for (uint64_t key : keys)
+			{
+				counts[(key >> shift) & 0xFF]++;
+			}
+			if (counts[(keys.empty() ? 0 : (keys[0] >> shift) & 0xFF)] == keys.size())
+			{
+				continue;
+			}
+
+			size_t offset = 0;
+			for (size_t& count : counts)
+			{
+				size_t bucketSize = count;
+				count = offset;
+				offset += bucketSize;
+			}
+			for (uint64_t key : keys)
+			{
+				scratch[counts[(key >> shift) & 0xFF]++] = key;
+			}
+			keys.swap(scratch);
+		}
+	}
 
+	/***********************************************************
+	 *  BuildRenderQueue()
+	 *
+	 *  This function is used for preparing the render queue once
+	 *  the scene is loaded. Objects that coincide with an earlier
+	 *  object get a higher layer so that they are still drawn
+	 *  after it. When the earlier object is opaque and draws all
+	 *  of the mesh, like the textured box a black box is listed
+	 *  over, every pixel of the later one fails the depth test,
+	 *  so it is marked covered and never drawn.
+	 ***********************************************************/
+	void BuildRenderQueue()
+	{
+		int coveredCount = 0;
+		for (size_t i = 0; i < g_sceneObjects.size(); i++)
+		{
+			SCENE_OBJECT& object = g_sceneObjects[i];
+			object.layer = 0;
+			object.bCovered = false;
+			for (size_t j = 0; j < i; j++)
+			{
+				const SCENE_OBJECT& other = g_sceneObjects[j];
+				if ((other.mesh == object.mesh) &&
+					(other.scaleXYZ == object.scaleXYZ) &&
+					(other.rotationDegrees == object.rotationDegrees) &&
+					(other.positionXYZ == object.positionXYZ))
+				{
+					object.layer++;
+					int faceTextures[MESH_FACE_COUNT];
+					bool bWhole = (other.drawCount == 1) && (g_sceneDraws[other.firstDraw].part == PART_FULL);
+					if ((other.color.a >= 1.0f) && !other.bDynamic && !object.bDynamic &&
+						(bWhole || PartsCoverFaces(other.mesh, other.firstDraw, other.drawCount, faceTextures)))
+					{
+						object.bCovered = true;
+					}
+				}
+			}
+			coveredCount += object.bCovered ? 1 : 0;
+		}
+		if (coveredCount > 0)
+		{
+			std::cout << "[SceneManager] " << coveredCount << " object(s) drawn exactly over by an earlier one are skipped" << std::endl;
+		}
 
+		g_renderQueue.reserve(g_sceneDraws.size());
+		g_renderQueueScratch.reserve(g_sceneDraws.size());
 
+		// the state changes drawing in file order would cost
+		g_fileOrderChanges = RenderStateCounter();
+		for (const SCENE_DRAW& draw : g_sceneDraws)
+		{
+			g_fileOrderChanges.Submit(draw);
+		}
+	}
 
-	//----------------------------------------------------------------------------
-	scaleXYZ = glm::vec3(0.5f, 0.2f, 0.5f);
+	/***********************************************************
+	 *  SortRenderQueue()
+	 *
+	 *  This function is used for filling the render queue with
+	 *  the keys of every visible draw and sorting it for this
+	 *  frame, with the transparent draws last and sorted for
+	 *  the passed in camera view.
+	 ***********************************************************/
+	void SortRenderQueue(const glm::mat4& view)
+	{
+		g_renderQueue.clear();
+		for (size_t i = 0; i < g_sceneDraws.size(); i++)
+		{
+			int object = g_sceneDraws[i].object;
+			if ((g_sceneObjects[object].instanceGroup < 0) && !g_sceneObjects[object].bCovered && g_objectVisible[object])
+			{
+				g_renderQueue.push_back(MakeSortKey(static_cast<int>(i), view));
+			}
+		}
+		RadixSortKeys(g_renderQueue, g_renderQueueScratch);
+	}
 
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 90.0f;
-	ZrotationDegrees = 0.0f;
+	/***********************************************************
+	 *  ReportRenderQueue()
+	 *
+	 *  This function is used for logging the state changes per
+	 *  frame before and after sorting the render queue.
+	 ***********************************************************/
+	void ReportRenderQueue()
+	{
+		unsigned long long frames = g_queueChanges.frames;
+		if (frames == 0)
+		{
+			return;
+		}
+		std::cout << "[SceneManager] Render queue per frame (file order -> sorted): "
+			<< g_fileOrderChanges.calls << " -> " << (g_queueChanges.calls / frames) << " draw calls, "
+			<< g_fileOrderChanges.textures << " -> " << (g_queueChanges.textures / frames) << " textures, "
+			<< g_fileOrderChanges.materials << " -> " << (g_queueChanges.materials / frames) << " materials, "
+			<< g_fileOrderChanges.meshes << " -> " << (g_queueChanges.meshes / frames) << " meshes, "
+			<< g_fileOrderChanges.blends << " -> " << (g_queueChanges.blends / frames) << " blend" << std::endl;
+	}
 
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(1.5f, 2.0f, 2.0f);
+	/***********************************************************
+	 *  BuildGeometryPoolDraws()
+	 *
+	 *  This function is used for turning the instance groups
+	 *  into the indirect draw commands of the opaque pass. The
+	 *  opaque order never changes from frame to frame, so the
+	 *  commands are sorted once here. Each command gets its own
+	 *  range of the instance table, which pairs the record of
+	 *  each member with the texture layers of its faces.
+	 ***********************************************************/
+	void BuildGeometryPoolDraws()
+	{
+		g_drawCommands.clear();
+		g_instanceTable.clear();
+		g_instanceTextures.clear();
+		g_instanceObjects.clear();
+		if ((g_poolProgram == 0) && !CreateGeometryPool())
+		{
+			return;
+		}
+		BuildInstanceGroups();
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+		std::vector<uint64_t> keys;
+		std::vector<uint64_t> scratch;
+		for (size_t i = 0; i < g_instanceDraws.size(); i++)
+		{
+			keys.push_back(MakeInstanceSortKey(static_cast<int>(i)));
+		}
+		RadixSortKeys(keys, scratch);
 
-	SetShaderColor(0.0f, 0.0f, 0.0f, 1.0f);
-	SetShaderMaterial("metal");
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh();
+		for (uint64_t key : keys)
+		{
+			const INSTANCE_DRAW& draw = g_instanceDraws[key & SORT_DRAW_MASK];
+			const INSTANCE_GROUP& group = g_instanceGroups[draw.group];
+			const MESH_GEOMETRY& geometry = g_meshGeometry[group.mesh];
+
+			DRAW_COMMAND command;
+			command.count = geometry.partCount[draw.part];
+			command.instanceCount = static_cast<GLuint>(group.objects.size());
+			command.firstIndex = geometry.partFirst[draw.part];
+			command.baseVertex = geometry.baseVertex;
+			command.baseInstance = static_cast<GLuint>(g_instanceTable.size());
+			g_drawCommands.push_back(command);
+
+			for (size_t i = 0; i < group.objects.size(); i++)
+			{
+				INSTANCE_ENTRY entry;
+				entry.record = group.baseInstance + static_cast<GLint>(i);
+				PackFaceLayers(entry, draw.faceTextures);
+				g_instanceTable.push_back(entry);
+				g_instanceTextures.insert(g_instanceTextures.end(), draw.faceTextures, draw.faceTextures + MESH_FACE_COUNT);
+				g_instanceObjects.push_back(group.objects[i]);
+			}
+		}
 
-	//SetShaderColor(1, 1, 1, 1);
+		// the instance table and commands are uploaded by
+		// CompactPoolDraws() once the visible objects are known
+		g_bInstanceTableDirty = true;
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, g_recordBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, g_objectRecords.size() * sizeof(OBJECT_RECORD), g_objectRecords.data(), GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		g_shadowMaps.BuildCasters();
 
-	//m_basicMeshes->DrawBoxMeshLines();
+		std::cout << "[SceneManager] Geometry pool: " << g_objectRecords.size() << " object(s) in "
+			<< g_instanceGroups.size() << " group(s), " << g_drawCommands.size() << " command(s)" << std::endl;
+	}
 
+	/***********************************************************
+	 *  CompactPoolDraws()
+	 *
+	 *  This function is used for dropping the culled objects
+	 *  from the pool's draw commands. Each command keeps only
+	 *  the instance table entries of visible objects, and
+	 *  commands left without instances are skipped. Nothing is
+	 *  uploaded while the visibility stays the same.
+	 ***********************************************************/
+	void CompactPoolDraws()
+	{
+		if (!g_bVisibilityChanged && !g_bInstanceTableDirty)
+		{
+			return;
+		}
+		g_visibleCommands.clear();
+		g_visibleTable.clear();
+		for (const DRAW_COMMAND& command : g_drawCommands)
+		{
+			DRAW_COMMAND visible = command;
+			visible.baseInstance = static_cast<GLuint>(g_visibleTable.size());
+			for (GLuint i = command.baseInstance; i < command.baseInstance + command.instanceCount; i++)
+			{
+				if (g_objectVisible[g_instanceObjects[i]])
+				{
+					g_visibleTable.push_back(g_instanceTable[i]);
+				}
+			}
+			visible.instanceCount = static_cast<GLuint>(g_visibleTable.size()) - visible.baseInstance;
+			if (visible.instanceCount > 0)
+			{
+				g_visibleCommands.push_back(visible);
+			}
+		}
 
-	//----------------------------------------------------------------------------
-	scaleXYZ = glm::vec3(0.5f, 0.2f, 0.5f);
+		glBindBuffer(GL_ARRAY_BUFFER, g_instanceTableBuffer);
+		glBufferData(GL_ARRAY_BUFFER, g_visibleTable.size() * sizeof(INSTANCE_ENTRY), g_visibleTable.data(), GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, g_commandBuffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, g_visibleCommands.size() * sizeof(DRAW_COMMAND), g_visibleCommands.data(), GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		g_bInstanceTableDirty = false;
+		g_bVisibilityChanged = false;
+	}
 
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 90.0f;
-	ZrotationDegrees = 0.0f;
+	/***********************************************************
+	 *  DrawGeometryPool()
+	 *
+	 *  This function is used for drawing every visible opaque
+	 *  object with a single multi-draw. The CPU cost does not
+	 *  depend on the number of objects, only on the dynamic
+	 *  records that are updated. The shadow maps are brought
+	 *  up to date first, once the records have moved.
+	 ***********************************************************/
+	void DrawGeometryPool()
+	{
+		if (g_drawCommands.empty())
+		{
+			return;
+		}
+		UpdateObjectRecords();
+		g_shadowMaps.Update();
+		CompactPoolDraws();
+		if (g_visibleCommands.empty())
+		{
+			return;
+		}
 
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(5.0f, 2.0f, 2.0f);
+		glUseProgram(g_poolProgram);
+		SyncSharedUniforms(g_uniformCache.Program());
+		g_poolUniforms.SetInt(g_TextureArrayUniform, g_TextureArrayUnit);
+		g_shadowMaps.Apply(g_poolUniforms);
+		g_queueChanges.Submit(STATE_PER_RECORD, STATE_PER_RECORD, STATE_PER_RECORD, false);
+
+		glBindVertexArray(g_poolVao);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, g_commandBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, g_recordBuffer);
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)0,
+			static_cast<GLsizei>(g_visibleCommands.size()), 0);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		glBindVertexArray(0);
+
+		glUseProgram(g_uniformCache.Program());
+	}
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+	/***********************************************************
+	 *  ShowPoolTexture()
+	 *
+	 *  This function is used for switching the faces that name
+	 *  a texture from their record color to the texture array
+	 *  layer, once the texture is resident.
+	 ***********************************************************/
+	void ShowPoolTexture(int textureHandle)
+	{
+		for (size_t i = 0; i < g_instanceTable.size(); i++)
+		{
+			const int* faceTextures = &g_instanceTextures[i * MESH_FACE_COUNT];
+			if (std::find(faceTextures, faceTextures + MESH_FACE_COUNT, textureHandle) != faceTextures + MESH_FACE_COUNT)
+			{
+				PackFaceLayers(g_instanceTable[i], faceTextures);
+				g_bInstanceTableDirty = true;
+			}
+		}
+	}
 
-	SetShaderColor(0.0f, 0.0f, 0.0f, 1.0f);
-	SetShaderMaterial("metal");
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh();
+	/***********************************************************
+	 *  PumpTextureLoads()
+	 *
+	 *  This function is used for uploading the textures the
+	 *  decode workers have finished. Only a few are uploaded
+	 *  per frame so that no frame stalls on a burst of uploads.
+	 ***********************************************************/
+	void PumpTextureLoads()
+	{
+		if (g_uploadedLoads == g_textureLoads.size())
+		{
+			return;
+		}
+		g_textureLoadFrames++;
 
-	//SetShaderColor(1, 1, 1, 1);
+		int ready[g_TextureUploadsPerFrame];
+		int readyCount = 0;
+		{
+			std::lock_guard<std::mutex> lock(g_decodedMutex);
+			while ((readyCount < g_TextureUploadsPerFrame) && !g_decodedLoads.empty())
+			{
+				ready[readyCount++] = g_decodedLoads.back();
+				g_decodedLoads.pop_back();
+			}
+		}
 
-	//m_basicMeshes->DrawBoxMeshLines();
+		for (int i = 0; i < readyCount; i++)
+		{
+			TEXTURE_LOAD& load = g_textureLoads[ready[i]];
+			if (UploadTextureLoad(load))
+			{
+				g_textureResident[load.handle] = 1;
+				ShowPoolTexture(load.handle);
+			}
+			if (load.bReady && load.bFromCache)
+			{
+				g_cachedLoads++;
+			}
+			std::vector<unsigned char>().swap(load.pixels);
+			load.mapping.reset();
+			load.data = nullptr;
+			g_uploadedLoads++;
+		}
 
+		if (g_uploadedLoads == g_textureLoads.size())
+		{
+			for (std::thread& worker : g_decodeWorkers)
+			{
+				worker.join();
+			}
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - g_textureLoadStart;
+			std::cout << "[SceneManager] Textures: " << g_textureLoads.size() << " loaded on " << g_decodeWorkers.size()
+				<< " thread(s), " << g_cachedLoads << " from the cache, resident after " << elapsed.count() << " ms and " << g_textureLoadFrames
+				<< " frame(s)" << std::endl;
+			g_decodeWorkers.clear();
+		}
+	}
 
-	//----------------------------------------------------------------------------
-	scaleXYZ = glm::vec3(0.5f, 0.2f, 0.5f);
+	// every static object of the geometry pool gets a square tile of
+	// one lightmap atlas, sized by its surface area. The lightmap is
+	// baked on worker threads at startup and kept on disk, and the
+	// objects use the light loop until it arrives. It holds what the
+	// light loop would give without the view dependent specular term,
+	// with shadows and one bounce added, so a light changed at run
+	// time is not seen on the static objects until the next bake.
+	const char* g_LightmapCacheFolder = "lightmap_cache";
+	const char g_LightmapCacheMagic[4] = { 'S', 'L', 'M', 'C' };
+	const uint32_t g_LightmapCacheVersion = 1;
+	const int g_LightmapUnit = 17;          // the binding in the pool shader
+	const int LIGHTMAP_ATLAS_WIDTH = 1024;
+	const float LIGHTMAP_TEXELS_PER_UNIT = 3.0f;
+	const int LIGHTMAP_MAX_TILE = 256;
+	const int LIGHTMAP_INDIRECT_SAMPLES = 16;
+	const int LIGHTMAP_TASK_ROWS = 8;       // atlas rows per bake task
+	const int LIGHTMAP_DILATE_PASSES = 4;
+
+	// the header of the lightmap cache file - RGB floats follow it.
+	// The hash covers everything the bake reads.
+	struct LIGHTMAP_CACHE_HEADER
+	{
+		char magic[4];
+		uint32_t version;
+		uint64_t sceneHash;
+		int32_t width;
+		int32_t height;
+		uint64_t dataBytes;
+	};
+
+	// a world space triangle of a static object
+	struct BAKE_TRIANGLE
+	{
+		glm::vec3 position[3];
+		glm::vec3 normal[3];
+		glm::vec2 atlas[3];         // lightmap texel coordinates
+		int object;
+	};
+
+	// a static object the bake's rays can hit; objects outside the
+	// geometry pool cast shadows without a tile of their own
+	struct BAKE_OBJECT
+	{
+		int sceneObject;
+		int record;                 // its object record, -1 for none
+		int tileX;
+		int tileY;
+		int tileSize;               // 0 for no tile
+		glm::vec3 albedo;           // color times material diffuse
+		glm::vec3 diffuse;          // material diffuse
+	};
+
+	// the input and output of one bake, owned by the bake thread
+	// until g_bBakeDone is set
+	struct LIGHTMAP_BAKE
+	{
+		std::vector<BAKE_OBJECT> objects;
+		std::vector<BAKE_TRIANGLE> triangles;
+		std::vector<SCENE_LIGHT> lights;
+		int width;
+		int height;
+		uint64_t sceneHash;
+		std::vector<int> texelTriangle;         // -1 where no chart covers the texel
+		std::vector<glm::vec3> texelPosition;
+		std::vector<glm::vec3> texelNormal;
+		std::vector<glm::vec3> direct;          // light reaching each texel
+		std::vector<float> texels;              // the RGB result
+		bool bFromCache;
+		unsigned int threads;
+		unsigned long long steals;
+		double milliseconds;
+	};
+
+	std::unique_ptr<LIGHTMAP_BAKE> g_lightmapBake;
+	std::thread g_bakeThread;
+	std::atomic<bool> g_bBakeDone(false);
+	std::atomic<bool> g_bStopBaking(false);
+	GLuint g_lightmapTexture = 0;
+
+	/***********************************************************
+	 *  WorkStealingPool
+	 *
+	 *  Runs a batch of numbered tasks on a set of threads, the
+	 *  calling one included. The tasks are dealt out to a queue
+	 *  per thread up front; a thread takes from the back of its
+	 *  own queue and, once that is empty, steals from the front
+	 *  of the others, so the threads that drew cheap tasks take
+	 *  over the work of those that drew expensive ones.
+	 ***********************************************************/
+	class WorkStealingPool
+	{
+	public:
+		explicit WorkStealingPool(unsigned int threads) : m_steals(0)
+		{
+			for (unsigned int i = 0; i < std::max(1u, threads); i++)
+			{
+				m_queues.emplace_back(new TASK_QUEUE());
+			}
+		}
 
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 90.0f;
-	ZrotationDegrees = 0.0f;
+		// returns once every task has run
+		template <class Task>
+		void Run(int taskCount, Task task)
+		{
+			for (int i = 0; i < taskCount; i++)
+			{
+				m_queues[i % m_queues.size()]->tasks.push_back(i);
+			}
+			std::vector<std::thread> threads;
+			for (size_t i = 1; i < m_queues.size(); i++)
+			{
+				threads.emplace_back([this, i, &task]() { Work(i, task); });
+			}
+			Work(0, task);
+			for (std::thread& thread : threads)
+			{
+				thread.join();
+			}
+		}
 
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-2.0f, 2.0f, 2.0f);
+		unsigned int Threads() const
+		{
+			return(static_cast<unsigned int>(m_queues.size()));
+		}
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+		unsigned long long Steals() const
+		{
+			return(m_steals);
+		}
 
-	SetShaderColor(0.0f, 0.0f, 0.0f, 1.0f);
-	SetShaderMaterial("metal");
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh();
+	private:
+		struct TASK_QUEUE
+		{
+			std::mutex mutex;
+			std::deque<int> tasks;
+		};
 
-	//SetShaderColor(1, 1, 1, 1);
+		template <class Task>
+		void Work(size_t self, Task& task)
+		{
+			int next = 0;
+			while (Take(self, next))
+			{
+				task(next);
+			}
+		}
 
-	//m_basicMeshes->DrawBoxMeshLines();
+		bool Take(size_t self, int& task)
+		{
+			{
+				TASK_QUEUE& own = *m_queues[self];
+				std::lock_guard<std::mutex> lock(own.mutex);
+				if (!own.tasks.empty())
+				{
+					task = own.tasks.back();
+					own.tasks.pop_back();
+					return(true);
+				}
+			}
+			for (size_t i = 1; i < m_queues.size(); i++)
+			{
+				TASK_QUEUE& victim = *m_queues[(self + i) % m_queues.size()];
+				std::lock_guard<std::mutex> lock(victim.mutex);
+				if (!victim.tasks.empty())
+				{
+					task = victim.tasks.front();
+					victim.tasks.pop_front();
+					m_steals++;
+					return(true);
+				}
+			}
+			return(false);
+		}
 
+		std::vector<std::unique_ptr<TASK_QUEUE>> m_queues;
+		std::atomic<unsigned long long> m_steals;
+	};
+
+	/***********************************************************
+	 *  RayHitsTriangle()
+	 *
+	 *  This function is used for intersecting a ray with either
+	 *  side of a triangle, giving the distance and barycentric
+	 *  coordinates of a hit closer than maxDistance.
+	 ***********************************************************/
+	bool RayHitsTriangle(const glm::vec3& origin, const glm::vec3& direction, const BAKE_TRIANGLE& triangle,
+		float maxDistance, float& distance, float& u, float& v)
+	{
+		glm::vec3 edge1 = triangle.position[1] - triangle.position[0];
+		glm::vec3 edge2 = triangle.position[2] - triangle.position[0];
+		glm::vec3 p = glm::cross(direction, edge2);
+		float determinant = glm::dot(edge1, p);
+		if (fabsf(determinant) < 1e-12f)
+		{
+			return(false);
+		}
+		float inverse = 1.0f / determinant;
+		glm::vec3 s = origin - triangle.position[0];
+		u = glm::dot(s, p) * inverse;
+		if ((u < 0.0f) || (u > 1.0f))
+		{
+			return(false);
+		}
+		glm::vec3 q = glm::cross(s, edge1);
+		v = glm::dot(direction, q) * inverse;
+		if ((v < 0.0f) || (u + v > 1.0f))
+		{
+			return(false);
+		}
+		distance = glm::dot(edge2, q) * inverse;
+		return((distance > 0.0f) && (distance < maxDistance));
+	}
 
-	//------------------------------------------------------------------------------------------------
+	/***********************************************************
+	 *  LightmapTracer
+	 *
+	 *  The bake's view of the static scene - a hierarchy over
+	 *  its triangles, and the direct lighting of a point as the
+	 *  pool shader computes it, with a shadow ray to each light.
+	 ***********************************************************/
+	class LightmapTracer
+	{
+	public:
+		explicit LightmapTracer(const LIGHTMAP_BAKE& bake) : m_bake(bake)
+		{
+			int count = static_cast<int>(bake.triangles.size());
+			for (int axis = 0; axis < 3; axis++)
+			{
+				m_center[axis].resize(count);
+				m_extent[axis].resize(count);
+			}
+			for (int i = 0; i < count; i++)
+			{
+				const BAKE_TRIANGLE& triangle = bake.triangles[i];
+				glm::vec3 low = glm::min(glm::min(triangle.position[0], triangle.position[1]), triangle.position[2]);
+				glm::vec3 high = glm::max(glm::max(triangle.position[0], triangle.position[1]), triangle.position[2]);
+				for (int axis = 0; axis < 3; axis++)
+				{
+					m_center[axis][i] = (low[axis] + high[axis]) * 0.5f;
+					m_extent[axis][i] = (high[axis] - low[axis]) * 0.5f;
+				}
+			}
+			m_bvh.Build(m_center, m_extent, count);
+		}
 
-	scaleXYZ = glm::vec3(1.2f, 0.2f, 1.2f);
+		// the nearest triangle along the ray, or -1
+		int Trace(const glm::vec3& origin, const glm::vec3& direction, float& distance, float& u, float& v) const
+		{
+			float hitU = 0.0f;
+			float hitV = 0.0f;
+			int hit = m_bvh.Raycast(origin, direction, distance, [&](int triangle, float& nearest) {
+				float t = 0.0f;
+				float a = 0.0f;
+				float b = 0.0f;
+				if (!RayHitsTriangle(origin, direction, m_bake.triangles[triangle], nearest, t, a, b))
+				{
+					return(false);
+				}
+				nearest = t;
+				hitU = a;
+				hitV = b;
+				return(true);
+				});
+			u = hitU;
+			v = hitV;
+			return(hit);
+		}
 
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 90.0f;
-	ZrotationDegrees = 0.0f;
+		// the light reaching a point, before its material
+		glm::vec3 DirectLight(const glm::vec3& position, const glm::vec3& normal) const
+		{
+			glm::vec3 light(0.0f);
+			glm::vec3 origin = position + normal * 1e-3f;
+			for (const SCENE_LIGHT& source : m_bake.lights)
+			{
+				glm::vec3 toLight = glm::vec3(source.position) - origin;
+				float distance = glm::length(toLight);
+				float range = source.diffuse.w;
+				if ((source.position.w == 0.0f) || ((range > 0.0f) && (distance >= range)))
+				{
+					continue;
+				}
+				glm::vec3 direction = toLight / distance;
+				float impact = glm::dot(normal, direction);
+				if (impact <= 0.0f)
+				{
+					continue;
+				}
+				float u = 0.0f;
+				float v = 0.0f;
+				float blocked = distance;
+				if (Trace(origin, direction, blocked, u, v) >= 0)
+				{
+					continue;
+				}
+				light = light + glm::vec3(source.diffuse) * (impact * Attenuation(source, distance));
+			}
+			return(light);
+		}
 
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(1.5f, 1.9f, 2.0f);
+		// the ambient terms of the lights, which the shader never shadows
+		glm::vec3 AmbientLight(const glm::vec3& position) const
+		{
+			glm::vec3 light(0.0f);
+			for (const SCENE_LIGHT& source : m_bake.lights)
+			{
+				if (source.position.w != 0.0f)
+				{
+					float distance = glm::length(glm::vec3(source.position) - position);
+					light = light + glm::vec3(source.ambient) * Attenuation(source, distance);
+				}
+			}
+			return(light);
+		}
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+	private:
+		// the fall off the pool shader gives lights with a range
+		static float Attenuation(const SCENE_LIGHT& source, float distance)
+		{
+			float range = source.diffuse.w;
+			if (range <= 0.0f)
+			{
+				return(1.0f);
+			}
+			float ratio = distance / range;
+			float window = std::max(0.0f, 1.0f - ratio * ratio * ratio * ratio);
+			return(window * window / (1.0f + distance * distance));
+		}
 
-	SetShaderColor(0.3f, 0.95f, 1.0f, 1.0f);
+		const LIGHTMAP_BAKE& m_bake;
+		std::vector<float> m_center[3];
+		std::vector<float> m_extent[3];
+		BoundingVolumeHierarchy m_bvh;
+	};
+
+	/***********************************************************
+	 *  RasterizeLightmap()
+	 *
+	 *  This function is used for finding the triangle, world
+	 *  position and normal behind the center of every texel of
+	 *  the atlas the charts cover.
+	 ***********************************************************/
+	void RasterizeLightmap(LIGHTMAP_BAKE& bake)
+	{
+		size_t texelCount = static_cast<size_t>(bake.width) * bake.height;
+		bake.texelTriangle.assign(texelCount, -1);
+		bake.texelPosition.assign(texelCount, glm::vec3(0.0f));
+		bake.texelNormal.assign(texelCount, glm::vec3(0.0f));
+		for (size_t i = 0; i < bake.triangles.size(); i++)
+		{
+			const BAKE_TRIANGLE& triangle = bake.triangles[i];
+			if (bake.objects[triangle.object].tileSize == 0)
+			{
+				continue;
+			}
+			const glm::vec2* a = triangle.atlas;
+			float area = (a[1].x - a[0].x) * (a[2].y - a[0].y) - (a[2].x - a[0].x) * (a[1].y - a[0].y);
+			if (fabsf(area) < 1e-8f)
+			{
+				continue;
+			}
+			int x0 = std::max(0, static_cast<int>(std::floor(std::min(std::min(a[0].x, a[1].x), a[2].x))));
+			int x1 = std::min(bake.width - 1, static_cast<int>(std::ceil(std::max(std::max(a[0].x, a[1].x), a[2].x))));
+			int y0 = std::max(0, static_cast<int>(std::floor(std::min(std::min(a[0].y, a[1].y), a[2].y))));
+			int y1 = std::min(bake.height - 1, static_cast<int>(std::ceil(std::max(std::max(a[0].y, a[1].y), a[2].y))));
+			for (int y = y0; y <= y1; y++)
+			{
+				for (int x = x0; x <= x1; x++)
+				{
+					glm::vec2 p(x + 0.5f, y + 0.5f);
+					float w1 = ((p.x - a[0].x) * (a[2].y - a[0].y) - (a[2].x - a[0].x) * (p.y - a[0].y)) / area;
+					float w2 = ((a[1].x - a[0].x) * (p.y - a[0].y) - (p.x - a[0].x) * (a[1].y - a[0].y)) / area;
+					float w0 = 1.0f - w1 - w2;
+					if ((w0 < 0.0f) || (w1 < 0.0f) || (w2 < 0.0f))
+					{
+						continue;
+					}
+					size_t texel = static_cast<size_t>(y) * bake.width + x;
+					bake.texelTriangle[texel] = static_cast<int>(i);
+					bake.texelPosition[texel] = triangle.position[0] * w0 + triangle.position[1] * w1 + triangle.position[2] * w2;
+					bake.texelNormal[texel] = glm::normalize(triangle.normal[0] * w0 + triangle.normal[1] * w1 + triangle.normal[2] * w2);
+				}
+			}
+		}
+	}
 
+	/***********************************************************
+	 *  DilateLightmap()
+	 *
+	 *  This function is used for growing the baked texels of
+	 *  each tile into the gutter texels around them, so that
+	 *  filtering at the edge of a chart does not pick up black.
+	 ***********************************************************/
+	void DilateLightmap(LIGHTMAP_BAKE& bake)
+	{
+		std::vector<char> filled(bake.texelTriangle.size());
+		for (size_t i = 0; i < filled.size(); i++)
+		{
+			filled[i] = (bake.texelTriangle[i] >= 0);
+		}
+		for (int pass = 0; pass < LIGHTMAP_DILATE_PASSES; pass++)
+		{
+			std::vector<char> grown = filled;
+			for (const BAKE_OBJECT& object : bake.objects)
+			{
+				for (int y = object.tileY; y < object.tileY + object.tileSize; y++)
+				{
+					for (int x = object.tileX; x < object.tileX + object.tileSize; x++)
+					{
+						size_t texel = static_cast<size_t>(y) * bake.width + x;
+						if (filled[texel])
+						{
+							continue;
+						}
+						float sum[3] = { 0.0f, 0.0f, 0.0f };
+						int count = 0;
+						for (int dy = -1; dy <= 1; dy++)
+						{
+							for (int dx = -1; dx <= 1; dx++)
+							{
+								int nx = x + dx;
+								int ny = y + dy;
+								if ((nx < object.tileX) || (ny < object.tileY) ||
+									(nx >= object.tileX + object.tileSize) || (ny >= object.tileY + object.tileSize))
+								{
+									continue;
+								}
+								size_t neighbor = static_cast<size_t>(ny) * bake.width + nx;
+								if (filled[neighbor])
+								{
+									for (int c = 0; c < 3; c++)
+									{
+										sum[c] += bake.texels[neighbor * 3 + c];
+									}
+									count++;
+								}
+							}
+						}
+						if (count > 0)
+						{
+							for (int c = 0; c < 3; c++)
+							{
+								bake.texels[texel * 3 + c] = sum[c] / count;
+							}
+							grown[texel] = 1;
+						}
+					}
+				}
+			}
+			filled.swap(grown);
+		}
+	}
 
-	SetShaderMaterial("metal");
+	/***********************************************************
+	 *  ReadLightmapCache()
+	 *
+	 *  This function is used for loading the lightmap from its
+	 *  cache file, if that was baked from the same scene.
+	 ***********************************************************/
+	bool ReadLightmapCache(LIGHTMAP_BAKE& bake, const std::string& cachePath)
+	{
+		MappedFile mapping;
+		if (!mapping.Open(cachePath) || (mapping.Size() < sizeof(LIGHTMAP_CACHE_HEADER)))
+		{
+			return(false);
+		}
+		LIGHTMAP_CACHE_HEADER header;
+		memcpy(&header, mapping.Data(), sizeof(header));
+		size_t dataBytes = static_cast<size_t>(bake.width) * bake.height * 3 * sizeof(float);
+		if ((memcmp(header.magic, g_LightmapCacheMagic, sizeof(header.magic)) != 0) ||
+			(header.version != g_LightmapCacheVersion) || (header.sceneHash != bake.sceneHash) ||
+			(header.width != bake.width) || (header.height != bake.height) ||
+			(header.dataBytes != dataBytes) || (dataBytes > mapping.Size() - sizeof(header)))
+		{
+			return(false);
+		}
+		bake.texels.resize(dataBytes / sizeof(float));
+		memcpy(bake.texels.data(), mapping.Data() + sizeof(header), dataBytes);
+		return(true);
+	}
 
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh();
+	/***********************************************************
+	 *  WriteLightmapCache()
+	 *
+	 *  This function is used for saving a baked lightmap. A file
+	 *  that cannot be written only costs the next start a bake.
+	 ***********************************************************/
+	void WriteLightmapCache(const LIGHTMAP_BAKE& bake, const std::string& cachePath)
+	{
+		LIGHTMAP_CACHE_HEADER header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, g_LightmapCacheMagic, sizeof(header.magic));
+		header.version = g_LightmapCacheVersion;
+		header.sceneHash = bake.sceneHash;
+		header.width = bake.width;
+		header.height = bake.height;
+		header.dataBytes = bake.texels.size() * sizeof(float);
+
+		// written under a temporary name first so that a reader
+		// never maps a half written file
+		std::string tempPath = cachePath + ".tmp";
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(bake.texels.data()), static_cast<std::streamsize>(header.dataBytes));
+		file.close();
+		std::remove(cachePath.c_str());
+		if (!file || (std::rename(tempPath.c_str(), cachePath.c_str()) != 0))
+		{
+			std::remove(tempPath.c_str());
+		}
+	}
 
-	//SetShaderColor(1, 1, 1, 1);
+	/***********************************************************
+	 *  BakeLightmap()
+	 *
+	 *  This function is used as the body of the bake thread. The
+	 *  direct light of every texel is traced first; the second
+	 *  pass adds one bounce, gathering with cosine weighted rays
+	 *  the direct light of whatever they hit, read back from the
+	 *  first pass where the hit has a tile. Both passes share
+	 *  bands of atlas rows out through a work stealing pool, and
+	 *  every texel seeds its own random numbers, so the result
+	 *  does not depend on the thread count.
+	 ***********************************************************/
+	void BakeLightmap(LIGHTMAP_BAKE* bakePointer)
+	{
+		LIGHTMAP_BAKE& bake = *bakePointer;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		std::string cachePath = std::string(g_LightmapCacheFolder) + "/scene.lightmap";
+		bake.bFromCache = ReadLightmapCache(bake, cachePath);
+		if (bake.bFromCache)
+		{
+			bake.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			g_bBakeDone = true;
+			return;
+		}
 
-	//m_basicMeshes->DrawBoxMeshLines();
+		RasterizeLightmap(bake);
+		LightmapTracer tracer(bake);
+		WorkStealingPool pool(std::thread::hardware_concurrency());
+		int tasks = (bake.height + LIGHTMAP_TASK_ROWS - 1) / LIGHTMAP_TASK_ROWS;
+		bake.direct.assign(bake.texelTriangle.size(), glm::vec3(0.0f));
+		bake.texels.assign(bake.texelTriangle.size() * 3, 0.0f);
+
+		pool.Run(tasks, [&](int task) {
+			for (int y = task * LIGHTMAP_TASK_ROWS; (y < std::min(bake.height, (task + 1) * LIGHTMAP_TASK_ROWS)) && !g_bStopBaking; y++)
+			{
+				for (int x = 0; x < bake.width; x++)
+				{
+					size_t texel = static_cast<size_t>(y) * bake.width + x;
+					if (bake.texelTriangle[texel] >= 0)
+					{
+						bake.direct[texel] = tracer.DirectLight(bake.texelPosition[texel], bake.texelNormal[texel]);
+					}
+				}
+			}
+			});
+
+		pool.Run(tasks, [&](int task) {
+			for (int y = task * LIGHTMAP_TASK_ROWS; (y < std::min(bake.height, (task + 1) * LIGHTMAP_TASK_ROWS)) && !g_bStopBaking; y++)
+			{
+				for (int x = 0; x < bake.width; x++)
+				{
+					size_t texel = static_cast<size_t>(y) * bake.width + x;
+					if (bake.texelTriangle[texel] < 0)
+					{
+						continue;
+					}
+					const glm::vec3& position = bake.texelPosition[texel];
+					const glm::vec3& normal = bake.texelNormal[texel];
+					glm::vec3 tangent = glm::normalize(glm::cross((fabsf(normal.x) > 0.5f) ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f), normal));
+					glm::vec3 bitangent = glm::cross(normal, tangent);
+					uint32_t random = static_cast<uint32_t>(texel) * 2654435761u + 1u;
+					auto nextRandom = [&random]() {
+						random ^= random << 13;
+						random ^= random >> 17;
+						random ^= random << 5;
+						return(static_cast<float>(random >> 8) / 16777216.0f);
+						};
+
+					glm::vec3 bounce(0.0f);
+					for (int sample = 0; sample < LIGHTMAP_INDIRECT_SAMPLES; sample++)
+					{
+						float radius = std::sqrt(nextRandom());
+						float angle = 6.2831853f * nextRandom();
+						glm::vec3 direction = glm::normalize(tangent * (radius * cosf(angle)) + bitangent * (radius * sinf(angle)) +
+							normal * std::sqrt(std::max(0.0f, 1.0f - radius * radius)));
+						float distance = std::numeric_limits<float>::max();
+						float u = 0.0f;
+						float v = 0.0f;
+						int hit = tracer.Trace(position + normal * 1e-3f, direction, distance, u, v);
+						if (hit < 0)
+						{
+							continue;
+						}
+						const BAKE_TRIANGLE& triangle = bake.triangles[hit];
+						const BAKE_OBJECT& object = bake.objects[triangle.object];
+						glm::vec3 light(0.0f);
+						int hitTexel = -1;
+						if (object.tileSize > 0)
+						{
+							glm::vec2 atlas = triangle.atlas[0] * (1.0f - u - v) + triangle.atlas[1] * u + triangle.atlas[2] * v;
+							int hx = std::min(std::max(static_cast<int>(atlas.x), 0), bake.width - 1);
+							int hy = std::min(std::max(static_cast<int>(atlas.y), 0), bake.height - 1);
+							hitTexel = hy * bake.width + hx;
+						}
+						if ((hitTexel >= 0) && (bake.texelTriangle[hitTexel] >= 0))
+						{
+							light = bake.direct[hitTexel];
+						}
+						else
+						{
+							glm::vec3 hitPosition = position + direction * distance;
+							glm::vec3 hitNormal = glm::normalize(glm::cross(triangle.position[1] - triangle.position[0],
+								triangle.position[2] - triangle.position[0]));
+							light = tracer.DirectLight(hitPosition, (glm::dot(hitNormal, direction) > 0.0f) ? -hitNormal : hitNormal);
+						}
+						bounce = bounce + object.albedo * light;
+					}
+					bounce = bounce / static_cast<float>(LIGHTMAP_INDIRECT_SAMPLES);
+
+					const BAKE_OBJECT& object = bake.objects[bake.triangles[bake.texelTriangle[texel]].object];
+					glm::vec3 result = tracer.AmbientLight(position) + object.diffuse * (bake.direct[texel] + bounce);
+					for (int c = 0; c < 3; c++)
+					{
+						bake.texels[texel * 3 + c] = result[c];
+					}
+				}
+			}
+			});
+
+		bake.threads = pool.Threads();
+		bake.steals = pool.Steals();
+		if (!g_bStopBaking)
+		{
+			DilateLightmap(bake);
+			CreateTextureFolder(g_LightmapCacheFolder);
+			WriteLightmapCache(bake, cachePath);
+		}
+		bake.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		g_bBakeDone = true;
+	}
 
+	/***********************************************************
+	 *  StartLightmapBake()
+	 *
+	 *  This function is used for gathering what the bake needs
+	 *  from the scene - the static objects, their triangles in
+	 *  world space and the lights - laying out the atlas and
+	 *  starting the bake thread. Runs after
+	 *  BuildGeometryPoolDraws(), which numbers the records.
+	 ***********************************************************/
+	void StartLightmapBake()
+	{
+		if (g_poolProgram == 0)
+		{
+			return;
+		}
+		std::unique_ptr<LIGHTMAP_BAKE> bake(new LIGHTMAP_BAKE());
+		bake->lights.assign(&g_sceneLights.Light(0), &g_sceneLights.Light(0) + g_sceneLights.Count());
+		bake->bFromCache = false;
+		bake->threads = 0;
+		bake->steals = 0;
+		bake->milliseconds = 0.0;
+
+		std::vector<int> recordOf(g_sceneObjects.size(), -1);
+		for (const INSTANCE_GROUP& group : g_instanceGroups)
+		{
+			for (size_t i = 0; i < group.objects.size(); i++)
+			{
+				recordOf[group.objects[i]] = group.baseInstance + static_cast<int>(i);
+			}
+		}
 
-	//------------------------------------------------------------------------------------------------
+		MeshBuilder meshes[SCENE_MESH_COUNT];
+		MESH_GEOMETRY geometry[SCENE_MESH_COUNT];
+		for (int mesh = 0; mesh < SCENE_MESH_COUNT; mesh++)
+		{
+			BuildMeshGeometry(static_cast<SCENE_MESH>(mesh), meshes[mesh], geometry[mesh]);
+		}
 
-	scaleXYZ = glm::vec3(1.2f, 0.2f, 1.2f);
+		// the static, opaque objects, with their tile sizes; the
+		// triangles keep their tile coordinates until the atlas is laid out
+		std::vector<float> surfaceArea;
+		for (size_t i = 0; i < g_sceneObjects.size(); i++)
+		{
+			const SCENE_OBJECT& object = g_sceneObjects[i];
+			if (object.bDynamic || object.bCovered || (object.color.a < 1.0f) || !g_bMeshMatches[object.mesh])
+			{
+				continue;
+			}
+			MATERIAL_VALUES material = { glm::vec3(0.0f), glm::vec3(0.0f), 0.0f };
+			if (object.materialHandle >= 0)
+			{
+				material = g_materialTable[object.materialHandle];
+			}
+			BAKE_OBJECT bakeObject;
+			bakeObject.sceneObject = static_cast<int>(i);
+			bakeObject.record = recordOf[i];
+			bakeObject.tileX = bakeObject.tileY = 0;
+			bakeObject.diffuse = material.diffuseColor;
+			bakeObject.albedo = glm::vec3(object.color) * material.diffuseColor;
+
+			const MeshBuilder& builder = meshes[object.mesh];
+			const glm::mat4& model = g_worldMatrices[i];
+			glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+			float area = 0.0f;
+			for (size_t index = 0; index + 2 < builder.indices.size(); index += 3)
+			{
+				BAKE_TRIANGLE triangle;
+				for (int corner = 0; corner < 3; corner++)
+				{
+					const MESH_VERTEX& vertex = builder.vertices[builder.indices[index + corner]];
+					triangle.position[corner] = glm::vec3(model * glm::vec4(vertex.position, 1.0f));
+					triangle.normal[corner] = glm::normalize(normalMatrix * vertex.normal);
+					triangle.atlas[corner] = vertex.lightmapUV;
+				}
+				triangle.object = static_cast<int>(bake->objects.size());
+				area += 0.5f * glm::length(glm::cross(triangle.position[1] - triangle.position[0],
+					triangle.position[2] - triangle.position[0]));
+				bake->triangles.push_back(triangle);
+			}
+			int minimum = static_cast<int>(std::ceil(geometry[object.mesh].lightmapLayout * LIGHTMAP_TEXELS_PER_CHART));
+			int size = static_cast<int>(std::ceil(std::sqrt(area) * LIGHTMAP_TEXELS_PER_UNIT));
+			bakeObject.tileSize = (bakeObject.record >= 0) ? std::min(std::max(size, minimum), LIGHTMAP_MAX_TILE) : 0;
+			bake->objects.push_back(bakeObject);
+		}
 
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 90.0f;
-	ZrotationDegrees = 0.0f;
+		// tiles largest first onto shelves across the atlas
+		std::vector<int> order;
+		for (size_t i = 0; i < bake->objects.size(); i++)
+		{
+			if (bake->objects[i].tileSize > 0)
+			{
+				order.push_back(static_cast<int>(i));
+			}
+		}
+		if (order.empty())
+		{
+			return;
+		}
+		std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+			return(bake->objects[a].tileSize > bake->objects[b].tileSize);
+			});
+		int x = 0;
+		int y = 0;
+		int shelfHeight = 0;
+		for (int i : order)
+		{
+			BAKE_OBJECT& object = bake->objects[i];
+			if (x + object.tileSize > LIGHTMAP_ATLAS_WIDTH)
+			{
+				x = 0;
+				y += shelfHeight;
+				shelfHeight = 0;
+			}
+			object.tileX = x;
+			object.tileY = y;
+			x += object.tileSize;
+			shelfHeight = std::max(shelfHeight, object.tileSize);
+		}
+		bake->width = LIGHTMAP_ATLAS_WIDTH;
+		bake->height = (y + shelfHeight + 3) & ~3;
+		for (BAKE_TRIANGLE& triangle : bake->triangles)
+		{
+			const BAKE_OBJECT& object = bake->objects[triangle.object];
+			for (int corner = 0; corner < 3; corner++)
+			{
+				triangle.atlas[corner] = glm::vec2(static_cast<float>(object.tileX), static_cast<float>(object.tileY)) +
+					triangle.atlas[corner] * static_cast<float>(object.tileSize);
+			}
+		}
 
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(5.0f, 1.9f, 2.0f);
+		// everything the result depends on goes into the cache key
+		uint64_t hash = 14695981039346656037ull;
+		hash = HashBytes(hash, bake->triangles.data(), bake->triangles.size() * sizeof(BAKE_TRIANGLE));
+		hash = HashBytes(hash, bake->objects.data(), bake->objects.size() * sizeof(BAKE_OBJECT));
+		hash = HashBytes(hash, bake->lights.data(), bake->lights.size() * sizeof(SCENE_LIGHT));
+		int settings[3] = { LIGHTMAP_INDIRECT_SAMPLES, LIGHTMAP_DILATE_PASSES, bake->height };
+		bake->sceneHash = HashBytes(hash, settings, sizeof(settings));
+
+		g_bBakeDone = false;
+		g_bStopBaking = false;
+		g_lightmapBake = std::move(bake);
+		g_bakeThread = std::thread(BakeLightmap, g_lightmapBake.get());
+	}
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+	/***********************************************************
+	 *  PumpLightmapBake()
+	 *
+	 *  This function is used for uploading the lightmap once the
+	 *  bake thread is done, and pointing the records of the
+	 *  static objects at their tiles. From then on those objects
+	 *  skip the light loop.
+	 ***********************************************************/
+	void PumpLightmapBake()
+	{
+		if (!g_lightmapBake || !g_bBakeDone)
+		{
+			return;
+		}
+		g_bakeThread.join();
+		std::unique_ptr<LIGHTMAP_BAKE> bake = std::move(g_lightmapBake);
+
+		glGenTextures(1, &g_lightmapTexture);
+		glActiveTexture(GL_TEXTURE0 + g_LightmapUnit);
+		glBindTexture(GL_TEXTURE_2D, g_lightmapTexture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, bake->width, bake->height, 0, GL_RGB, GL_FLOAT, bake->texels.data());
+		glActiveTexture(GL_TEXTURE0);
 
-	SetShaderColor(0.3f, 0.95f, 1.0f, 1.0f);
+		int tiles = 0;
+		for (const BAKE_OBJECT& object : bake->objects)
+		{
+			if (object.tileSize > 0)
+			{
+				g_objectRecords[object.record].lightmapRect = glm::vec4(
+					static_cast<float>(object.tileX) / bake->width, static_cast<float>(object.tileY) / bake->height,
+					static_cast<float>(object.tileSize) / bake->width, static_cast<float>(object.tileSize) / bake->height);
+				tiles++;
+			}
+		}
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, g_recordBuffer);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, g_objectRecords.size() * sizeof(OBJECT_RECORD), g_objectRecords.data());
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
 
-	SetShaderMaterial("metal");
+		std::cout << "[SceneManager] Lightmap: " << tiles << " static object(s) in a " << bake->width << " x "
+			<< bake->height << " atlas, ";
+		if (bake->bFromCache)
+		{
+			std::cout << "read from the cache in " << bake->milliseconds << " ms" << std::endl;
+		}
+		else
+		{
+			std::cout << "baked from " << bake->triangles.size() << " triangle(s) in " << bake->milliseconds
+				<< " ms on " << bake->threads << " thread(s), " << bake->steals << " task(s) stolen" << std::endl;
+		}
+	}
 
+	/***********************************************************
+	 *  StopLightmapBake()
+	 *
+	 *  This function is used for abandoning a bake still running
+	 *  and freeing the lightmap.
+	 ***********************************************************/
+	void StopLightmapBake()
+	{
+		if (g_bakeThread.joinable())
+		{
+			g_bStopBaking = true;
+			g_bakeThread.join();
+		}
+		g_lightmapBake.reset();
+		g_bStopBaking = false;
+		if (g_lightmapTexture != 0)
+		{
+			glDeleteTextures(1, &g_lightmapTexture);
+			g_lightmapTexture = 0;
+		}
+	}
 
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh();
+#ifdef SCENE_BENCHMARKS
+	/***********************************************************
+	 *  BenchmarkTransformCache()
+	 *
+	 *  This function is used for timing the CPU cost per frame
+	 *  of rebuilding every model matrix, as RenderScene() used
+	 *  to, against updating only the dynamic ones in the cache.
+	 *  Build with SCENE_BENCHMARKS defined to run it on startup.
+	 ***********************************************************/
+	void BenchmarkTransformCache()
+	{
+		const int frameCount = 10000;
+		glm::mat4 checksum(0.0f);
 
-	//SetShaderColor(1, 1, 1, 1);
+		auto start = std::chrono::steady_clock::now();
+		for (int frame = 0; frame < frameCount; frame++)
+		{
+			for (const SCENE_OBJECT& object : g_sceneObjects)
+			{
+				glm::mat4 model = ComputeObjectMatrix(object);
+				checksum[0] = checksum[0] + model[0];
+			}
+		}
+		auto rebuilt = std::chrono::steady_clock::now();
+		for (int frame = 0; frame < frameCount; frame++)
+		{
+			UpdateWorldMatrices(1.0f / 60.0f);
+			checksum[0] = checksum[0] + g_worldMatrices[frame % g_worldMatrices.size()][0];
+		}
+		auto cached = std::chrono::steady_clock::now();
+
+		double rebuildMicroseconds = std::chrono::duration<double, std::micro>(rebuilt - start).count() / frameCount;
+		double cachedMicroseconds = std::chrono::duration<double, std::micro>(cached - rebuilt).count() / frameCount;
+		std::cout << "[SceneManager] Transform benchmark (" << g_sceneObjects.size() << " objects, "
+			<< g_dynamicObjects.size() << " dynamic): rebuild all " << rebuildMicroseconds
+			<< " us/frame, cached " << cachedMicroseconds << " us/frame (checksum "
+			<< checksum[0].x << ")" << std::endl;
+	}
 
-	//m_basicMeshes->DrawBoxMeshLines();
+	/***********************************************************
+	 *  BenchmarkBoundingVolumes()
+	 *
+	 *  This function is used for timing the hierarchy on large
+	 *  synthetic scenes of randomly placed boxes: how long it
+	 *  takes to build and refit, and frustum culls and ray casts
+	 *  through it against testing every box.
+	 ***********************************************************/
+	void BenchmarkBoundingVolumes()
+	{
+		const int sizes[] = { 10000, 100000 };
+		const int queryCount = 100;
+		for (int count : sizes)
+		{
+			std::vector<float> center[3];
+			std::vector<float> extent[3];
+			unsigned int seed = 12345;
+			auto random = [&seed]() {
+				seed = seed * 1664525u + 1013904223u;
+				return(static_cast<float>(seed >> 8) / 16777216.0f);
+				};
+			for (int axis = 0; axis < 3; axis++)
+			{
+				center[axis].resize(count);
+				extent[axis].resize(count);
+			}
+			for (int i = 0; i < count; i++)
+			{
+				for (int axis = 0; axis < 3; axis++)
+				{
+					center[axis][i] = (random() - 0.5f) * 1000.0f;
+					extent[axis][i] = 0.5f + random() * 2.0f;
+				}
+			}
+
+			BoundingVolumeHierarchy bvh;
+			auto start = std::chrono::steady_clock::now();
+			bvh.Build(center, extent, count);
+			auto built = std::chrono::steady_clock::now();
+			std::vector<int> moved;
+			for (int i = 0; i < count; i += 100)
+			{
+				center[1][i] += 1.0f;
+				moved.push_back(i);
+			}
+			bvh.Refit(moved);
+			auto refit = std::chrono::steady_clock::now();
+
+			// cameras at the middle looking in different directions
+			std::vector<char> visible(count);
+			int bvhVisible = 0;
+			int flatVisible = 0;
+			double cullMicroseconds[2] = { 0.0, 0.0 };
+			for (int query = 0; query < queryCount; query++)
+			{
+				float angle = glm::radians(360.0f * query / queryCount);
+				glm::mat4 viewProjection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 300.0f) *
+					glm::lookAt(glm::vec3(0.0f), glm::vec3(cosf(angle), 0.0f, sinf(angle)), glm::vec3(0.0f, 1.0f, 0.0f));
+				glm::vec4 planes[6];
+				ExtractFrustumPlanes(viewProjection, planes);
+
+				auto queryStart = std::chrono::steady_clock::now();
+				bvhVisible += bvh.CullFrustum(planes, visible);
+				auto bvhDone = std::chrono::steady_clock::now();
+				int objects[4];
+				for (int i = 0; i < count; i += 4)
+				{
+					int lanes = std::min(4, count - i);
+					for (int lane = 0; lane < lanes; lane++)
+					{
+						objects[lane] = i + lane;
+					}
+					int outsideMask = TestBoxesOutside(center, extent, objects, lanes, planes, 0x3F);
+					for (int lane = 0; lane < lanes; lane++)
+					{
+						flatVisible += ((outsideMask >> lane) & 1) ? 0 : 1;
+					}
+				}
+				auto flatDone = std::chrono::steady_clock::now();
+				cullMicroseconds[0] += std::chrono::duration<double, std::micro>(bvhDone - queryStart).count();
+				cullMicroseconds[1] += std::chrono::duration<double, std::micro>(flatDone - bvhDone).count();
+			}
+
+			// rays from outside the scene towards random points in it
+			int bvhHits = 0;
+			int flatHits = 0;
+			double rayMicroseconds[2] = { 0.0, 0.0 };
+			for (int query = 0; query < queryCount; query++)
+			{
+				glm::vec3 origin(-600.0f, (random() - 0.5f) * 1000.0f, (random() - 0.5f) * 1000.0f);
+				glm::vec3 target((random() - 0.5f) * 1000.0f, (random() - 0.5f) * 1000.0f, (random() - 0.5f) * 1000.0f);
+				glm::vec3 direction = glm::normalize(target - origin);
+				glm::vec3 inverseDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+				auto boxHit = [&](int object, float& nearest) {
+					glm::vec3 objectCenter(center[0][object], center[1][object], center[2][object]);
+					glm::vec3 objectExtent(extent[0][object], extent[1][object], extent[2][object]);
+					float entry = 0.0f;
+					if (!BoundingVolumeHierarchy::RayHitsBox(origin, inverseDirection,
+						objectCenter - objectExtent, objectCenter + objectExtent, nearest, entry))
+					{
+						return(false);
+					}
+					nearest = entry;
+					return(true);
+					};
+
+				auto queryStart = std::chrono::steady_clock::now();
+				float nearest = std::numeric_limits<float>::max();
+				bvhHits += (bvh.Raycast(origin, direction, nearest, boxHit) >= 0) ? 1 : 0;
+				auto bvhDone = std::chrono::steady_clock::now();
+				int flatHit = -1;
+				nearest = std::numeric_limits<float>::max();
+				for (int i = 0; i < count; i++)
+				{
+					if (boxHit(i, nearest))
+					{
+						flatHit = i;
+					}
+				}
+				flatHits += (flatHit >= 0) ? 1 : 0;
+				auto flatDone = std::chrono::steady_clock::now();
+				rayMicroseconds[0] += std::chrono::duration<double, std::micro>(bvhDone - queryStart).count();
+				rayMicroseconds[1] += std::chrono::duration<double, std::micro>(flatDone - bvhDone).count();
+			}
+
+			std::cout << "[SceneManager] Hierarchy benchmark (" << count << " boxes, " << bvh.NodeCount() << " nodes, depth "
+				<< bvh.Depth() << "): build " << std::chrono::duration<double, std::milli>(built - start).count()
+				<< " ms, refit of " << moved.size() << " " << std::chrono::duration<double, std::micro>(refit - built).count()
+				<< " us, cull " << (cullMicroseconds[0] / queryCount) << " us against " << (cullMicroseconds[1] / queryCount)
+				<< " us for every box (" << (bvhVisible / queryCount) << "/" << (flatVisible / queryCount) << " visible), ray "
+				<< (rayMicroseconds[0] / queryCount) << " us against " << (rayMicroseconds[1] / queryCount) << " us ("
+				<< bvhHits << "/" << flatHits << " hit)" << std::endl;
+		}
+	}
 
+	/***********************************************************
+	 *  BenchmarkTextureCache()
+	 *
+	 *  This function is used for timing what a decode worker
+	 *  does for the scene textures on a cold start, decoding
+	 *  them and building their mip chains, against a warm start
+	 *  that maps the cache files. It uses a cache folder of its
+	 *  own so the scene's cache is left alone.
+	 ***********************************************************/
+	void BenchmarkTextureCache()
+	{
+		const char* folder = "texture_cache_benchmark";
+		CreateTextureFolder(folder);
 
-	//------------------------------------------------------------------------------------------------
+		double milliseconds[2] = { 0.0, 0.0 };
+		uint64_t dataBytes = 0;
+		unsigned int checksum = 0;
+		for (int pass = 0; pass < 2; pass++)
+		{
+			if (pass == 0)
+			{
+				for (const TEXTURE_LOAD& queued : g_textureLoads)
+				{
+					std::remove(TextureCachePath(folder, queued.path).c_str());
+				}
+			}
+			dataBytes = 0;
+			auto start = std::chrono::steady_clock::now();
+			for (const TEXTURE_LOAD& queued : g_textureLoads)
+			{
+				TEXTURE_LOAD load;
+				InitTextureLoad(load, queued.path, 0, queued.handle);
+				if (PrepareTextureLoad(load, folder))
+				{
+					// touch every page, as the upload copy would
+					for (uint64_t i = 0; i < load.header.dataBytes; i += 4096)
+					{
+						checksum += load.data[i];
+					}
+					dataBytes += load.header.dataBytes;
+				}
+			}
+			milliseconds[pass] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
 
-	scaleXYZ = glm::vec3(1.2f, 0.2f, 1.2f);
+		std::cout << "[SceneManager] Texture cache benchmark (" << g_textureLoads.size() << " textures, "
+			<< (dataBytes >> 20) << " MB with mips): cold " << milliseconds[0] << " ms, warm "
+			<< milliseconds[1] << " ms (checksum " << checksum << ")" << std::endl;
+	}
+#endif
+}
 
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 90.0f;
-	ZrotationDegrees = 0.0f;
+/***********************************************************
+ *  SceneManager()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+SceneManager::SceneManager(ShaderManager *pShaderManager)
+{
+	m_pShaderManager = pShaderManager;
+	m_basicMeshes = new ShapeMeshes();
+}
 
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-2.0f, 1.9f, 2.0f);
+/***********************************************************
+ *  ~SceneManager()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+SceneManager::~SceneManager()
+{
+	m_pShaderManager = NULL;
+	delete m_basicMeshes;
+	m_basicMeshes = NULL;
+}
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+/***********************************************************
+ *  CreateGLTexture()
+ *
+ *  This method is used for loading textures from image files,
+ *  configuring the texture mapping parameters in OpenGL,
+ *  generating the mipmaps, and loading the read texture into
+ *  the next available texture slot in memory.
+ ***********************************************************/
+bool SceneManager::CreateGLTexture(const char* filename, std::string tag)
+{
+	int width = 0;
+	int height = 0;
+	int colorChannels = 0;
+	GLuint textureID = 0;
 
-	SetShaderColor(0.3f, 0.95f, 1.0f, 1.0f);
+	// indicate to always flip images vertically when loaded
+	stbi_set_flip_vertically_on_load(true);
 
-	SetShaderMaterial("metal");
+	// try to parse the image data from the specified image file
+	unsigned char* image = stbi_load(
+		filename,
+		&width,
+		&height,
+		&colorChannels,
+		0);
 
+	// if the image was successfully read from the image file
+	if (image)
+	{
+		std::cout << "Successfully loaded image:" << filename << ", width:" << width << ", height:" << height << ", channels:" << colorChannels << std::endl;
 
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh();
+		glGenTextures(1, &textureID);
+		glBindTexture(GL_TEXTURE_2D, textureID);
 
-	//SetShaderColor(1, 1, 1, 1);
+		// set the texture wrapping parameters
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		// set texture filtering parameters
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-	//m_basicMeshes->DrawBoxMeshLines();
+		// if the loaded image is in RGB format
+		if (colorChannels == 3)
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
+		// if the loaded image is in RGBA format - it supports transparency
+		else if (colorChannels == 4)
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
+		else
+		{
+			std::cout << "Not implemented to handle image with " << colorChannels << " channels" << std::endl;
+			return false;
+		}
 
+		// generate the texture mipmaps for mapping textures to lower resolutions
+		glGenerateMipmap(GL_TEXTURE_2D);
 
+		// free the image data from local memory
+		stbi_image_free(image);
+		glBindTexture(GL_TEXTURE_2D, 0); // Unbind the texture
 
-	//------------------------------------------------------------------------------------------------------------------Side Fan
+		// register the loaded texture and associate it with the special tag string
+		m_textureIDs[m_loadedTextures].ID = textureID;
+		m_textureIDs[m_loadedTextures].tag = tag;
+		m_loadedTextures++;
+		// the texture slot doubles as the texture's handle
+		g_textureTags.resize(m_loadedTextures);
+		g_textureTags[m_loadedTextures - 1] = tag;
+		g_textureResident.resize(m_loadedTextures, 0);
+		g_textureResident[m_loadedTextures - 1] = 1;
+		m_textureIDs.push_back(textureID);
+		return true;
+	}
 
+	std::cout << "Could not load image:" << filename << std::endl;
 
+	// Error loading the image
+	return false;
+}
 
+/***********************************************************
+ *  BindGLTextures()
+ *
+ *  This method is used for binding the loaded textures to
+ *  OpenGL texture memory slots.  There are up to 16 slots.
+ ***********************************************************/
+void SceneManager::BindGLTextures()
+{
+	for (int i = 0; i < m_loadedTextures; i++)
+	{
+		// bind textures on corresponding texture units
+		glActiveTexture(GL_TEXTURE0 + i);
+		glBindTexture(GL_TEXTURE_2D, m_textureIDs[i].ID);
+	}
+}
 
+// old
 
-	scaleXYZ = glm::vec3(4.0f, 0.5f, 4.0f);
+/***********************************************************
+ *  DestroyGLTextures()
+ *
+ *  This method is used for freeing the memory in all the
+ *  used texture memory slots.
+ ***********************************************************/
+/* void SceneManager::DestroyGLTextures()
+{
+	for (int i = 0; i < m_loadedTextures; i++)
+	{
+		glGenTextures(1, &m_textureIDs[i].ID);
+	}
+}
 
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 90.0f;
-	YrotationDegrees = 90.0f;
-	ZrotationDegrees = 0.0f;
+*/
 
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-7.5f, 8.5f, 2.0f);
+// new
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+void SceneManager::DeleteSceneTextures()
+{
+	StopTextureDecoding();
+	DeleteTextureArray();
+	g_textureResident.clear();
 
+	if (!m_textureIDs.empty()) {
+		glDeleteTextures(static_cast<GLsizei>(m_textureIDs.size()), m_textureIDs.data());
+		std::cout << "[SceneManager] Deleted " << m_textureIDs.size() << " texture(s)." << std::endl;
+		m_textureIDs.clear();  // Clear the list after deletion
+	} else {
+		std::cout << "[SceneManager] No textures to delete." << std::endl;
+	}
+}
 
-	SetShaderColor(0.1, 0.1, 0.12, 1);
 
 
+/***********************************************************
+ *  FindTextureID()
+ *
+ *  This method is used for getting an ID for the previously
+ *  loaded texture bitmap associated with the passed in tag.
+ ***********************************************************/
+int SceneManager::FindTextureID(std::string tag)
+{
+	int textureID = -1;
+	int index = 0;
+	bool bFound = false;
 
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
+	while ((index < m_loadedTextures) && (bFound == false))
+	{
+		if (m_textureIDs[index].tag.compare(tag) == 0)
+		{
+			textureID = m_textureIDs[index].ID;
+			bFound = true;
+		}
+		else
+			index++;
+	}
 
-	//SetShaderColor(1, 1, 1, 1);
+	return(textureID);
+}
 
-	//m_basicMeshes->DrawBoxMeshLines();
+/***********************************************************
+ *  FindTextureSlot()
+ *
+ *  This method is used for getting a slot index for the previously
+ *  loaded texture bitmap associated with the passed in tag.
+ ***********************************************************/
+int SceneManager::FindTextureSlot(std::string tag)
+{
+	int textureSlot = -1;
+	int index = 0;
+	bool bFound = false;
 
-	//-----------------------------------------------------------------------------------------
+	while ((index < m_loadedTextures) && (bFound == false))
+	{
+		if (m_textureIDs[index].tag.compare(tag) == 0)
+		{
+			textureSlot = index;
+			bFound = true;
+		}
+		else
+			index++;
+	}
 
+	return(textureSlot);
+}
 
-	scaleXYZ = glm::vec3(1.5f, 1.5f, 1.5f);
+/***********************************************************
+ *  FindMaterial()
+ *
+ *  This method is used for getting a material from the previously
+ *  defined materials list that is associated with the passed in tag.
+ ***********************************************************/
+bool SceneManager::FindMaterial(std::string tag, OBJECT_MATERIAL& material)
+{
+	if (m_objectMaterials.size() == 0)
+	{
+		return(false);
+	}
 
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 90.0f;
-	ZrotationDegrees = 0.0f;
+	int index = 0;
+	bool bFound = false;
+	while ((index < m_objectMaterials.size()) && (bFound == false))
+	{
+		if (m_objectMaterials[index].tag.compare(tag) == 0)
+		{
+			bFound = true;
+			material.diffuseColor = m_objectMaterials[index].diffuseColor;
+			material.specularColor = m_objectMaterials[index].specularColor;
+			material.shininess = m_objectMaterials[index].shininess;
+		}
+		else
+		{
+			index++;
+		}
+	}
 
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-7.2f, 8.5f, 2.0f);
+	return(true);
+}
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
+/***********************************************************
+ *  SetTransformations()
+ *
+ *  This method is used for setting the transform buffer
+ *  using the passed in transformation values.
+ ***********************************************************/
+void SceneManager::SetTransformations(
+	glm::vec3 scaleXYZ,
+	float XrotationDegrees,
+	float YrotationDegrees,
+	float ZrotationDegrees,
+	glm::vec3 positionXYZ,
+	glm::vec3 offset)
+{
+	glm::mat4 modelView = ComputeModelMatrix(
 		scaleXYZ,
 		XrotationDegrees,
 		YrotationDegrees,
 		ZrotationDegrees,
-		positionXYZ);
-
-	SetShaderColor(0.0f, 0.9f, 1.0f, 1.0f);
+		positionXYZ + offset);
 
+	if (NULL != m_pShaderManager)
+	{
+		g_uniformCache.SetMat4(g_ModelUniform, modelView);
+	}
+}
 
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawTorusMesh();
-
-	//SetShaderColor(1, 1, 1, 1);
-
-	//m_basicMeshes->DrawBoxMeshLines();
-
-	//-------------------------------------------------------------------------------------
-	scaleXYZ = glm::vec3(0.5f, 0.2f, 0.5f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 90.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-7.0f, 8.5f, 2.0f);
+/***********************************************************
+ *  SetShaderColor()
+ *
+ *  This method is used for setting the passed in color
+ *  into the shader for the next draw command
+ ***********************************************************/
+void SceneManager::SetShaderColor(
+	float redColorValue,
+	float greenColorValue,
+	float blueColorValue,
+	float alphaValue)
+{
+	// variables for this method
+	glm::vec4 currentColor;
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+	currentColor.r = redColorValue;
+	currentColor.g = greenColorValue;
+	currentColor.b = blueColorValue;
+	currentColor.a = alphaValue;
 
-	SetShaderColor(0.0f, 0.0f, 0.0f, 1.0f);
+	if (NULL != m_pShaderManager)
+	{
+		SetShaderColorValue(currentColor);
+	}
+}
 
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh();
+/***********************************************************
+ *  SetShaderTexture()
+ *
+ *  This method is used for setting the texture data
+ *  associated with the passed in ID into the shader.
+ ***********************************************************/
+void SceneManager::SetShaderTexture(
+	std::string textureTag)
+{
+	if (NULL != m_pShaderManager)
+	{
+		int textureID = -1;
+		textureID = FindTextureSlot(textureTag);
+		SetShaderTextureHandle(textureID);
+	}
+}
 
-	//SetShaderColor(1, 1, 1, 1);
+/***********************************************************
+ *  SetTextureUVScale()
+ *
+ *  This method is used for setting the texture UV scale
+ *  values into the shader.
+ ***********************************************************/
+void SceneManager::SetTextureUVScale(float u, float v)
+{
+	if (NULL != m_pShaderManager)
+	{
+		g_uniformCache.SetVec2(g_UVScaleUniform, glm::vec2(u, v));
+	}
+}
 
-	//m_basicMeshes->DrawBoxMeshLines();
+/***********************************************************
+ *  SetShaderMaterial()
+ *
+ *  This method is used for passing the material values
+ *  into the shader.
+ ***********************************************************/
+void SceneManager::SetShaderMaterial(
+	std::string materialTag)
+{
+	if (m_objectMaterials.size() > 0)
+	{
+		OBJECT_MATERIAL material;
+		bool bReturn = false;
 
+		bReturn = FindMaterial(materialTag, material);
+		if (bReturn == true)
+		{
+			g_uniformCache.SetVec3(g_MaterialDiffuseUniform, material.diffuseColor);
+			g_uniformCache.SetVec3(g_MaterialSpecularUniform, material.specularColor);
+			g_uniformCache.SetFloat(g_MaterialShininessUniform, material.shininess);
+		}
+	}
+}
 
+/**************************************************************/
+/*** STUDENTS CAN MODIFY the code in the methods BELOW for  ***/
+/*** preparing and rendering their own 3D replicated scenes.***/
+/*** Please refer to the code in the OpenGL sample project  ***/
+/*** for assistance.                                        ***/
+/**************************************************************/
 
-	//------------------------------------------------------------------------------------------------
 
-	
-	scaleXYZ = glm::vec3(1.2f, 0.2f, 1.2f);
+/***********************************************************
+ *  PrepareScene()
+ *
+ *  This method is used for preparing the 3D scene by loading
+ *  the shapes, textures in memory to support the 3D scene 
+ *  rendering
+ ***********************************************************/
+//-------------------------------------------------------------------------------------------------------textures
 
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 90.0f;
+void SceneManager::DefineObjectMaterials()
+{
+	OBJECT_MATERIAL goldMaterial;
+	goldMaterial.diffuseColor = glm::vec3(0.4f, 0.4f, 0.4f);
+	goldMaterial.specularColor = glm::vec3(0.7f, 0.7f, 0.6f);
+	goldMaterial.shininess = 52.0;
+	goldMaterial.tag = "metal";
 
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-7.1f, 8.5f, 2.0f);
+	m_objectMaterials.push_back(goldMaterial);
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+	OBJECT_MATERIAL woodMaterial;
+	woodMaterial.diffuseColor = glm::vec3(0.2f, 0.2f, 0.3f);
+	woodMaterial.specularColor = glm::vec3(0.0f, 0.0f, 0.0f);
+	woodMaterial.shininess = 0.1;
+	woodMaterial.tag = "wood";
 
-	SetShaderColor(0.3f, 0.95f, 1.0f, 1.0f);
+	m_objectMaterials.push_back(woodMaterial);
 
+	OBJECT_MATERIAL glassMaterial;
+	glassMaterial.diffuseColor = glm::vec3(0.2f, 0.2f, 0.2f);
+	glassMaterial.specularColor = glm::vec3(1.0f, 1.0f, 1.0f);
+	glassMaterial.shininess = 95.0;
+	glassMaterial.tag = "glass";
 
+	m_objectMaterials.push_back(glassMaterial);
 
+	// register the materials so draws can refer to them by handle
+	g_materialTable.clear();
+	g_materialTags.clear();
+	for (const OBJECT_MATERIAL& material : m_objectMaterials)
+	{
+		MATERIAL_VALUES values;
+		values.diffuseColor = material.diffuseColor;
+		values.specularColor = material.specularColor;
+		values.shininess = material.shininess;
+		g_materialTable.push_back(values);
+		g_materialTags.push_back(material.tag);
+	}
+}
 
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh();
 
-	//SetShaderColor(1, 1, 1, 1);
+void SceneManager::SetupSceneLights()
+{
+	// this line of code is NEEDED for telling the shaders to render 
+	// the 3D scene with custom lighting - to use the default rendered 
+	// lighting then comment out the following line; it goes through
+	// the uniform cache so the geometry pool is told as well
+	g_uniformCache.AttachCurrent();
+	g_uniformCache.SetInt(g_UseLightingUniform, true);
 
-	//m_basicMeshes->DrawBoxMeshLines();
 
+	// the lights are kept in the SceneLights uniform buffer, and
+	// reach the scene program's pointLights[] uniforms on the first
+	// frame; changing one later sends only what changed
+	//----------------------------------------------------------------------------------side fan
+	g_sceneLights.SetLight(0, glm::vec3(-3.0f, 8.5f, 2.0f), glm::vec3(0.05f, 0.05f, 0.05f),
+		glm::vec3(0.0f, 2.6f, 3.0f), glm::vec3(0.0f, 2.6f, 3.0f));
+	//---------------------------------------------------------------------------------back right middle fan
+	g_sceneLights.SetLight(1, glm::vec3(0.5f, 0.2f, 1.5f), glm::vec3(0.05f, 0.05f, 0.05f),
+		glm::vec3(0.0f, 2.6f, 3.0f), glm::vec3(0.0f, 0.9f, 1.0f));
+	//----------------------------------------------------------------------------------bottom middle fan
+	g_sceneLights.SetLight(2, glm::vec3(0.5f, 1.2f, 0.5f), glm::vec3(0.05f, 0.05f, 0.05f),
+		glm::vec3(0.0f, 2.6f, 3.0f), glm::vec3(0.0f, 0.9f, 1.0f));
+	//-----------------------------------------------------------------------------------room
+	g_sceneLights.SetLight(3, glm::vec3(10.1f, 30.0f, 30.0f), glm::vec3(0.3f, 0.3f, 0.3f),
+		glm::vec3(0.2f, 0.2f, 0.2f), glm::vec3(3.9f, 3.9f, 3.9f));
 
+	//m_pShaderManager->setVec3Value("pointLights[1].position", -7.0f, 8.5f, 2.0f);
+	//m_pShaderManager->setVec3Value("pointLights[1].ambient", 0.0f, 0.9f, 0.6f);
+	//m_pShaderManager->setVec3Value("pointLights[1].diffuse", 0.2f, 0.2f, 1.0f);
+	//m_pShaderManager->setVec3Value("pointLights[1].specular", 0.9f, 0.9f, 0.9f);
+	//m_pShaderManager->setBoolValue("pointLights[1].bActive", true);
+	//10.1f, 30.0f, 30.0f
 
+}
 
-	//--------------------------------------------------------------------------------------------------------------Glass
+void SceneManager::LoadSceneTextures()
+{
+	// the textures are registered right away so the scene file can
+	// name them, then decoded in the background and uploaded over
+	// the first frames; RenderScene() draws with the object colors
+	// until they arrive. Failures are logged when they come back.
+	auto queueTexture = [&](const std::string& path, const std::string& tag) {
+		GLuint textureID = 0;
+		glGenTextures(1, &textureID);
+		m_textureIDs[m_loadedTextures].ID = textureID;
+		m_textureIDs[m_loadedTextures].tag = tag;
+		m_loadedTextures++;
+		g_textureTags.resize(m_loadedTextures);
+		g_textureTags[m_loadedTextures - 1] = tag;
+		m_textureIDs.push_back(textureID);
+		QueueTextureLoad(path, textureID, m_loadedTextures - 1);
+		};
 
+	queueTexture("textures/desk.jpg", "desk");
+	queueTexture("textures/wall.jpg", "wall");
+	queueTexture("textures/keyboard.jpg", "keyboard");
+	queueTexture("textures/black.jpg", "black");
+	queueTexture("textures/screen.jpg", "screen");
+	queueTexture("textures/rightscreen.jpg", "rightscreen");
+	queueTexture("textures/leftscreen.jpg", "leftscreen");
+	queueTexture("textures/cpucooler.jpg", "cpucooler");
+	queueTexture("textures/gpufront.jpg", "gpufront");
+	queueTexture("textures/gpuside.jpg", "gpuside");
+	queueTexture("textures/gputop.jpg", "gputop");
+	queueTexture("textures/motherboard.jpg", "motherboard");
+	queueTexture("textures/ram.jpg", "ram");
 
+	BindGLTextures();
+	StartTextureDecoding();
+}
 
 
 
 
-	// Enable transparency
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-	// Set glass transformations
-	scaleXYZ = glm::vec3(18.0f, 0.1f, 9.99f);
-	XrotationDegrees = 90.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-	positionXYZ = glm::vec3(1.4f, 6.5f, 5.1f);
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
 
-	// Disable depth writing for transparency
-	glDepthMask(GL_FALSE);
-	SetShaderMaterial("glass");
-	// Set glass color (transparent light blue)
-	SetShaderColor(0.6f, 0.8f, 1.0f, 0.2f);
-	m_basicMeshes->DrawBoxMesh();
+void SceneManager::PrepareScene()
+{
+	// only one instance of a particular mesh needs to be
+	// loaded in memory no matter how many times it is drawn
+	// in the rendered 3D scene
+	LoadSceneTextures();
+	m_basicMeshes->LoadPlaneMesh();
+	m_basicMeshes->LoadBoxMesh();
+	m_basicMeshes->LoadTorusMesh();
+	m_basicMeshes->LoadPyramid4Mesh();
+	m_basicMeshes->LoadPrismMesh();
+	m_basicMeshes->LoadCylinderMesh();
 
-	// Restore depth writing
-	glDepthMask(GL_TRUE);
+	SetupSceneLights();
+	DefineObjectMaterials();
 
-	
-	//------------------------------------------------------------------------------------------------
+	// the scene layout lives in the scene file instead of code
+	LoadSceneDescription(g_SceneFileName);
+	BuildWorldMatrices();
+	VerifyMeshGeometry(m_basicMeshes);
+	BuildObjectBounds();
+	BuildRenderQueue();
+	BuildGeometryPoolDraws();
+	CreateOcclusionQueries();
+
+	// the static objects are lit by the light loop until this finishes
+	StartLightmapBake();
+
+#ifdef SCENE_BENCHMARKS
+	BenchmarkTransformCache();
+	BenchmarkBoundingVolumes();
+	BenchmarkTextureCache();
+#endif
+}
 
+/***********************************************************
+ *  RenderScene()
+ *
+ *  This method is used for rendering the 3D scene by walking
+ *  the draw list built from the scene file in PrepareScene()
+ *  in render queue order, using the world matrices cached
+ *  for each object
+ ***********************************************************/
+void SceneManager::RenderScene()
+{
+	// pick up the current program's uniform locations
+	g_uniformCache.BeginFrame();
+
+	// bring in whatever textures finished decoding
+	PumpTextureLoads();
+	PumpLightmapBake();
+
+	// only the dynamic objects need new world matrices this frame
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	UpdateWorldMatrices(std::chrono::duration<float>(now - g_lastFrameTime).count());
+	g_lastFrameTime = now;
+
+	// send the lights changed since the last frame
+	g_sceneLights.Upload();
+	g_sceneLights.Apply(g_uniformCache);
+
+	// nothing outside the camera's view is submitted
+	glm::mat4 view = ReadProgramMatrix(g_ViewUniform);
+	glm::mat4 projection = ReadProgramMatrix(g_ProjectionUniform);
+
+	// the camera is kept in the uniform cache as well, which is
+	// where the geometry pool takes its copy from
+	g_uniformCache.SetMat4(g_ViewUniform, view);
+	g_uniformCache.SetMat4(g_ProjectionUniform, projection);
+	g_uniformCache.SetVec3(g_ViewPositionUniform, glm::transpose(glm::mat3(view)) * -glm::vec3(view[3]));
+	CullSceneObjects(view, projection);
+	g_lightClusters.Update(view, projection);
+	PollScenePicking(view, projection);
+	PollOutlineToggle();
+
+	// every opaque object the geometry pool holds is drawn first,
+	// without blending and with depth writes
+	g_queueChanges.BeginFrame();
+	g_renderStates.BeginFrame();
+	g_renderStates.SetBlend(false);
+	g_renderStates.SetDepthMask(true);
+	DrawGeometryPool();
+
+	// then the remaining draws in sort key order so that draws sharing
+	// a texture, material or mesh follow each other, and the
+	// transparent draws come last from back to front
+	SortRenderQueue(view);
+
+	for (uint64_t key : g_renderQueue)
+	{
+		const SCENE_DRAW& draw = g_sceneDraws[key & SORT_DRAW_MASK];
+		const SCENE_OBJECT& object = g_sceneObjects[draw.object];
+		g_queueChanges.Submit(draw);
 
+		// set the cached transformations to be used on the drawn meshes
+		g_uniformCache.SetMat4(g_ModelUniform, g_worldMatrices[draw.object]);
 
-	// Enable transparency
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		SetShaderMaterialHandle(object.materialHandle);
 
-	// Set glass transformations
-	scaleXYZ = glm::vec3(9.5f, 0.1f, 9.99f);
-	XrotationDegrees = 90.0f;
-	YrotationDegrees = 90.0f;
-	ZrotationDegrees = 0.0f;
-	positionXYZ = glm::vec3(10.4f, 6.5f, 0.3f);
+		// transparent objects blend over what is already drawn
+		// without hiding what is drawn after them
+		bool bTransparent = (object.color.a < 1.0f);
+		g_renderStates.SetBlend(bTransparent);
+		if (bTransparent)
+		{
+			g_renderStates.SetBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		}
+		g_renderStates.SetDepthMask(!bTransparent);
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+		if (!TextureResident(draw.textureHandle))
+		{
+			SetShaderColorValue(object.color);
+		}
+		else
+		{
+			SetShaderTextureHandle(draw.textureHandle);
+		}
+		// draw the mesh with transformation values
+		DrawScenePart(m_basicMeshes, object.mesh, draw.part);
+	}
 
-	// Disable depth writing for transparency
-	glDepthMask(GL_FALSE);
-	SetShaderMaterial("glass");
-	// Set glass color (transparent light blue)
-	SetShaderColor(0.6f, 0.8f, 1.0f, 0.2f);
-	m_basicMeshes->DrawBoxMesh();
+	// test what was in view against the finished depth buffer;
+	// the results decide what is drawn on a following frame
+	IssueOcclusionQueries(view, projection);
 
-	// Restore depth writing
-	glDepthMask(GL_TRUE);
+	// the bounding box overlay, when turned on
+	DrawSceneOutlines(view, projection);
 
+	// leave blending off and depth writes on for what draws next
+	g_renderStates.SetBlend(false);
+	g_renderStates.SetDepthMask(true);
 }
 void SceneManager::CleanupScene()
 {
+	g_uniformCache.Report("Scene");
+	g_poolUniforms.Report("Geometry pool");
+	g_renderStates.Report();
+	g_sceneLights.Report();
+	g_lightClusters.Report();
+	g_shadowMaps.Report();
+	ReportRenderQueue();
+	ReportCulling();
+	StopLightmapBake();
+	DestroyGeometryPool();
+	DestroyOcclusionQueries();
+	g_outlines.Destroy();
+	g_sceneLights.Destroy();
+	g_lightClusters.Destroy();
 	DeleteSceneTextures();
 	// Other cleanup logic...
 }